@@ -0,0 +1,216 @@
+#include "KbGenerator.hpp"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+KbGenerator::KbGenerator(const KbSpec &s) : spec(s), state(s.seed * 0x9E3779B97F4A7C15ULL + 1)
+{
+    if (spec.vars > MAX_VARS)
+        spec.vars = MAX_VARS;
+    if (spec.vars < 2)
+        spec.vars = 2;
+}
+
+const std::vector<std::string> &KbGenerator::shapes()
+{
+    static const std::vector<std::string> names = {
+        "chain", "diamond", "wide_or", "wide_xor", "equiv_web", "cycle", "random"};
+    return names;
+}
+
+uint64_t KbGenerator::next()
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+unsigned int KbGenerator::below(unsigned int n)
+{
+    return n ? static_cast<unsigned int>(next() % n) : 0;
+}
+
+std::string KbGenerator::symbol(unsigned int i) const
+{
+    if (spec.vars <= 26)
+        return std::string(1, static_cast<char>('A' + i % spec.vars));
+    return "s" + std::to_string(i % spec.vars);
+}
+
+std::string KbGenerator::randomSymbol()
+{
+    return symbol(below(spec.vars));
+}
+
+std::string KbGenerator::literal(const std::string &s)
+{
+    std::string lit;
+    if (below(4) == 0)
+        lit.push_back('!');
+    lit += s;
+    return lit;
+}
+
+std::string KbGenerator::symbolList(const std::vector<std::string> &symbols) const
+{
+    std::string list;
+    for (size_t i = 0; i < symbols.size(); ++i)
+    {
+        if (i != 0 && spec.vars > 26)
+            list.push_back(' ');
+        list += symbols[i];
+    }
+    return list;
+}
+
+std::string KbGenerator::expression(unsigned int depth)
+{
+    if (depth == 0 || below(3) == 0)
+        return literal(randomSymbol());
+    static const char ops[] = {'+', '|', '^'};
+    std::string lhs = expression(depth - 1);
+    std::string rhs = expression(depth - 1);
+    // a lone literal needs no parentheses, anything with an operator does
+    if (lhs.find(' ') != std::string::npos)
+        lhs = "(" + lhs + ")";
+    if (rhs.find(' ') != std::string::npos)
+        rhs = "(" + rhs + ")";
+    return lhs + " " + ops[below(3)] + " " + rhs;
+}
+
+void KbGenerator::addRule(const std::string &lhs, const std::string &arrow, const std::string &rhs)
+{
+    lines.push_back(lhs + " " + arrow + " " + rhs);
+}
+
+void KbGenerator::finish(const std::string &facts, const std::string &queries)
+{
+    lines.push_back("");
+    lines.push_back("=" + facts);
+    lines.push_back("?" + queries);
+}
+
+// S0 => S1 => ... => Sn-1
+void KbGenerator::genChain()
+{
+    unsigned int n = std::min(spec.vars, spec.rules + 1);
+    for (unsigned int i = 0; i + 1 < n; ++i)
+        addRule(symbol(i), "=>", symbol(i + 1));
+    finish(symbol(0), symbol(n - 1));
+}
+
+// every symbol is implied by its heap parent combined with an earlier symbol
+void KbGenerator::genDiamond()
+{
+    for (unsigned int i = 1; i < spec.vars; ++i)
+    {
+        std::string parent = symbol((i - 1) / 2);
+        std::string other = symbol(below(i));
+        std::string lhs = parent;
+        if (other != parent)
+            lhs += std::string(below(2) ? " + " : " | ") + other;
+        addRule(lhs, "=>", symbol(i));
+    }
+    std::vector<std::string> queries;
+    for (unsigned int i = spec.vars - std::min(3u, spec.vars - 1); i < spec.vars; ++i)
+        queries.push_back(symbol(i));
+    finish(symbol(0), symbolList(queries));
+}
+
+// S0 => S1 | S2 | ... (or S1 ^ (S2 | S3 | ...), as chained XOR conclusions
+// are rejected by LogicRule::deduceBasics) plus rules excluding some alternatives
+void KbGenerator::genWide(char op)
+{
+    std::string rhs;
+    for (unsigned int i = 1; i < spec.vars; ++i)
+    {
+        if (i == 2)
+            rhs += (op == '^') ? " ^ (" : " | ";
+        else if (i != 1)
+            rhs += " | ";
+        rhs += symbol(i);
+    }
+    if (op == '^' && spec.vars > 2)
+        rhs += ")";
+    addRule(symbol(0), "=>", rhs);
+    for (unsigned int i = 1; i < spec.rules; ++i)
+        addRule(literal(randomSymbol()), "=>", "!" + symbol(1 + below(spec.vars - 1)));
+    finish(symbol(0), symbolList({symbol(1), symbol(spec.vars - 1)}));
+}
+
+// random biconditionals between a symbol and a small expression
+void KbGenerator::genEquivWeb()
+{
+    for (unsigned int i = 0; i < spec.rules; ++i)
+        addRule(randomSymbol(), "<=>", expression(spec.depth ? spec.depth : 1));
+    std::string facts = randomSymbol();
+    // queries drawn last to first, as earlier generated files were
+    std::vector<std::string> queries(2);
+    for (size_t i = queries.size(); i-- > 0;)
+        queries[i] = randomSymbol();
+    finish(facts, symbolList(queries));
+}
+
+// a ring of implications with random chords, some of them negated
+void KbGenerator::genCycle()
+{
+    for (unsigned int i = 0; i < spec.vars; ++i)
+        addRule(symbol(i), "=>", symbol(i + 1));
+    for (unsigned int i = spec.vars; i < spec.rules; ++i)
+        addRule(literal(randomSymbol()), "=>", randomSymbol());
+    finish("", symbolList({symbol(0), symbol(spec.vars / 2)}));
+}
+
+void KbGenerator::genRandom()
+{
+    for (unsigned int i = 0; i < spec.rules; ++i)
+    {
+        std::string rhs = literal(randomSymbol());
+        unsigned int kind = below(10);
+        if (kind < 2)
+            rhs += " + " + literal(randomSymbol());
+        else if (kind == 2)
+            rhs += std::string(below(2) ? " | " : " ^ ") + randomSymbol();
+        addRule(expression(spec.depth), below(10) == 0 ? "<=>" : "=>", rhs);
+    }
+    std::vector<std::string> facts;
+    for (unsigned int i = 0; i < spec.vars; ++i)
+    {
+        if (below(4) == 0)
+            facts.push_back(symbol(i));
+    }
+    // queries drawn last to first, as earlier generated files were
+    std::vector<std::string> queries(3);
+    for (size_t i = queries.size(); i-- > 0;)
+        queries[i] = randomSymbol();
+    finish(symbolList(facts), symbolList(queries));
+}
+
+std::string KbGenerator::generate()
+{
+    lines.clear();
+    if (spec.shape == "chain")
+        genChain();
+    else if (spec.shape == "diamond")
+        genDiamond();
+    else if (spec.shape == "wide_or")
+        genWide('|');
+    else if (spec.shape == "wide_xor")
+        genWide('^');
+    else if (spec.shape == "equiv_web")
+        genEquivWeb();
+    else if (spec.shape == "cycle")
+        genCycle();
+    else if (spec.shape == "random")
+        genRandom();
+    else
+        throw std::invalid_argument("unknown shape: " + spec.shape);
+
+    std::ostringstream oss;
+    oss << "# generated: shape=" << spec.shape << " vars=" << spec.vars << " rules=" << spec.rules
+        << " depth=" << spec.depth << " seed=" << spec.seed << "\n";
+    for (const std::string &line : lines)
+        oss << line << "\n";
+    return oss.str();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Parameters of a generated knowledge base.
+ **/
+struct KbSpec
+{
+    /** chain, diamond, wide_or, wide_xor, equiv_web, cycle or random */
+    std::string shape = "random";
+    /** number of distinct symbols: letters up to 26, named s0, s1, ... past that */
+    unsigned int vars = 8;
+    /** number of source rules (shapes with a fixed structure may ignore it) */
+    unsigned int rules = 8;
+    /** maximum nesting depth of generated expressions */
+    unsigned int depth = 2;
+    uint64_t seed = 1;
+};
+
+/**
+ * Seeded generator of rule files in the input format of `expert`.
+ * The same spec always produces the same text.
+ **/
+class KbGenerator
+{
+public:
+    explicit KbGenerator(const KbSpec &spec);
+    /**
+     * names of every supported shape.
+     **/
+    static const std::vector<std::string> &shapes();
+    /**
+     * generate the rule file text, throw std::invalid_argument on an unknown shape.
+     **/
+    std::string generate();
+
+private:
+    static const unsigned int MAX_VARS = 4096;
+
+    KbSpec spec;
+    uint64_t state;
+    std::vector<std::string> lines;
+
+    /** xorshift64*, portable across standard libraries */
+    uint64_t next();
+    unsigned int below(unsigned int n);
+    std::string symbol(unsigned int i) const;
+    std::string randomSymbol();
+    std::string literal(const std::string &s);
+    /** a fact or query list: letters run together, names apart */
+    std::string symbolList(const std::vector<std::string> &symbols) const;
+    std::string expression(unsigned int depth);
+    void addRule(const std::string &lhs, const std::string &arrow, const std::string &rhs);
+    void finish(const std::string &facts, const std::string &queries);
+    void genChain();
+    void genDiamond();
+    void genWide(char op);
+    void genEquivWeb();
+    void genCycle();
+    void genRandom();
+};
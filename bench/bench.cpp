@@ -0,0 +1,248 @@
+// Benchmark harness: times each pipeline phase on generated knowledge bases.
+//
+//   expert_bench                       run the default suite
+//   expert_bench --shape S [--vars N] [--rules M] [--depth D] [--seed X]
+//   expert_bench ... --emit <file>     only write the generated rule file
+//   --repeat R                         runs per case, the median is reported
+//   --prove-threads T                  resolve with the parallel prover on T threads
+//
+// Results are printed as one JSON document on stdout.
+
+#include "KbGenerator.hpp"
+#include "Parser.hpp"
+#include "Resolver.hpp"
+#include "TruthTable.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+struct PhaseTimes
+{
+    double parse_us = 0;
+    double deduce_us = 0;
+    double tables_us = 0;
+    double conjunction_us = 0;
+    double resolve_us = 0;
+};
+
+struct CaseResult
+{
+    KbSpec spec;
+    size_t logic_rules = 0;
+    size_t basic_rules = 0;
+    size_t combined_states = 0;
+    PhaseTimes median;
+    std::string error;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedUs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+/**
+ * One run of the pipeline, phase by phase, mirroring Parser::expandRules.
+ */
+static PhaseTimes runOnce(const std::string &text, unsigned int prove_threads, CaseResult &result)
+{
+    PhaseTimes times;
+
+    Clock::time_point start = Clock::now();
+    Parser parser("<bench>");
+    std::istringstream in(text);
+    parser.parsingManager(in);
+    parser.finalizeParsing();
+    times.parse_us = elapsedUs(start);
+
+    start = Clock::now();
+    std::vector<BasicRule> basic_rules;
+    for (const LogicRule &rule : parser.getFacts())
+    {
+        std::vector<BasicRule> basics = rule.deduceBasics();
+        basic_rules.insert(basic_rules.end(), basics.begin(), basics.end());
+    }
+    times.deduce_us = elapsedUs(start);
+
+    start = Clock::now();
+    std::vector<TruthTable> tables;
+    tables.reserve(basic_rules.size());
+    for (const BasicRule &rule : basic_rules)
+        tables.push_back(TruthTable::fromBasicRule(rule));
+    times.tables_us = elapsedUs(start);
+
+    start = Clock::now();
+    TruthTable combined = TruthTable::conjunctionAll(tables);
+    times.conjunction_us = elapsedUs(start);
+
+    start = Clock::now();
+    Resolver resolver(parser.getQuerie(), basic_rules, parser.getInitialFact(), combined);
+    resolver.setProveThreads(prove_threads);
+    resolver.evaluate();
+    times.resolve_us = elapsedUs(start);
+
+    result.logic_rules = parser.getFacts().size();
+    result.basic_rules = basic_rules.size();
+    result.combined_states = combined.countValidStates();
+    return times;
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values.empty() ? 0 : values[values.size() / 2];
+}
+
+static CaseResult runCase(const KbSpec &spec, unsigned int repeat, unsigned int prove_threads)
+{
+    CaseResult result;
+    result.spec = spec;
+    std::vector<PhaseTimes> runs;
+    try
+    {
+        std::string text = KbGenerator(spec).generate();
+        for (unsigned int i = 0; i < repeat; ++i)
+            runs.push_back(runOnce(text, prove_threads, result));
+    }
+    catch (const std::exception &e)
+    {
+        result.error = e.what();
+        return result;
+    }
+
+    std::vector<double> parse, deduce, tables, conjunction, resolve;
+    for (const PhaseTimes &t : runs)
+    {
+        parse.push_back(t.parse_us);
+        deduce.push_back(t.deduce_us);
+        tables.push_back(t.tables_us);
+        conjunction.push_back(t.conjunction_us);
+        resolve.push_back(t.resolve_us);
+    }
+    result.median.parse_us = median(parse);
+    result.median.deduce_us = median(deduce);
+    result.median.tables_us = median(tables);
+    result.median.conjunction_us = median(conjunction);
+    result.median.resolve_us = median(resolve);
+    return result;
+}
+
+static std::string jsonEscape(const std::string &s)
+{
+    std::string out;
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out.push_back('\\');
+        if (c == '\n')
+            continue;
+        out.push_back(c);
+    }
+    return out;
+}
+
+static void printResult(const CaseResult &r, bool last)
+{
+    std::cout << "    {\"shape\":\"" << r.spec.shape << "\",\"vars\":" << r.spec.vars
+              << ",\"rules\":" << r.spec.rules << ",\"depth\":" << r.spec.depth
+              << ",\"seed\":" << r.spec.seed;
+    if (!r.error.empty())
+        std::cout << ",\"error\":\"" << jsonEscape(r.error) << "\"";
+    else
+        std::cout << ",\"logic_rules\":" << r.logic_rules << ",\"basic_rules\":" << r.basic_rules
+                  << ",\"combined_states\":" << r.combined_states
+                  << ",\"parse_us\":" << r.median.parse_us
+                  << ",\"deduce_us\":" << r.median.deduce_us
+                  << ",\"tables_us\":" << r.median.tables_us
+                  << ",\"conjunction_us\":" << r.median.conjunction_us
+                  << ",\"resolve_us\":" << r.median.resolve_us;
+    std::cout << "}" << (last ? "" : ",") << "\n";
+}
+
+static std::vector<KbSpec> defaultSuite()
+{
+    std::vector<KbSpec> suite;
+    struct Entry { const char *shape; unsigned int vars; unsigned int rules; unsigned int depth; };
+    static const Entry entries[] = {
+        {"chain", 8, 7, 1}, {"chain", 16, 15, 1},
+        {"diamond", 8, 7, 1}, {"diamond", 12, 11, 1},
+        {"wide_or", 6, 3, 1}, {"wide_or", 8, 4, 1},
+        {"wide_xor", 5, 3, 1}, {"wide_xor", 7, 4, 1},
+        {"equiv_web", 6, 4, 1}, {"equiv_web", 8, 6, 2},
+        {"cycle", 6, 8, 1}, {"cycle", 10, 14, 1},
+        {"random", 6, 6, 1}, {"random", 8, 10, 2}, {"random", 10, 12, 2},
+    };
+    for (const Entry &e : entries)
+    {
+        KbSpec spec;
+        spec.shape = e.shape;
+        spec.vars = e.vars;
+        spec.rules = e.rules;
+        spec.depth = e.depth;
+        suite.push_back(spec);
+    }
+    return suite;
+}
+
+int main(int argc, char **argv)
+{
+    KbSpec spec;
+    bool single = false;
+    unsigned int repeat = 5;
+    unsigned int prove_threads = 1;
+    std::string emit_path;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+            return (std::cerr << "Missing value for option: " << arg << std::endl, 1);
+        std::string value = argv[++i];
+        if (arg == "--shape")
+        {
+            spec.shape = value;
+            single = true;
+        }
+        else if (arg == "--vars")
+            spec.vars = static_cast<unsigned int>(std::stoul(value));
+        else if (arg == "--rules")
+            spec.rules = static_cast<unsigned int>(std::stoul(value));
+        else if (arg == "--depth")
+            spec.depth = static_cast<unsigned int>(std::stoul(value));
+        else if (arg == "--seed")
+            spec.seed = std::stoull(value);
+        else if (arg == "--repeat")
+            repeat = static_cast<unsigned int>(std::max(1ul, std::stoul(value)));
+        else if (arg == "--prove-threads")
+            prove_threads = static_cast<unsigned int>(std::stoul(value));
+        else if (arg == "--emit")
+            emit_path = value;
+        else
+            return (std::cerr << "Unknown option: " << arg << std::endl, 1);
+    }
+
+    if (!emit_path.empty())
+    {
+        std::ofstream out(emit_path);
+        if (!out)
+            return (std::cerr << "Error: cannot open file " << emit_path << std::endl, 1);
+        try
+        {
+            out << KbGenerator(spec).generate();
+        }
+        catch (const std::exception &e)
+        {
+            return (std::cerr << "Error: " << e.what() << std::endl, 1);
+        }
+        return 0;
+    }
+
+    std::vector<KbSpec> suite = single ? std::vector<KbSpec>(1, spec) : defaultSuite();
+    std::cout << "{\n  \"repeat\":" << repeat << ",\n  \"results\":[\n";
+    for (size_t i = 0; i < suite.size(); ++i)
+        printResult(runCase(suite[i], repeat, prove_threads), i + 1 == suite.size());
+    std::cout << "  ]\n}" << std::endl;
+    return 0;
+}
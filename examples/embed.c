@@ -0,0 +1,71 @@
+/*
+ * Minimal libexpert embedding: load rules from memory, then answer the
+ * same queries for several fact sets without re-parsing anything. The rete
+ * engine only re-evaluates the rules touched by the facts that changed.
+ *
+ *   make example && ./expert_embed
+ */
+
+#include <stdio.h>
+#include "expert.h"
+
+static const char RULES[] =
+    "A + B => C\n"
+    "C | D => E\n"
+    "E => !F\n"
+    "?CEF\n";
+
+static const char *valueName(expert_value value)
+{
+    if (value == EXPERT_TRUE)
+        return "true";
+    if (value == EXPERT_FALSE)
+        return "false";
+    return "ambiguous";
+}
+
+int main(void)
+{
+    const char *fact_sets[] = {"", "AB", "D", "ABD"};
+    expert_kb *kb = NULL;
+    expert_ctx *ctx = NULL;
+    expert_value results[3];
+    char queries[27];
+    char explain[1024];
+    size_t i;
+    size_t j;
+
+    if (expert_kb_load_buffer(RULES, sizeof(RULES) - 1, &kb) != EXPERT_OK
+        || expert_kb_queries(kb, queries, sizeof(queries)) != EXPERT_OK
+        || expert_ctx_create(kb, &ctx) != EXPERT_OK
+        || expert_ctx_set_engine(ctx, "rete") != EXPERT_OK)
+    {
+        fprintf(stderr, "Error: %s\n", expert_last_error());
+        expert_kb_free(kb);
+        return 1;
+    }
+
+    for (i = 0; i < sizeof(fact_sets) / sizeof(fact_sets[0]); ++i)
+    {
+        if (expert_ctx_set_facts(ctx, fact_sets[i]) != EXPERT_OK
+            || expert_resolve(ctx, NULL, results, 3) != EXPERT_OK)
+        {
+            fprintf(stderr, "Error: %s\n", expert_last_error());
+            continue;
+        }
+        printf("facts=%-4s", fact_sets[i]);
+        for (j = 0; queries[j]; ++j)
+            printf(" %c=%s", queries[j], valueName(results[j]));
+        printf("\n");
+    }
+
+    expert_ctx_set_explain(ctx, 1);
+    expert_ctx_set_facts(ctx, "D");
+    if (expert_resolve(ctx, "F", results, 1) == EXPERT_OK
+        && expert_explain(ctx, "F", explain, sizeof(explain), NULL) == EXPERT_OK)
+        printf("%s", explain);
+
+    expert_ctx_free(ctx);
+    expert_kb_free(kb);
+    return 0;
+}
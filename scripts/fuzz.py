@@ -0,0 +1,239 @@
+#!/usr/bin/env python3
+"""Differential fuzzer: runs random rule files through every engine of the
+expert binary, and shrinks the cases where engines disagree into minimal
+test files (tests/ format, with '# Expected:' lines from the oracle)."""
+import argparse
+import os
+import random
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+ORACLE = "bruteforce"
+
+
+def list_engines(binary):
+    proc = subprocess.run([binary, "--list-engines"], stdout=subprocess.PIPE, text=True, check=True)
+    return [line.strip() for line in proc.stdout.splitlines() if line.strip()]
+
+
+class Generator:
+    def __init__(self, rng, variables, rules, depth, horn=False, two_sat=False):
+        self.rng = rng
+        self.symbols = [chr(ord("A") + i) for i in range(variables)]
+        self.rules = rules
+        self.depth = depth
+        self.horn = horn
+        self.two_sat = two_sat
+
+    def literal(self):
+        sym = self.rng.choice(self.symbols)
+        return ("!" if self.rng.random() < 0.25 else "") + sym
+
+    def expression(self, depth):
+        if depth == 0 or self.rng.random() < 0.35:
+            return self.literal()
+        left = self.expression(depth - 1)
+        right = self.expression(depth - 1)
+        if len(left) > 2:
+            left = f"({left})"
+        if len(right) > 2:
+            right = f"({right})"
+        expr = f"{left} {self.rng.choice('+|^')} {right}"
+        if self.rng.random() < 0.1:
+            expr = f"!({expr})"
+        return expr
+
+    def conclusion(self):
+        # chained XOR conclusions are rejected by the parser, keep at most one
+        kind = self.rng.random()
+        if kind < 0.6:
+            return self.literal()
+        if kind < 0.8:
+            return f"{self.literal()} + {self.literal()}"
+        a, b = self.rng.sample(self.symbols, 2)
+        return f"{a} {self.rng.choice('|^')} {b}"
+
+    def horn_rule(self):
+        premises = self.rng.sample(self.symbols, self.rng.randint(1, min(3, len(self.symbols))))
+        conclusion = " + ".join(self.rng.sample(self.symbols, self.rng.randint(1, 2)))
+        return f"{' + '.join(premises)} => {conclusion}"
+
+    def binary_rule(self):
+        # rules whose clause form has at most two literals, plus the odd wider one
+        # the wide rule needs three distinct symbols, --vars may leave only two
+        picked = self.rng.sample(self.symbols, min(3, len(self.symbols)))
+        a, b = picked[0], picked[1]
+        kind = self.rng.random()
+        if kind < 0.35:
+            return f"{self.literal()} => {self.literal()}"
+        if kind < 0.55:
+            return f"{self.literal()} | {self.literal()} => {self.literal()}"
+        if kind < 0.7:
+            return f"{self.literal()} => {a} + {b}"
+        if kind < 0.85:
+            return f"{self.literal()} <=> {self.literal()}"
+        if len(picked) < 3:
+            return f"{self.literal()} => {self.literal()}"
+        return f"{a} + {b} => {picked[2]}"
+
+    def case(self):
+        rules = []
+        for _ in range(self.rng.randint(1, self.rules)):
+            if self.horn:
+                rules.append(self.horn_rule())
+            elif self.two_sat:
+                rules.append(self.binary_rule())
+            elif self.rng.random() < 0.15:
+                rules.append(f"{self.expression(1)} <=> {self.literal()}")
+            else:
+                rules.append(f"{self.expression(self.depth)} => {self.conclusion()}")
+        facts = "".join(s for s in self.symbols if self.rng.random() < 0.25)
+        queries = "".join(s for s in self.symbols if self.rng.random() < 0.5) or self.symbols[0]
+        return {"rules": rules, "facts": facts, "queries": queries}
+
+
+def render(case):
+    return "\n".join(case["rules"]) + f"\n\n={case['facts']}\n?{case['queries']}\n"
+
+
+def run_engine(binary, path, engine, timeout):
+    try:
+        proc = subprocess.run(
+            [binary, path, "--engine", engine],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            text=True,
+            timeout=timeout,
+            check=False,
+        )
+    except subprocess.TimeoutExpired:
+        return ("timeout", "")
+    if proc.returncode < 0:
+        return ("crash", str(-proc.returncode))
+    return (proc.returncode, proc.stdout.strip())
+
+
+def outcomes(binary, case, engines, timeout):
+    fd, path = tempfile.mkstemp(suffix=".txt", prefix="expert_fuzz_")
+    try:
+        with os.fdopen(fd, "w", encoding="utf-8") as f:
+            f.write(render(case))
+        return {engine: run_engine(binary, path, engine, timeout) for engine in engines}
+    finally:
+        os.unlink(path)
+
+
+def disagree(results):
+    return len(set(results.values())) > 1
+
+
+def shrink(binary, case, engines, timeout):
+    """Greedily drop rules, facts and queries, and strip negations, while the engines still disagree."""
+
+    def still_fails(candidate):
+        return candidate["rules"] and candidate["queries"] and disagree(outcomes(binary, candidate, engines, timeout))
+
+    changed = True
+    while changed:
+        changed = False
+        for i in range(len(case["rules"]) - 1, -1, -1):
+            candidate = dict(case, rules=case["rules"][:i] + case["rules"][i + 1:])
+            if still_fails(candidate):
+                case, changed = candidate, True
+        for field in ("facts", "queries"):
+            for sym in case[field]:
+                candidate = dict(case, **{field: case[field].replace(sym, "")})
+                if still_fails(candidate):
+                    case, changed = candidate, True
+        for i, rule in enumerate(case["rules"]):
+            for pos in [p for p, c in enumerate(rule) if c == "!"]:
+                simpler = rule[:pos] + rule[pos + 1:]
+                candidate = dict(case, rules=case["rules"][:i] + [simpler] + case["rules"][i + 1:])
+                if still_fails(candidate):
+                    case, changed = candidate, True
+                    break
+    return case
+
+
+def write_case(out_dir, name, case, results):
+    out_dir.mkdir(parents=True, exist_ok=True)
+    path = out_dir / f"{name}.txt"
+    if disagree(results):
+        lines = ["# Found by scripts/fuzz.py: engines disagree"]
+        for engine, (code, stdout) in sorted(results.items()):
+            lines.append(f"#   {engine} (exit {code}): {' | '.join(stdout.splitlines())}")
+    else:
+        # a recorded case: run_tests.py checks it again through every engine,
+        # and through the tables restricted to the facts
+        lines = ["# Recorded by scripts/fuzz.py: every engine agrees"]
+        runs = [f"--engine {engine}" for engine in sorted(results)] + ["--push-facts"]
+        lines.append("# Runs: " + " | ".join(runs))
+    lines.extend(case["rules"])
+    code, stdout = results.get(ORACLE, next(iter(results.values())))
+    if code == 0:
+        lines.append("# Expected: " + ", ".join(stdout.splitlines()))
+    else:
+        lines.append("# Expected: no valid state")
+    lines.extend(["", f"={case['facts']}", f"?{case['queries']}", ""])
+    path.write_text("\n".join(lines), encoding="utf-8")
+    return path
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Differential fuzzing of the expert engines.")
+    parser.add_argument("--binary", default="./expert", help="Path to the expert binary (default: ./expert)")
+    parser.add_argument("--iterations", type=int, default=200, help="Number of generated cases (default: 200)")
+    parser.add_argument("--seed", type=int, default=None, help="Random seed (default: random)")
+    parser.add_argument("--vars", type=int, default=6, help="Symbols per case, at most 20 (default: 6)")
+    parser.add_argument("--rules", type=int, default=6, help="Maximum rules per case (default: 6)")
+    parser.add_argument("--depth", type=int, default=2, help="Maximum expression depth (default: 2)")
+    parser.add_argument("--horn", action="store_true", help="Only generate Horn rules (AND of symbols => symbols)")
+    parser.add_argument("--two-sat", action="store_true", help="Mostly generate rules of at most two literals per clause")
+    parser.add_argument("--engines", help="Comma separated engines (default: every engine)")
+    parser.add_argument("--timeout", type=float, default=10.0, help="Seconds per run (default: 10)")
+    parser.add_argument("--out-dir", default="tests/fuzz", help="Where shrunk cases go (default: tests/fuzz)")
+    parser.add_argument("--max-failures", type=int, default=5, help="Stop after this many failures (default: 5)")
+    parser.add_argument("--record", type=int, default=0,
+                        help="Also write the first N cases the engines agree on, as regression tests (default: 0)")
+    args = parser.parse_args()
+
+    engines = args.engines.split(",") if args.engines else list_engines(args.binary)
+    if len(engines) < 2:
+        print("Error: need at least two engines to compare", file=sys.stderr)
+        return 2
+    seed = args.seed if args.seed is not None else random.randrange(1 << 32)
+    rng = random.Random(seed)
+    generator = Generator(rng, max(2, min(args.vars, 20)), max(1, args.rules), max(0, args.depth), args.horn, args.two_sat)
+    print(f"seed {seed}, engines: {', '.join(engines)}")
+
+    failures = 0
+    recorded = 0
+    for i in range(args.iterations):
+        case = generator.case()
+        results = outcomes(args.binary, case, engines, args.timeout)
+        if not disagree(results):
+            # a case without a valid state prints no value to check
+            code, stdout = results[engines[0]]
+            if recorded < args.record and code == 0 and "=" in stdout:
+                write_case(Path(args.out_dir), f"case_{seed}_{i}", case, results)
+                recorded += 1
+            continue
+        case = shrink(args.binary, case, engines, args.timeout)
+        results = outcomes(args.binary, case, engines, args.timeout)
+        path = write_case(Path(args.out_dir), f"fuzz_{seed}_{i}", case, results)
+        print(f"case {i}: engines disagree, shrunk to {path}")
+        failures += 1
+        if failures >= args.max_failures:
+            break
+
+    summary = f"Total: {i + 1 if args.iterations else 0} | Disagreements: {failures}"
+    if args.record:
+        summary += f" | Recorded: {recorded}"
+    print(summary)
+    return 0 if failures == 0 else 1
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,283 @@
+#!/usr/bin/env python3
+"""Checks of the request protocols: --pipe and --serve replies, the result
+cache, request budgets, and the EXPERT_PARTIAL status of the C API."""
+import argparse
+import ctypes
+import json
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+from pathlib import Path
+
+KB = "A + B => C\nA => D\n\n=A\n?C\n"
+# proving each symbol of a long chain walks the chain again: slow enough
+# that a 1 ms budget always runs out
+CHAIN_LENGTH = 1500
+EXPERT_PARTIAL = 7
+# Server::MAX_LINE
+MAX_LINE = 1 << 16
+
+
+def chain_kb():
+    rules = "\n".join(f"s{i} => s{i + 1}" for i in range(CHAIN_LENGTH))
+    return f"{rules}\n\n=s0\n?s{CHAIN_LENGTH}\n"
+
+
+def run_pipe(binary, kb_path, lines, *options):
+    proc = subprocess.run(
+        [binary, kb_path, "--pipe", *options],
+        input="".join(line + "\n" for line in lines),
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE,
+        text=True,
+        check=False,
+    )
+    return proc.returncode, [json.loads(line) for line in proc.stdout.splitlines()], proc.stderr
+
+
+def check_pipe_ids(binary, kb_path):
+    code, replies, _ = run_pipe(binary, kb_path, ["=A ?C", "id=x =AB ?CD", "# comment", "", "?C"])
+    ids = [r["id"] for r in replies]
+    if code != 0 or ids != ["1", "x", "5"]:
+        return f"ids {ids}, exit code {code}: expected record numbers and id= tags, comments skipped"
+    if replies[1]["results"] != {"C": "true", "D": "true"}:
+        return f"results {replies[1]['results']}"
+    return ""
+
+
+def check_pipe_errors(binary, kb_path):
+    code, replies, _ = run_pipe(binary, kb_path, ["=1 ?C", "id=e ?C timeout_ms=x", "?C"])
+    if code != 0 or len(replies) != 3:
+        return f"{len(replies)} replies, exit code {code}"
+    for reply in replies[:2]:
+        if reply["ok"] or not reply.get("error"):
+            return f"expected an error reply: {reply}"
+    if replies[1]["id"] != "e" or not replies[2]["ok"]:
+        return f"an error must keep its id and not stop the batch: {replies}"
+    return ""
+
+
+def check_pipe_escaping(binary, kb_path):
+    tag = 'a\x01"b\\'
+    code, replies, _ = run_pipe(binary, kb_path, [f"id={tag} ?C"])
+    # json.loads already failed above on an unescaped control character
+    if code != 0 or replies[0]["id"] != tag:
+        return f"id {replies[0]['id']!r}, expected {tag!r}"
+    return ""
+
+
+def check_cache(binary, kb_path):
+    lines = ["=AB ?C", "=BA ?C", "=A ?C", "=BA ?C explain"]
+    code, replies, stderr = run_pipe(binary, kb_path, lines, "--cache-mb", "1", "--stats")
+    stats = [json.loads(line)["cache"] for line in stderr.splitlines() if line.startswith('{"cache"')]
+    if code != 0 or not stats:
+        return f"no cache statistics, exit code {code}"
+    # the fact sets of the first two lines differ only in order; explain bypasses the cache
+    if (stats[0]["hits"], stats[0]["misses"]) != (1, 2):
+        return f"hits {stats[0]['hits']}, misses {stats[0]['misses']}: expected 1 and 2"
+    values = [r["results"]["C"] for r in replies]
+    if values != ["true", "true", "false", "true"]:
+        return f"values {values}"
+    return ""
+
+
+def check_partial(binary, chain_path):
+    code, replies, _ = run_pipe(binary, chain_path, ["id=slow timeout_ms=1", "id=full"])
+    if code != 0 or replies[0].get("partial") != "timeout" or not replies[0]["ok"]:
+        return f"expected a partial reply out of time: {replies[0]}"
+    if "partial" in replies[1]:
+        return f"a request without budget must complete: {replies[1]}"
+    proc = subprocess.run(
+        [binary, chain_path, "--timeout-ms", "1"], stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True, check=False
+    )
+    if proc.returncode != 2 or "request budget exceeded" not in proc.stderr:
+        return f"the CLI out of budget must exit with 2, got {proc.returncode}"
+    return ""
+
+
+def check_c_api_partial(library):
+    lib = ctypes.CDLL(str(library))
+    lib.expert_last_error.restype = ctypes.c_char_p
+    kb = ctypes.c_void_p()
+    ctx = ctypes.c_void_p()
+    data = KB.encode()
+    if lib.expert_kb_load_buffer(data, ctypes.c_size_t(len(data)), ctypes.byref(kb)) != 0:
+        return f"load: {lib.expert_last_error().decode()}"
+    try:
+        if lib.expert_ctx_create(kb, ctypes.byref(ctx)) != 0:
+            return f"context: {lib.expert_last_error().decode()}"
+        results = (ctypes.c_int * 1)()
+        status = lib.expert_resolve(ctx, b"C", results, ctypes.c_size_t(1))
+        if status != 0:
+            return f"resolve without budget: status {status}"
+        # one byte of resolver state runs out on the first proof step
+        lib.expert_ctx_set_budget(ctx, ctypes.c_ulong(0), ctypes.c_size_t(1))
+        status = lib.expert_resolve(ctx, b"C", results, ctypes.c_size_t(1))
+        if status != EXPERT_PARTIAL or b"memory" not in lib.expert_last_error():
+            return f"resolve out of budget: status {status}, expected EXPERT_PARTIAL"
+        lib.expert_ctx_free(ctx)
+        return ""
+    finally:
+        lib.expert_kb_free(kb)
+
+
+class Server:
+    def __init__(self, binary, kb_path, socket_path, workers):
+        self.socket_path = socket_path
+        self.proc = subprocess.Popen(
+            [binary, kb_path, "--serve", socket_path, "--workers", str(workers)],
+            stdout=subprocess.DEVNULL,
+            stderr=subprocess.PIPE,
+            text=True,
+        )
+        deadline = time.monotonic() + 10
+        while not os.path.exists(socket_path):
+            if self.proc.poll() is not None or time.monotonic() > deadline:
+                raise RuntimeError(f"server did not start: {self.proc.stderr.read() if self.proc.stderr else ''}")
+            time.sleep(0.01)
+
+    def connect(self):
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        sock.settimeout(10)
+        sock.connect(self.socket_path)
+        return sock
+
+    def stop(self):
+        self.proc.terminate()
+        try:
+            return self.proc.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            self.proc.kill()
+            return None
+
+
+def read_replies(sock, count):
+    buffer = b""
+    while buffer.count(b"\n") < count:
+        data = sock.recv(65536)
+        if not data:
+            break
+        buffer += data
+    return [json.loads(line) for line in buffer.decode().splitlines()]
+
+
+def check_serve_order(server):
+    # far more requests than a client may queue, sent while the replies are
+    # read, so the server has to stop reading and resume in order
+    count = 2000
+    lines = "".join(f"id={i} ={'AB' if i % 3 else 'A'} ?CD{' explain' if i % 7 == 0 else ''}\n" for i in range(count))
+    sock = server.connect()
+    try:
+        sender = threading.Thread(target=sock.sendall, args=(lines.encode(),))
+        sender.start()
+        replies = read_replies(sock, count)
+        sender.join()
+    finally:
+        sock.close()
+    ids = [r["id"] for r in replies]
+    if ids != [str(i) for i in range(count)]:
+        return f"{len(ids)} replies, first out of order at {next((i for i, v in enumerate(ids) if v != str(i)), len(ids))}"
+    wrong = [r["id"] for r in replies if r["results"]["C"] != ("true" if int(r["id"]) % 3 else "false")]
+    if wrong:
+        return f"wrong values for ids {wrong[:5]}"
+    return ""
+
+
+def check_serve_long_line(server):
+    sock = server.connect()
+    try:
+        try:
+            sock.sendall(b"?" + b"A" * MAX_LINE + b"A")
+            closed = sock.recv(4096) == b""
+        except ConnectionResetError:
+            closed = True
+    finally:
+        sock.close()
+    if not closed:
+        return "a line over MAX_LINE must close the connection"
+    # the server keeps serving the other clients
+    sock = server.connect()
+    try:
+        sock.sendall(b"id=after ?C\n")
+        replies = read_replies(sock, 1)
+    finally:
+        sock.close()
+    if [r["id"] for r in replies] != ["after"]:
+        return f"no reply after a refused line: {replies}"
+    return ""
+
+
+def check_serve_escaping(server):
+    tag = 'q\x1f"\\'
+    sock = server.connect()
+    try:
+        sock.sendall(f"id={tag} ?C\nid=bad =1\n".encode())
+        replies = read_replies(sock, 2)
+    finally:
+        sock.close()
+    if len(replies) != 2 or replies[0]["id"] != tag:
+        return f"replies {replies}, expected the id {tag!r}"
+    if replies[1]["ok"] or "invalid symbol" not in replies[1]["error"]:
+        return f"expected an error reply: {replies[1]}"
+    return ""
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Check the --pipe and --serve protocols and the C API budget.")
+    parser.add_argument("--binary", default="./expert", help="Path to the expert binary (default: ./expert)")
+    parser.add_argument("--library", default="./libexpert.so", help="Path to the shared library (default: ./libexpert.so)")
+    parser.add_argument("--workers", type=int, default=4, help="Workers of the --serve checks (default: 4)")
+    args = parser.parse_args()
+
+    if not Path(args.library).is_file():
+        print(f"Error: library not found: {args.library} (make lib)", file=sys.stderr)
+        return 2
+
+    results = []
+    with tempfile.TemporaryDirectory(prefix="expert_protocol_") as tmp:
+        kb_path = os.path.join(tmp, "kb.txt")
+        chain_path = os.path.join(tmp, "chain.txt")
+        Path(kb_path).write_text(KB, encoding="utf-8")
+        Path(chain_path).write_text(chain_kb(), encoding="utf-8")
+
+        checks = [
+            ("pipe ids", lambda: check_pipe_ids(args.binary, kb_path)),
+            ("pipe errors", lambda: check_pipe_errors(args.binary, kb_path)),
+            ("pipe escaping", lambda: check_pipe_escaping(args.binary, kb_path)),
+            ("cache hits", lambda: check_cache(args.binary, kb_path)),
+            ("partial results", lambda: check_partial(args.binary, chain_path)),
+            ("C API partial", lambda: check_c_api_partial(Path(args.library).resolve())),
+        ]
+        for name, check in checks:
+            results.append((name, check()))
+
+        server = Server(args.binary, kb_path, os.path.join(tmp, "expert.sock"), args.workers)
+        try:
+            for name, check in [
+                ("serve order", check_serve_order),
+                ("serve long line", check_serve_long_line),
+                ("serve escaping", check_serve_escaping),
+            ]:
+                try:
+                    results.append((name, check(server)))
+                except (OSError, ValueError) as e:
+                    results.append((name, f"{type(e).__name__}: {e}"))
+        finally:
+            code = server.stop()
+        results.append(("serve stop", "" if code == 0 else f"exit code {code} on SIGTERM"))
+
+    failed = [r for r in results if r[1]]
+    for name, detail in results:
+        print(f"{name} : {'ko' if detail else 'ok'}")
+        if detail:
+            print(f"  {detail}")
+    print(f"Total: {len(results)} | OK: {len(results) - len(failed)} | Failed: {len(failed)}")
+    return 0 if not failed else 1
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
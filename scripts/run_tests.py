@@ -7,10 +7,12 @@ import sys
 from pathlib import Path
 
 
-def run_test(binary, test_path, explain):
-    cmd = [binary, str(test_path)]
+def run_test(binary, test_path, explain, prove_threads=None, options=()):
+    cmd = [binary, str(test_path), *options]
     if explain:
         cmd.append("--explain")
+    if prove_threads is not None:
+        cmd += ["--prove-threads", str(prove_threads)]
     proc = subprocess.run(
         cmd,
         stdout=subprocess.PIPE,
@@ -20,12 +22,13 @@ def run_test(binary, test_path, explain):
     )
     return {
         "test": str(test_path),
+        "options": " ".join(options),
         "code": proc.returncode,
         "stdout": proc.stdout.strip(),
         "stderr": proc.stderr.strip(),
     }
 
-EXPECTED_RE = re.compile(r"\b([A-Z])\s*=\s*(true|false|ambiguous|ambigous)\b", re.IGNORECASE)
+EXPECTED_RE = re.compile(r"\b([A-Za-z_][A-Za-z0-9_]*)\s*=\s*(true|false|ambiguous|ambigous)\b", re.IGNORECASE)
 
 
 def parse_expected(test_path):
@@ -49,6 +52,24 @@ def parse_expected(test_path):
     return expected, conflicts
 
 
+def parse_expected_error(test_path):
+    """Text the binary must print on stderr while failing, None for a test that must succeed."""
+    for line in test_path.read_text(encoding="utf-8").splitlines():
+        stripped = line.strip()
+        if stripped.startswith("#") and "Expected error:" in stripped:
+            return stripped.split("Expected error:", 1)[1].strip()
+    return None
+
+
+def parse_runs(test_path):
+    """Option sets of a '# Runs: --engine horn | --push-facts' line, one run each; a single plain run without it."""
+    for line in test_path.read_text(encoding="utf-8").splitlines():
+        stripped = line.strip()
+        if stripped.startswith("#") and "Runs:" in stripped:
+            return [run.split() for run in stripped.split("Runs:", 1)[1].split("|")]
+    return [[]]
+
+
 def parse_actual(stdout):
     actual = {}
     for line in stdout.splitlines():
@@ -102,6 +123,11 @@ def main():
         action="store_true",
         help="Pass --explain to the binary",
     )
+    parser.add_argument(
+        "--prove-threads",
+        type=int,
+        help="Pass --prove-threads to the binary (0 for one per core)",
+    )
     parser.add_argument(
         "--json",
         dest="json_path",
@@ -138,13 +164,20 @@ def main():
         return 2
 
     results = []
-    for test_path in test_files:
-        result = run_test(args.binary, test_path, args.explain)
+    runs = [(test_path, options) for test_path in test_files for options in parse_runs(test_path)]
+    for test_path, options in runs:
+        result = run_test(args.binary, test_path, args.explain, args.prove_threads, options)
         expected, conflicts = parse_expected(test_path)
+        expected_error = parse_expected_error(test_path)
         actual = parse_actual(result["stdout"])
         ok = result["code"] == 0
         detail = ""
-        if ok:
+        if expected_error is not None:
+            # a negative code is a signal: an abort is not a clean failure
+            ok = result["code"] > 0 and expected_error in result["stderr"]
+            if not ok:
+                detail = f"expected a failure with: {expected_error} (exit code {result['code']})"
+        elif ok:
             ok, detail = evaluate_result(expected, conflicts, actual)
         else:
             detail = result["stderr"] or "non-zero exit code"
@@ -160,7 +193,8 @@ def main():
         status = "ok" if r["ok"] else "ko"
         if args.only_fail and r["ok"]:
             continue
-        print(f"{Path(r['test']).name} : {status}")
+        name = Path(r["test"]).name + (f" [{r['options']}]" if r["options"] else "")
+        print(f"{name} : {status}")
         if not r["ok"] and r["detail"]:
             print(f"  {r['detail']}")
         if args.verbose and r["stdout"]:
@@ -1,31 +1,127 @@
 #include "App.hpp"
+#include "Engine.hpp"
 #include "Parser.hpp"
+#include "QueryProtocol.hpp"
 #include "Resolver.hpp"
+#include "ResultCache.hpp"
+#include "Server.hpp"
+#include "Timeline.hpp"
 #include <iostream>
+#include <thread>
 
 int App::run(int argc, char **argv)
 {
+    if (argc == 2 && std::string(argv[1]) == "--list-engines")
+    {
+        for (const std::string &name : Engine::names())
+            std::cout << name << '\n';
+        return 0;
+    }
     if (!isUsageCorrect(argc, argv))
         return 1;
     if (!parseArgs(argc, argv))
         return 1;
 
+    if (timeline_path.empty())
+        return execute();
+    Timeline::enable();
+    int status = execute();
+    if (!Timeline::write(timeline_path))
+    {
+        std::cerr << "Error: cannot write timeline " << timeline_path << std::endl;
+        return 1;
+    }
+    return status;
+}
+
+int App::execute()
+{
     Parser parser(input_path);
-    if (parser.parse() != 0)
+    if (stats_enabled || profile_enabled)
+        parser.setStats(&stats);
+    parser.setBudget(budget);
+    // the daemon and pipe modes budget each request instead of the loading
+    RequestBudget request_budget(request_limits);
+    bool budgeted = request_limits.isLimited() && !pipe_mode && serve_path.empty();
+    if (budgeted)
+        parser.setRequestBudget(&request_budget);
+    // the daemon and pipe modes answer other facts, they need the full table
+    parser.setFactPushdown(push_facts && !pipe_mode && serve_path.empty());
+    // the daemon and pipe modes always resolve on the combined table
+    std::unique_ptr<Engine> engine;
+    if (engine_name != "table" && !pipe_mode && serve_path.empty())
+    {
+        engine = Engine::create(engine_name);
+        parser.setJoinTables(engine->needsCombinedTable());
+    }
+    int parse_status;
+    try
+    {
+        parse_status = parser.parse();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
         return 1;
-    if (!parser.getCombinedTruthTable().hasValidState())
+    }
+    if (expansion_report && (parse_status == 0 || !parser.getExpansionReport().budget_exceeded.empty()))
+        parser.getExpansionReport().print(std::cerr, parser.getFacts());
+    if (parse_status != 0)
+        return 1;
+    if (engine)
+        return runEngine(parser, *engine);
+    if (!parser.hasValidRuleState())
     {
         std::cerr << "No valid states for the given rules." << std::endl;
         return 1;
     }
 
+    if (pipe_mode || !serve_path.empty())
+    {
+        // repeated fact sets are answered once
+        std::unique_ptr<ResultCache> cache;
+        if (cache_mb)
+            cache.reset(new ResultCache(cache_mb << 20));
+        int status;
+        if (pipe_mode)
+            status = runPipe(parser, cache.get());
+        else
+        {
+            unsigned int workers = worker_count ? worker_count : std::thread::hardware_concurrency();
+            Server server(parser, serve_path, workers, cache.get(), request_limits);
+            status = server.run();
+        }
+        if (stats_enabled && cache)
+            cache->writeJson(std::cerr);
+        return status;
+    }
     Resolver resolver(parser.getQuerie(), parser.getBasicRules(), parser.getInitialFact(), parser.getCombinedTruthTable());
+    if (!setupTraceOutput(parser, resolver))
+        return 1;
+    if (stats_enabled)
+        resolver.setStats(&stats);
+    resolver.setProveThreads(prove_threads ? prove_threads : std::thread::hardware_concurrency());
+    if (budgeted)
+        resolver.setRequestBudget(&request_budget);
+    if (profile_enabled)
+    {
+        profiler.reset(parser.getBasicRules().size());
+        profiler.recordJoins(stats);
+        resolver.setProfiler(&profiler);
+    }
     if (parser.hasValidStateWithInitialFacts())
     {
         resolver.getReasoning().setEnabled(print_trace);
         if (print_trace)
             resolver.getReasoning().printInitialFacts(parser.getInitialFact(), std::cout);
         resolver.resolve();
+        if (resolver.isPartial())
+            warnPartial(request_budget);
+        if (stats_enabled)
+        {
+            std::cout << std::flush;
+            stats.writeJson(std::cerr);
+        }
     }
     else
     {
@@ -35,30 +131,34 @@ int App::run(int argc, char **argv)
         std::cerr << std::endl;
     }
 
+    // a partial answer is still printed, its status tells it apart
+    int status = resolver.isPartial() ? 2 : 0;
     if (interactive_mode)
-        return runInteractive(parser, resolver);
-
-    return 0;
+    {
+        // the rules of a partial parse may be missing, only facts are answered
+        if (budgeted && !parser.isPartial())
+            request_budget.start();
+        status = parser.ensureFullTable() ? runInteractive(parser, resolver, budgeted ? &request_budget : nullptr) : 1;
+    }
+    if (profile_enabled)
+    {
+        std::cout << std::flush;
+        profiler.printTop(std::cerr, profile_top, parser.getBasicRules(), parser.getFacts(), parser.getBasicRuleSources());
+    }
+    return status;
 }
 
-bool App::parseInteractiveFacts(const std::string &line, std::set<char> &facts)
+bool App::parseInteractiveFacts(const std::string &line, std::set<symbol_t> &facts)
 {
     facts.clear();
-    for (size_t i = 0; i < line.size(); ++i)
+    std::vector<symbol_t> symbols;
+    std::string error;
+    if (!SymbolTable::parseList(line, symbols, error))
     {
-        char c = line[i];
-        if (c == ' ' || c == '\t')
-            continue;
-        if (c >= 'A' && c <= 'Z')
-        {
-            facts.insert(c);
-        }
-        else
-        {
-            std::cerr << "Invalid character in facts: " << c << std::endl;
-            return false;
-        }
+        std::cerr << "Invalid character in facts: " << error << std::endl;
+        return false;
     }
+    facts.insert(symbols.begin(), symbols.end());
     return true;
 }
 
@@ -66,7 +166,14 @@ bool App::isUsageCorrect(int argc, char **argv)
 {
     if (argc < 2)
     {
-        std::cerr << "Usage: " << argv[0] << " <input_file> [--explain] [--interactive]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <input_file> [--explain] [--interactive] [--stats]"
+                  << " [--profile [--profile-top <n>]] [--expansion-report] [--push-facts]"
+                  << " [--max-basics <n>] [--max-table-states <n>] [--max-combined-states <n>]"
+                  << " [--on-budget fail|fallback] [--engine <name>]"
+                  << " [--trace-out <file> [--trace-format jsonl|bin]]"
+                  << " [--serve <socket> [--workers <n>]] [--pipe] [--cache-mb <n>] [--timeline <file>]"
+                  << " [--prove-threads <n>] [--timeout-ms <n>] [--max-memory-mb <n>]\n"
+                  << "       " << argv[0] << " --list-engines" << std::endl;
         return false;
     }
     return true;
@@ -82,20 +189,141 @@ bool App::parseArgs(int argc, char **argv)
             print_trace = true;
         else if (arg == "--interactive")
             interactive_mode = true;
+        else if (arg == "--pipe")
+            pipe_mode = true;
+        else if (arg == "--stats")
+            stats_enabled = true;
+        else if (arg == "--profile")
+            profile_enabled = true;
+        else if (arg == "--expansion-report")
+            expansion_report = true;
+        else if (arg == "--push-facts")
+            push_facts = true;
+        else if (arg == "--engine")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for option: " << arg << std::endl;
+                return false;
+            }
+            engine_name = argv[++i];
+            if (!Engine::create(engine_name))
+            {
+                std::cerr << "Unknown engine: " << engine_name << " (see --list-engines)" << std::endl;
+                return false;
+            }
+        }
+        else if (arg == "--trace-out" || arg == "--trace-format" || arg == "--serve" || arg == "--workers"
+                 || arg == "--cache-mb" || arg == "--timeline" || arg == "--profile-top" || arg == "--max-basics"
+                 || arg == "--max-table-states" || arg == "--max-combined-states" || arg == "--on-budget"
+                 || arg == "--prove-threads" || arg == "--timeout-ms" || arg == "--max-memory-mb")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing value for option: " << arg << std::endl;
+                return false;
+            }
+            std::string value = argv[++i];
+            if (arg == "--trace-out")
+                trace_out_path = value;
+            else if (arg == "--serve")
+                serve_path = value;
+            else if (arg == "--timeline")
+                timeline_path = value;
+            else if (arg == "--on-budget")
+            {
+                if (!ExpansionBudget::parseAction(value, budget.action))
+                {
+                    std::cerr << "Unknown budget action: " << value << std::endl;
+                    return false;
+                }
+            }
+            else if (arg != "--trace-format")
+            {
+                size_t count = 0;
+                if (!parseCount(arg, value, count))
+                    return false;
+                if (arg == "--workers")
+                    worker_count = static_cast<unsigned int>(count);
+                else if (arg == "--prove-threads")
+                    prove_threads = static_cast<unsigned int>(count);
+                else if (arg == "--cache-mb")
+                    cache_mb = count;
+                else if (arg == "--timeout-ms")
+                    request_limits.timeout_ms = count;
+                else if (arg == "--max-memory-mb")
+                    request_limits.max_memory_bytes = count << 20;
+                else if (arg == "--profile-top")
+                {
+                    profile_enabled = true;
+                    profile_top = static_cast<unsigned int>(count);
+                }
+                else if (arg == "--max-basics")
+                    budget.max_basics_per_rule = count;
+                else if (arg == "--max-table-states")
+                    budget.max_table_states = count;
+                else
+                    budget.max_combined_states = count;
+            }
+            else if (!TraceWriter::parseFormat(value, trace_format))
+            {
+                std::cerr << "Unknown trace format: " << value << std::endl;
+                return false;
+            }
+        }
         else
         {
             std::cerr << "Unknown option: " << arg << std::endl;
             return false;
         }
     }
+    if (engine_name != "table" && (print_trace || !trace_out_path.empty() || profile_enabled || stats_enabled
+                                   || request_limits.isLimited()))
+    {
+        std::cerr << "--explain, --trace-out, --profile, --stats, --timeout-ms and --max-memory-mb need the table engine"
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool App::parseCount(const std::string &arg, const std::string &value, size_t &count)
+{
+    if (value.empty() || value.size() > 9 || value.find_first_not_of("0123456789") != std::string::npos)
+    {
+        std::cerr << "Invalid count for " << arg << ": " << value << std::endl;
+        return false;
+    }
+    count = std::stoul(value);
     return true;
 }
 
-int App::runInteractive(Parser &parser, Resolver &resolver)
+bool App::setupTraceOutput(Parser &parser, Resolver &resolver)
+{
+    if (trace_out_path.empty())
+        return true;
+    if (!trace_writer.open(trace_out_path, trace_format))
+    {
+        std::cerr << "Error: cannot open trace file " << trace_out_path << std::endl;
+        return false;
+    }
+    trace_writer.writeRuleTable(parser.getBasicRules());
+    resolver.getReasoning().setSink(&trace_writer);
+    return true;
+}
+
+void App::warnPartial(const RequestBudget &budget)
+{
+    std::cout << std::flush;
+    std::cerr << "Warning: request budget exceeded (" << budget.reasonName()
+              << "); unresolved symbols are reported as ambiguous" << std::endl;
+}
+
+int App::runInteractive(Parser &parser, Resolver &resolver, RequestBudget *budget)
 {
     std::cout << "Interactive mode: enter new initial facts (e.g. AB). Empty line to exit. Space for all false." << std::endl;
     std::string line;
-    std::set<char> new_facts;
+    std::set<symbol_t> new_facts;
     while (true)
     {
         std::cout << "Initial facts = " << std::flush;
@@ -112,7 +340,94 @@ int App::runInteractive(Parser &parser, Resolver &resolver)
         }
         resolver.changeFacts(parser.getInitialFact());
         resolver.getReasoning().setEnabled(print_trace);
+        if (budget && !parser.isPartial())
+            budget->start();
         resolver.resolve();
+        if (resolver.isPartial())
+            warnPartial(*budget);
+        trace_writer.flush();
+        if (stats_enabled)
+        {
+            std::cout << std::flush;
+            stats.writeJson(std::cerr);
+        }
+    }
+    return 0;
+}
+
+int App::runEngine(Parser &parser, Engine &engine)
+{
+    std::set<symbol_t> facts = parser.getInitialFact();
+    std::string line;
+    try
+    {
+        // no initial fact constrains nothing: this checks the rules alone
+        std::map<symbol_t, rhr_value_e> results;
+        if (!engine.solve(parser, std::set<symbol_t>(), std::set<symbol_t>(), results))
+        {
+            std::cerr << "No valid states for the given rules." << std::endl;
+            return 1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    if (interactive_mode)
+        std::cout << "Interactive mode: enter new initial facts (e.g. AB). Empty line to exit. Space for all false." << std::endl;
+    while (true)
+    {
+        std::map<symbol_t, rhr_value_e> results;
+        try
+        {
+            if (!engine.solve(parser, facts, parser.getQuerie(), results))
+                std::cerr << "No valid states with the given initial facts." << std::endl;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        for (const auto &entry : results)
+        {
+            rhr_value_e res = entry.second;
+            std::cout << SymbolTable::name(entry.first) << " = " << (res == R_TRUE ? "true" : res == R_FALSE ? "false" : "ambiguous") << '\n';
+        }
+        if (!interactive_mode)
+            return 0;
+        do
+        {
+            std::cout << "Initial facts = " << std::flush;
+            if (!std::getline(std::cin, line) || line.empty())
+                return 0;
+        } while (!parseInteractiveFacts(line, facts));
+    }
+}
+
+int App::runPipe(Parser &parser, ResultCache *cache)
+{
+    static const size_t FLUSH_SIZE = 1 << 16;
+
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+    std::string line;
+    std::string out;
+    out.reserve(FLUSH_SIZE * 2);
+    unsigned long record = 0;
+    while (std::getline(std::cin, line))
+    {
+        ++record;
+        if (line.empty() || line[0] == '#')
+            continue;
+        QueryProtocol::formatReply(QueryProtocol::answerLine(parser, line, std::to_string(record), cache, request_limits), out);
+        if (out.size() >= FLUSH_SIZE)
+        {
+            std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
     }
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+    std::cout.flush();
     return 0;
 }
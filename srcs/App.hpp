@@ -1,9 +1,16 @@
 #pragma once
 #include <set>
 #include <string>
+#include "EngineStats.hpp"
+#include "ExpansionReport.hpp"
+#include "RequestBudget.hpp"
+#include "RuleProfiler.hpp"
+#include "TraceWriter.hpp"
 
+class Engine;
 class Parser;
 class Resolver;
+class ResultCache;
 
 class App
 {
@@ -23,17 +30,77 @@ private:
      */
     bool parseArgs(int argc, char **argv);
     /**
-     * Permit to set new inital facts using the stdinput
+     * Read the non-negative integer value of a count option
      */
-    int runInteractive(Parser &parser, Resolver &resolver);
+    static bool parseCount(const std::string &arg, const std::string &value, size_t &count);
+    /**
+     * Parse the input file and run the selected mode
+     */
+    int execute();
+    /**
+     * Open the --trace-out file and attach it to the resolver
+     */
+    bool setupTraceOutput(Parser &parser, Resolver &resolver);
+    /**
+     * Permit to set new inital facts using the stdinput, each resolution
+     * with a fresh budget when one is given
+     */
+    int runInteractive(Parser &parser, Resolver &resolver, RequestBudget *budget);
+    /**
+     * Report a resolution cut short by its request budget
+     */
+    static void warnPartial(const RequestBudget &budget);
+    /**
+     * Answer the queries with the --engine engine, interactively if asked
+     */
+    int runEngine(Parser &parser, Engine &engine);
+    /**
+     * Answer protocol records from stdin without prompts, with fully buffered output
+     */
+    int runPipe(Parser &parser, ResultCache *cache);
     /**
      * Parse an interactive facts line into a set of symbols. 
      */ 
-    static bool parseInteractiveFacts(const std::string &line, std::set<char> &facts);
+    static bool parseInteractiveFacts(const std::string &line, std::set<symbol_t> &facts);
     // file path to manage (file containing the facts and logics links)
     std::string input_path;
     // debug mode activation
     bool print_trace = false;
     // interactive mode activation
     bool interactive_mode = false;
+    // streamed trace output file (--trace-out), empty when disabled
+    std::string trace_out_path;
+    // streamed trace encoding (--trace-format)
+    TraceWriter::Format trace_format = TraceWriter::JSONL;
+    // streamed trace output
+    TraceWriter trace_writer;
+    // batch protocol on stdin/stdout
+    bool pipe_mode = false;
+    // daemon socket path (--serve), empty when disabled
+    std::string serve_path;
+    // daemon worker threads (--workers), 0 for one per core
+    unsigned int worker_count = 0;
+    // parallel prover threads of a single query (--prove-threads), 0 for one per core
+    unsigned int prove_threads = 1;
+    // answer cache of the daemon and pipe modes in MiB (--cache-mb), 0 to disable
+    size_t cache_mb = 64;
+    // print phase timings and counters after each run (--stats)
+    bool stats_enabled = false;
+    EngineStats stats;
+    // per-rule cost table printed at exit (--profile, --profile-top)
+    bool profile_enabled = false;
+    unsigned int profile_top = 10;
+    RuleProfiler profiler;
+    // rule expansion limits (--max-basics, --max-table-states, --max-combined-states, --on-budget)
+    ExpansionBudget budget;
+    // time and memory of a run or of each protocol request (--timeout-ms, --max-memory-mb)
+    RequestBudget::Limits request_limits;
+    // print what each source rule expanded into (--expansion-report)
+    bool expansion_report = false;
+    // specialize the truth tables to the initial facts (--push-facts)
+    bool push_facts = false;
+    // engine answering the queries (--engine), see Engine::names
+    std::string engine_name = "table";
+    // Chrome trace-event output file (--timeline), empty when disabled
+    std::string timeline_path;
 };
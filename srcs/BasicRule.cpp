@@ -7,7 +7,7 @@ BasicRule::BasicRule() : lhs(), rhs_symbol(0), rhs_negated(false), origin(nullpt
 {
 }
 
-BasicRule::BasicRule(std::vector<TokenBlock> lhs_blocks, char symbol, bool negated, const LogicRule* orig)
+BasicRule::BasicRule(std::vector<TokenBlock> lhs_blocks, symbol_t symbol, bool negated, const LogicRule* orig)
     : lhs(std::move(lhs_blocks)), rhs_symbol(symbol), rhs_negated(negated), origin(orig)
 {
 }
@@ -27,10 +27,10 @@ std::string BasicRule::structureToString() const
             const TokenEffect &tk = block[j];
             if (tk.type == 0)
                 oss << "(null)";
-            else if (tk.type >= 'A' && tk.type <= 'Z')
-                oss << "'" << tk.type << "'";
+            else if (SymbolTable::isSymbol(tk.type))
+                oss << "'" << SymbolTable::name(tk.type) << "'";
             else
-                oss << "op(" << tk.type << ")";
+                oss << "op(" << static_cast<char>(tk.type) << ")";
             
             if (j + 1 < block.size())
                 oss << " ";
@@ -41,7 +41,7 @@ std::string BasicRule::structureToString() const
     oss << "  RHS: ";
     if (rhs_negated)
         oss << "!";
-    oss << rhs_symbol << "\n";
+    oss << SymbolTable::name(rhs_symbol) << "\n";
     
     return oss.str();
 }
@@ -52,7 +52,7 @@ std::string BasicRule::toString() const
     oss << renderSide(lhs) << " => ";
     if (rhs_negated)
         oss << '!';
-    oss << rhs_symbol;
+    oss << SymbolTable::name(rhs_symbol);
     return oss.str();
 }
 
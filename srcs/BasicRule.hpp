@@ -23,7 +23,7 @@ public:
      * @param negated whether the RHS symbol is negated.
      * @param orig original logic rule that produced this basic rule.
      **/
-    BasicRule(std::vector<TokenBlock> lhs_blocks, char symbol, bool negated, const LogicRule* orig);
+    BasicRule(std::vector<TokenBlock> lhs_blocks, symbol_t symbol, bool negated, const LogicRule* orig);
     /**
      * convert rule to a compact string representation.
      **/
@@ -40,7 +40,7 @@ public:
     /**
      * right-hand side symbol.
      **/
-    char rhs_symbol;
+    symbol_t rhs_symbol;
     /**
      * whether the RHS symbol is negated.
      **/
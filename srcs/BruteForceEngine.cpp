@@ -0,0 +1,91 @@
+#include "BruteForceEngine.hpp"
+#include "Parser.hpp"
+#include "Resolver.hpp"
+#include <stdexcept>
+
+bool BruteForceEngine::solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+                             std::map<symbol_t, rhr_value_e> &results)
+{
+    std::set<symbol_t> symbols = parser.getRuleSymbols();
+    if (symbols.size() > MAX_VARIABLES)
+        throw std::runtime_error("bruteforce engine is limited to " + std::to_string(MAX_VARIABLES) + " symbols");
+    std::vector<symbol_t> vars(symbols.begin(), symbols.end());
+    const std::vector<BasicRule> &rules = parser.getBasicRules();
+    // the reference joins no table at all without rules, leaving no valid state
+    if (rules.empty())
+        return false;
+
+    // every model of the rules, as a bitmask over vars
+    std::vector<uint32_t> models;
+    std::map<symbol_t, bool> state;
+    for (uint32_t mask = 0; mask < (1u << vars.size()); ++mask)
+    {
+        for (size_t i = 0; i < vars.size(); ++i)
+            state[vars[i]] = (mask >> i) & 1;
+        bool satisfied = true;
+        for (size_t r = 0; r < rules.size() && satisfied; ++r)
+            satisfied = TruthTable::satisfies(rules[r], state);
+        if (satisfied)
+            models.push_back(mask);
+    }
+
+    uint32_t fact_mask = 0;
+    for (size_t i = 0; i < vars.size(); ++i)
+    {
+        if (facts.count(vars[i]))
+            fact_mask |= 1u << i;
+    }
+    bool consistent = false;
+    for (uint32_t model : models)
+        consistent = consistent || (model & fact_mask) == fact_mask;
+    if (!consistent)
+        return false;
+
+    // rule-based values, without truth table constraints
+    TruthTable unconstrained = TruthTable::unconstrained(symbols);
+    Resolver resolver(queries, parser.getBasicRules(), facts, unconstrained);
+    std::map<symbol_t, rhr_value_e> values = resolver.evaluate();
+
+    uint32_t known_mask = fact_mask;
+    uint32_t known_true = fact_mask;
+    for (size_t i = 0; i < vars.size(); ++i)
+    {
+        if (fact_mask & (1u << i))
+            continue;
+        rhr_value_e value = values[vars[i]];
+        if (value != R_AMBIGOUS)
+            known_mask |= 1u << i;
+        if (value == R_TRUE)
+            known_true |= 1u << i;
+    }
+
+    // clamp with the models agreeing with every known value
+    uint32_t seen_true = 0;
+    uint32_t seen_false = 0;
+    bool has_model = false;
+    for (uint32_t model : models)
+    {
+        if ((model & known_mask) != known_true)
+            continue;
+        has_model = true;
+        seen_true |= model;
+        seen_false |= ~model;
+    }
+    if (has_model)
+    {
+        for (size_t i = 0; i < vars.size(); ++i)
+        {
+            bool can_be_true = seen_true & (1u << i);
+            bool can_be_false = seen_false & (1u << i);
+            if (can_be_true && !can_be_false)
+                values[vars[i]] = R_TRUE;
+            else if (can_be_false && !can_be_true)
+                values[vars[i]] = R_FALSE;
+        }
+    }
+
+    results.clear();
+    for (symbol_t q : queries)
+        results[q] = resolver.queryResult(values, q);
+    return true;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Engine.hpp"
+
+/**
+ * Differential oracle: enumerates every assignment of the rule symbols
+ * instead of joining truth tables, then clamps the rule-based results the
+ * way Resolver::evaluate does. Exponential, for testing only.
+ **/
+class BruteForceEngine : public Engine
+{
+public:
+    /** largest number of rule symbols accepted */
+    static const size_t MAX_VARIABLES = 20;
+
+    const char *name() const override { return "bruteforce"; }
+    bool solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+               std::map<symbol_t, rhr_value_e> &results) override;
+};
@@ -0,0 +1,288 @@
+#include "EliminationEngine.hpp"
+#include "Parser.hpp"
+#include "Resolver.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+    /** relation over scope: allowed[i] for the assignment giving bit j of i to scope[j] */
+    struct Factor
+    {
+        std::vector<symbol_t> scope;
+        std::vector<uint8_t> allowed;
+    };
+
+    void checkWidth(size_t symbols)
+    {
+        if (symbols > EliminationEngine::MAX_BUCKET_SYMBOLS)
+            throw std::runtime_error("elimination engine: a bucket spans more than "
+                                     + std::to_string(EliminationEngine::MAX_BUCKET_SYMBOLS) + " symbols");
+    }
+
+    Factor fromTable(const TruthTable &table)
+    {
+        Factor factor;
+        factor.scope.assign(table.variables.begin(), table.variables.end());
+        checkWidth(factor.scope.size());
+        factor.allowed.assign(static_cast<size_t>(1) << factor.scope.size(), 0);
+        for (const VariableState &state : table.valid_states)
+        {
+            size_t index = 0;
+            for (size_t j = 0; j < factor.scope.size(); ++j)
+            {
+                auto it = state.values.find(factor.scope[j]);
+                if (it != state.values.end() && it->second)
+                    index |= static_cast<size_t>(1) << j;
+            }
+            factor.allowed[index] = 1;
+        }
+        return factor;
+    }
+
+    /**
+     * Join factors, fixing the known symbols and existentially eliminating
+     * `eliminated` (0 for none); the result spans the remaining symbols.
+     **/
+    Factor reduce(const std::vector<const Factor *> &factors, const std::map<symbol_t, bool> &known, symbol_t eliminated)
+    {
+        Factor result;
+        for (const Factor *factor : factors)
+        {
+            for (symbol_t var : factor->scope)
+            {
+                if (var != eliminated && !known.count(var))
+                    result.scope.push_back(var);
+            }
+        }
+        std::sort(result.scope.begin(), result.scope.end());
+        result.scope.erase(std::unique(result.scope.begin(), result.scope.end()), result.scope.end());
+        checkWidth(result.scope.size() + (eliminated ? 1 : 0));
+
+        // where each factor symbol comes from: a bit of the joined assignment, or a constant
+        const int CONSTANT_FALSE = -1;
+        const int CONSTANT_TRUE = -2;
+        size_t width = result.scope.size();
+        std::vector<std::vector<int>> sources(factors.size());
+        for (size_t f = 0; f < factors.size(); ++f)
+        {
+            for (symbol_t var : factors[f]->scope)
+            {
+                auto fixed = known.find(var);
+                if (var == eliminated)
+                    sources[f].push_back(width);
+                else if (fixed != known.end())
+                    sources[f].push_back(fixed->second ? CONSTANT_TRUE : CONSTANT_FALSE);
+                else
+                    sources[f].push_back(std::lower_bound(result.scope.begin(), result.scope.end(), var) - result.scope.begin());
+            }
+        }
+
+        result.allowed.assign(static_cast<size_t>(1) << width, 0);
+        size_t choices = eliminated ? 2 : 1;
+        for (size_t assignment = 0; assignment < result.allowed.size(); ++assignment)
+        {
+            for (size_t choice = 0; choice < choices && !result.allowed[assignment]; ++choice)
+            {
+                size_t joined = assignment | (choice << width);
+                bool allowed = true;
+                for (size_t f = 0; f < factors.size() && allowed; ++f)
+                {
+                    size_t index = 0;
+                    for (size_t j = 0; j < sources[f].size(); ++j)
+                    {
+                        int source = sources[f][j];
+                        bool value = source == CONSTANT_TRUE || (source >= 0 && ((joined >> source) & 1));
+                        if (value)
+                            index |= static_cast<size_t>(1) << j;
+                    }
+                    allowed = factors[f]->allowed[index];
+                }
+                result.allowed[assignment] = allowed;
+            }
+        }
+        return result;
+    }
+
+    /** greedy min-fill order over the symbols sharing a factor, ties by degree then symbol */
+    std::vector<symbol_t> minFillOrder(const std::vector<Factor> &factors)
+    {
+        std::map<symbol_t, std::set<symbol_t>> graph;
+        for (const Factor &factor : factors)
+        {
+            for (symbol_t a : factor.scope)
+            {
+                graph[a];
+                for (symbol_t b : factor.scope)
+                {
+                    if (a != b)
+                        graph[a].insert(b);
+                }
+            }
+        }
+
+        std::vector<symbol_t> order;
+        while (!graph.empty())
+        {
+            symbol_t best = 0;
+            size_t best_fill = 0;
+            size_t best_degree = 0;
+            for (const auto &node : graph)
+            {
+                size_t fill = 0;
+                for (auto a = node.second.begin(); a != node.second.end(); ++a)
+                {
+                    for (auto b = std::next(a); b != node.second.end(); ++b)
+                        fill += !graph.at(*a).count(*b);
+                }
+                if (!best || fill < best_fill || (fill == best_fill && node.second.size() < best_degree))
+                {
+                    best = node.first;
+                    best_fill = fill;
+                    best_degree = node.second.size();
+                }
+            }
+            std::set<symbol_t> neighbours = graph[best];
+            for (symbol_t a : neighbours)
+            {
+                graph[a].erase(best);
+                for (symbol_t b : neighbours)
+                {
+                    if (a != b)
+                        graph[a].insert(b);
+                }
+            }
+            graph.erase(best);
+            order.push_back(best);
+        }
+        return order;
+    }
+
+    /**
+     * Eliminate every symbol of order but `kept` (0 for none), bucket by bucket.
+     * Return the factors left, all spanning at most `kept`, or none when a
+     * factor allows no assignment.
+     **/
+    std::vector<Factor> eliminateAll(std::vector<Factor> factors, const std::vector<symbol_t> &order, symbol_t kept)
+    {
+        static const std::map<symbol_t, bool> no_known;
+        for (symbol_t var : order)
+        {
+            if (var == kept)
+                continue;
+            std::vector<Factor> rest;
+            std::vector<Factor> bucket;
+            for (Factor &factor : factors)
+            {
+                bool mentions = std::find(factor.scope.begin(), factor.scope.end(), var) != factor.scope.end();
+                (mentions ? bucket : rest).push_back(std::move(factor));
+            }
+            factors.swap(rest);
+            if (bucket.empty())
+                continue;
+            std::vector<const Factor *> members;
+            for (const Factor &factor : bucket)
+                members.push_back(&factor);
+            factors.push_back(reduce(members, no_known, var));
+            if (std::find(factors.back().allowed.begin(), factors.back().allowed.end(), 1) == factors.back().allowed.end())
+                return std::vector<Factor>();
+        }
+        return factors;
+    }
+
+    /** check if some assignment satisfies every factor */
+    bool satisfiable(const std::vector<Factor> &factors, const std::vector<symbol_t> &order)
+    {
+        if (factors.empty())
+            return true;
+        std::vector<Factor> left = eliminateAll(factors, order, 0);
+        if (left.empty())
+            return false;
+        for (const Factor &factor : left)
+        {
+            if (!factor.allowed[0])
+                return false;
+        }
+        return true;
+    }
+
+    /** restrict every factor to the known values */
+    std::vector<Factor> withEvidence(const std::vector<Factor> &factors, const std::map<symbol_t, bool> &known)
+    {
+        std::vector<Factor> restricted;
+        for (const Factor &factor : factors)
+            restricted.push_back(reduce(std::vector<const Factor *>(1, &factor), known, 0));
+        return restricted;
+    }
+}
+
+bool EliminationEngine::solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+                              std::map<symbol_t, rhr_value_e> &results)
+{
+    // the reference joins no table at all without rules, leaving no valid state
+    if (parser.getBasicRules().empty())
+        return false;
+    std::set<symbol_t> symbols = parser.getRuleSymbols();
+    std::vector<Factor> factors;
+    // past an expansion budget the reference resolves without table constraints
+    if (!parser.getExpansionReport().fallback)
+    {
+        const std::vector<TruthTable> &tables = parser.getRuleTables();
+        if (tables.size() != parser.getBasicRules().size())
+            throw std::runtime_error("elimination engine needs the rule tables (Parser::setJoinTables(false))");
+        for (const TruthTable &table : tables)
+            factors.push_back(fromTable(table));
+    }
+
+    std::map<symbol_t, bool> fact_values;
+    for (symbol_t fact : facts)
+        fact_values[fact] = true;
+    std::vector<Factor> with_facts = withEvidence(factors, fact_values);
+    if (!satisfiable(with_facts, minFillOrder(with_facts)))
+        return false;
+
+    // rule-based values, without truth table constraints
+    TruthTable unconstrained = TruthTable::unconstrained(symbols);
+    Resolver resolver(queries, parser.getBasicRules(), facts, unconstrained);
+    std::map<symbol_t, rhr_value_e> values = resolver.evaluate();
+
+    // clamp with the states agreeing with every known value, as Resolver::evaluate
+    std::map<symbol_t, bool> known = fact_values;
+    for (const auto &entry : values)
+    {
+        if (entry.second != R_AMBIGOUS)
+            known[entry.first] = entry.second == R_TRUE;
+    }
+    std::vector<Factor> constrained = withEvidence(factors, known);
+    std::vector<symbol_t> order = minFillOrder(constrained);
+    if (satisfiable(constrained, order))
+    {
+        for (symbol_t q : queries)
+        {
+            if (!symbols.count(q))
+                continue;
+            auto fixed = known.find(q);
+            if (fixed != known.end())
+            {
+                values[q] = fixed->second ? R_TRUE : R_FALSE;
+                continue;
+            }
+            bool can_be_true = true;
+            bool can_be_false = true;
+            for (const Factor &factor : eliminateAll(constrained, order, q))
+            {
+                can_be_true = can_be_true && factor.allowed[factor.scope.empty() ? 0 : 1];
+                can_be_false = can_be_false && factor.allowed[0];
+            }
+            if (can_be_true && !can_be_false)
+                values[q] = R_TRUE;
+            else if (can_be_false && !can_be_true)
+                values[q] = R_FALSE;
+        }
+    }
+
+    results.clear();
+    for (symbol_t q : queries)
+        results[q] = resolver.queryResult(values, q);
+    return true;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Engine.hpp"
+
+/**
+ * Bucket elimination over the per-rule truth tables: each query value is
+ * clamped from the values it can take once every other symbol has been
+ * existentially eliminated, in min-fill order of the rule interaction
+ * graph. No table larger than the widest bucket is ever built, so memory
+ * follows the treewidth of the rules rather than their symbol count.
+ **/
+class EliminationEngine : public Engine
+{
+public:
+    /** largest number of symbols one bucket may span */
+    static const size_t MAX_BUCKET_SYMBOLS = 24;
+
+    const char *name() const override { return "elimination"; }
+    bool solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+               std::map<symbol_t, rhr_value_e> &results) override;
+    bool needsCombinedTable() const override { return false; }
+};
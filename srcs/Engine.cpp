@@ -0,0 +1,44 @@
+#include "Engine.hpp"
+#include "BruteForceEngine.hpp"
+#include "EliminationEngine.hpp"
+#include "HornEngine.hpp"
+#include "PropagationEngine.hpp"
+#include "ReteEngine.hpp"
+#include "Parser.hpp"
+#include "Resolver.hpp"
+
+const std::vector<std::string> &Engine::names()
+{
+    static const std::vector<std::string> engine_names = {"table", "bruteforce", "elimination", "propagation", "horn", "rete"};
+    return engine_names;
+}
+
+std::unique_ptr<Engine> Engine::create(const std::string &name)
+{
+    if (name == "table")
+        return std::unique_ptr<Engine>(new TableEngine());
+    if (name == "bruteforce")
+        return std::unique_ptr<Engine>(new BruteForceEngine());
+    if (name == "elimination")
+        return std::unique_ptr<Engine>(new EliminationEngine());
+    if (name == "propagation")
+        return std::unique_ptr<Engine>(new PropagationEngine());
+    if (name == "horn")
+        return std::unique_ptr<Engine>(new HornEngine());
+    if (name == "rete")
+        return std::unique_ptr<Engine>(new ReteEngine());
+    return nullptr;
+}
+
+bool TableEngine::solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+                        std::map<symbol_t, rhr_value_e> &results)
+{
+    if (!parser.hasValidStateWithFacts(facts))
+        return false;
+    Resolver resolver(queries, parser.getBasicRules(), facts, parser.getCombinedTruthTable());
+    std::map<symbol_t, rhr_value_e> values = resolver.evaluate();
+    results.clear();
+    for (symbol_t q : queries)
+        results[q] = resolver.queryResult(values, q);
+    return true;
+}
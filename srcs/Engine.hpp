@@ -0,0 +1,54 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "ReasoningTypes.hpp"
+
+class Parser;
+
+/**
+ * A way to compute query values from a parsed knowledge base (--engine).
+ * Every engine must give the answers of the reference "table" engine,
+ * the Resolver clamped by the combined truth table.
+ **/
+class Engine
+{
+public:
+    virtual ~Engine() {}
+    virtual const char *name() const = 0;
+    /**
+     * Compute the value of every query symbol when exactly `facts` are
+     * initially true. Return false when no state satisfies the rules and facts.
+     * Throw std::runtime_error when the knowledge base is out of the engine reach.
+     **/
+    virtual bool solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+                       std::map<symbol_t, rhr_value_e> &results) = 0;
+    /**
+     * Whether solve reads Parser::getCombinedTruthTable; engines returning
+     * false get the per-rule tables instead (Parser::setJoinTables).
+     **/
+    virtual bool needsCombinedTable() const { return true; }
+
+    /**
+     * names of the available engines, the reference first.
+     **/
+    static const std::vector<std::string> &names();
+    /**
+     * create an engine by name, nullptr when unknown.
+     **/
+    static std::unique_ptr<Engine> create(const std::string &name);
+};
+
+/**
+ * Reference engine: Resolver::evaluate on the combined truth table.
+ **/
+class TableEngine : public Engine
+{
+public:
+    const char *name() const override { return "table"; }
+    bool solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+               std::map<symbol_t, rhr_value_e> &results) override;
+};
@@ -0,0 +1,78 @@
+#include "EngineStats.hpp"
+#include <algorithm>
+
+double EngineStats::elapsedUs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+void EngineStats::resetRun()
+{
+    base_results_us = 0;
+    clamp_us = 0;
+    prove_calls = 0;
+    memo_hits = 0;
+    visiting_hits = 0;
+    initial_fact_hits = 0;
+    rules_evaluated = 0;
+    clamped_values = 0;
+    parallel_settled = 0;
+    steals = 0;
+    ++runs;
+}
+
+void EngineStats::recordJoin(size_t left_states, size_t right_states, size_t out_states, double us)
+{
+    joins.push_back({left_states, right_states, out_states, us});
+    peak_states = std::max(peak_states, std::max(left_states, out_states));
+}
+
+void EngineStats::setMemory(MemoryCategory category, size_t bytes)
+{
+    memory_current[category] = bytes;
+    memory_peak[category] = std::max(memory_peak[category], bytes);
+    size_t total = 0;
+    for (size_t current : memory_current)
+        total += current;
+    memory_total_peak = std::max(memory_total_peak, total);
+}
+
+void EngineStats::writeJson(std::ostream &os) const
+{
+    static const char *const memory_names[MEM_CATEGORY_COUNT] = {
+        "facts", "basic_rules", "rule_tables", "combined_table", "filtered_table", "memo", "traces"};
+
+    os << "{\"run\":" << runs
+       << ",\"time_us\":{\"parse\":" << parse_us
+       << ",\"expand_rules\":" << expand_us
+       << ",\"conjunction_all\":" << conjunction_us
+       << ",\"base_results\":" << base_results_us
+       << ",\"clamp\":" << clamp_us << "}"
+       << ",\"counters\":{\"prove_calls\":" << prove_calls
+       << ",\"memo_hits\":" << memo_hits
+       << ",\"visiting_hits\":" << visiting_hits
+       << ",\"initial_fact_hits\":" << initial_fact_hits
+       << ",\"rules_evaluated\":" << rules_evaluated
+       << ",\"clamped_values\":" << clamped_values;
+    if (parallel_settled)
+        os << ",\"parallel_settled\":" << parallel_settled << ",\"steals\":" << steals;
+    os << "},\"basics_per_rule\":[";
+    for (size_t i = 0; i < basics_per_rule.size(); ++i)
+        os << (i ? "," : "") << basics_per_rule[i];
+    os << "],\"joins\":[";
+    for (size_t i = 0; i < joins.size(); ++i)
+    {
+        const JoinStep &j = joins[i];
+        os << (i ? "," : "") << "{\"in\":[" << j.left_states << "," << j.right_states
+           << "],\"out\":" << j.out_states << ",\"us\":" << j.us << "}";
+    }
+    os << "],\"peak_states\":" << peak_states << ",\"memory_bytes\":{";
+    size_t total = 0;
+    for (size_t i = 0; i < MEM_CATEGORY_COUNT; ++i)
+    {
+        os << "\"" << memory_names[i] << "\":{\"current\":" << memory_current[i]
+           << ",\"peak\":" << memory_peak[i] << "},";
+        total += memory_current[i];
+    }
+    os << "\"total\":{\"current\":" << total << ",\"peak\":" << memory_total_peak << "}}}\n";
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/**
+ * Phase timings and engine counters of one run (--stats).
+ * The parser fills the build section once; the resolver clears and fills
+ * the run section on every evaluation. Components hold a pointer to it,
+ * left null when statistics are disabled.
+ **/
+class EngineStats
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * Structures whose memory is accounted, see MemoryAccounting.
+     **/
+    enum MemoryCategory
+    {
+        /** source rules, initial facts and queries */
+        MEM_FACTS,
+        MEM_BASIC_RULES,
+        /** per basic rule tables, freed once joined */
+        MEM_RULE_TABLES,
+        MEM_COMBINED_TABLE,
+        /** copy filtered by the base results in Resolver::evaluate */
+        MEM_FILTERED_TABLE,
+        /** memo and visiting maps of the resolver */
+        MEM_MEMO,
+        /** proof DAG of --explain and --trace-out */
+        MEM_TRACES,
+        MEM_CATEGORY_COUNT
+    };
+
+    /**
+     * One TruthTable::conjunction step of conjunctionAll.
+     **/
+    struct JoinStep
+    {
+        size_t left_states;
+        size_t right_states;
+        size_t out_states;
+        double us;
+    };
+
+    // build, filled by Parser::parse
+    double parse_us = 0;
+    double expand_us = 0;
+    double conjunction_us = 0;
+    /** number of BasicRules deduced from each LogicRule, in source order */
+    std::vector<size_t> basics_per_rule;
+    std::vector<JoinStep> joins;
+    /** largest state count seen while joining, the first table included */
+    size_t peak_states = 0;
+
+    // run, filled by Resolver::evaluate
+    double base_results_us = 0;
+    double clamp_us = 0;
+    uint64_t prove_calls = 0;
+    uint64_t memo_hits = 0;
+    uint64_t visiting_hits = 0;
+    uint64_t initial_fact_hits = 0;
+    uint64_t rules_evaluated = 0;
+    uint64_t clamped_values = 0;
+    /** symbols settled by the parallel prover, and tasks its workers stole */
+    uint64_t parallel_settled = 0;
+    uint64_t steals = 0;
+    uint64_t runs = 0;
+
+    // memory, current and peak bytes over the whole process
+    size_t memory_current[MEM_CATEGORY_COUNT] = {};
+    size_t memory_peak[MEM_CATEGORY_COUNT] = {};
+    size_t memory_total_peak = 0;
+
+    static double elapsedUs(Clock::time_point start);
+    /**
+     * clear the run section before a new evaluation.
+     **/
+    void resetRun();
+    void recordJoin(size_t left_states, size_t right_states, size_t out_states, double us);
+    /**
+     * set the bytes currently held by a category, updating the peaks.
+     **/
+    void setMemory(MemoryCategory category, size_t bytes);
+    /**
+     * write everything as a single line JSON object.
+     **/
+    void writeJson(std::ostream &os) const;
+};
@@ -0,0 +1,38 @@
+#include "ExpansionReport.hpp"
+#include <iomanip>
+
+bool ExpansionBudget::parseAction(const std::string &name, Action &action)
+{
+    if (name == "fail")
+        action = FAIL;
+    else if (name == "fallback")
+        action = FALLBACK;
+    else
+        return false;
+    return true;
+}
+
+void ExpansionReport::print(std::ostream &os, const std::vector<LogicRule> &source_rules) const
+{
+    os << "Expansion report\n";
+    os << std::setw(6) << "line" << std::setw(8) << "basics" << std::setw(12) << "lhs_tokens"
+       << std::setw(14) << "table_states" << "  rule\n";
+    for (size_t i = 0; i < rules.size() && i < source_rules.size(); ++i)
+    {
+        const Entry &entry = rules[i];
+        os << std::setw(6) << entry.line << std::setw(8) << entry.basics << std::setw(12) << entry.lhs_tokens
+           << std::setw(14) << entry.table_states << "  " << source_rules[i].toString() << "\n";
+    }
+    if (pushed_values)
+        os << "pushed into the tables: " << pushed_values << " values, " << propagated_values
+           << " of them forced by the facts\n";
+    if (fallback)
+        os << "combined table: dropped (" << budget_exceeded << ")\n";
+    else if (!budget_exceeded.empty())
+        os << "combined table: not built (" << budget_exceeded << ")\n";
+    else if (two_sat_clauses)
+        os << "combined table: not built, implication graph of " << two_sat_clauses << " binary clauses over "
+           << combined_variables << " variables\n";
+    else
+        os << "combined table: " << combined_states << " states over " << combined_variables << " variables\n";
+}
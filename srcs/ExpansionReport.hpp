@@ -0,0 +1,67 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "LogicRule.hpp"
+
+/**
+ * Limits on the expansion of rules into basic rules and truth tables.
+ * A limit of 0 means unlimited.
+ **/
+struct ExpansionBudget
+{
+    enum Action
+    {
+        /** stop parsing with a diagnostic */
+        FAIL,
+        /** resolve by rules only, without truth table constraints */
+        FALLBACK
+    };
+
+    /** basic rules deduced from one source rule, never falls back */
+    size_t max_basics_per_rule = 0;
+    /** states of the truth table of one basic rule */
+    size_t max_table_states = 0;
+    /** states of the combined truth table, checked after each join */
+    size_t max_combined_states = 0;
+    Action action = FAIL;
+
+    /**
+     * parse an --on-budget value, return false if unknown.
+     **/
+    static bool parseAction(const std::string &name, Action &action);
+};
+
+/**
+ * What each source rule expanded into during Parser::expandRules.
+ **/
+struct ExpansionReport
+{
+    struct Entry
+    {
+        unsigned int line = 0;
+        size_t basics = 0;
+        /** LHS tokens summed over the basic rules */
+        size_t lhs_tokens = 0;
+        /** states summed over the truth tables of the basic rules */
+        size_t table_states = 0;
+    };
+
+    /** one entry per source rule, in source order */
+    std::vector<Entry> rules;
+    size_t combined_states = 0;
+    size_t combined_variables = 0;
+    /** clauses of the implication graph standing for the combined table, 0 when joined */
+    size_t two_sat_clauses = 0;
+    /** symbols pushed into the rule tables (--push-facts), facts included */
+    size_t pushed_values = 0;
+    /** of those, the symbols forced by the facts through the rules */
+    size_t propagated_values = 0;
+    /** the exceeded budget, empty when every budget held */
+    std::string budget_exceeded;
+    /** true when the truth table constraints were dropped */
+    bool fallback = false;
+
+    void print(std::ostream &os, const std::vector<LogicRule> &source_rules) const;
+};
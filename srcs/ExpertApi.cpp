@@ -0,0 +1,332 @@
+#include "expert.h"
+#include "Engine.hpp"
+#include "Parser.hpp"
+#include "Resolver.hpp"
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+struct expert_kb
+{
+    Parser parser;
+    /** symbols of the rules, initial facts and queries, the names the API accepts */
+    std::set<symbol_t> symbols;
+
+    expert_kb() : parser("<memory>") {}
+};
+
+struct expert_ctx
+{
+    // resolvers only read the rules and truth table of the knowledge base
+    expert_kb *kb;
+    std::set<symbol_t> facts;
+    bool explain = false;
+    /** engine set by expert_ctx_set_engine, the resolver when NULL */
+    std::unique_ptr<Engine> engine;
+    /** budget of each expert_resolve, set by expert_ctx_set_budget */
+    RequestBudget::Limits limits;
+    /** resolver of the last expert_resolve, kept for expert_explain */
+    std::unique_ptr<Resolver> last;
+};
+
+static thread_local std::string g_last_error;
+
+static expert_status fail(expert_status status, const std::string &message)
+{
+    g_last_error = message;
+    return status;
+}
+
+/** code of one symbol name, only names the knowledge base uses */
+static expert_status findSymbol(const expert_kb *kb, const char *name, symbol_t &symbol)
+{
+    if (!name)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "name is NULL");
+    std::vector<symbol_t> symbols;
+    std::string bad;
+    if (!SymbolTable::parseList(name, symbols, bad, false) || symbols.size() != 1
+        || !kb->symbols.count(symbols[0]))
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, std::string("unknown symbol: ") + name);
+    symbol = symbols[0];
+    return EXPERT_OK;
+}
+
+/**
+ * Symbols of a C string, only names the knowledge base uses: the symbol
+ * table is process-wide, so a name interned by another knowledge base is
+ * still unknown to this one.
+ **/
+static expert_status parseSymbols(const expert_kb *kb, const char *text, std::vector<symbol_t> &symbols)
+{
+    std::string bad;
+    if (!SymbolTable::parseList(text, symbols, bad, false))
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "invalid symbol: " + bad);
+    for (symbol_t symbol : symbols)
+        if (!kb->symbols.count(symbol))
+            return fail(EXPERT_ERR_INVALID_ARGUMENT, "unknown symbol: " + SymbolTable::name(symbol));
+    return EXPERT_OK;
+}
+
+static expert_status loadKb(const std::string &content, expert_kb **out)
+{
+    if (!out)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "out is NULL");
+    *out = nullptr;
+    try
+    {
+        std::unique_ptr<expert_kb> kb(new expert_kb());
+        if (kb->parser.parseBuffer(content) != 0)
+            return fail(EXPERT_ERR_SYNTAX, "cannot parse knowledge base");
+        if (!kb->parser.getCombinedTruthTable().hasValidState())
+            return fail(EXPERT_ERR_NO_VALID_STATE, "no valid states for the given rules");
+        kb->symbols = kb->parser.getRuleSymbols();
+        kb->symbols.insert(kb->parser.getInitialFact().begin(), kb->parser.getInitialFact().end());
+        kb->symbols.insert(kb->parser.getQuerie().begin(), kb->parser.getQuerie().end());
+        *out = kb.release();
+        return EXPERT_OK;
+    }
+    catch (const std::logic_error &e)
+    {
+        return fail(EXPERT_ERR_SYNTAX, e.what());
+    }
+    catch (const std::exception &e)
+    {
+        return fail(EXPERT_ERR_INTERNAL, e.what());
+    }
+}
+
+extern "C" {
+
+int expert_abi_version(void)
+{
+    return EXPERT_ABI_VERSION;
+}
+
+const char *expert_status_string(expert_status status)
+{
+    switch (status)
+    {
+        case EXPERT_OK: return "ok";
+        case EXPERT_ERR_INVALID_ARGUMENT: return "invalid argument";
+        case EXPERT_ERR_IO: return "input/output error";
+        case EXPERT_ERR_SYNTAX: return "syntax error";
+        case EXPERT_ERR_NO_VALID_STATE: return "no valid state";
+        case EXPERT_ERR_BUFFER_TOO_SMALL: return "buffer too small";
+        case EXPERT_ERR_INTERNAL: return "internal error";
+        case EXPERT_PARTIAL: return "partial result";
+    }
+    return "unknown status";
+}
+
+const char *expert_last_error(void)
+{
+    return g_last_error.c_str();
+}
+
+expert_status expert_kb_load_file(const char *path, expert_kb **out)
+{
+    if (!path)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "path is NULL");
+    std::ifstream in(path);
+    if (!in)
+        return fail(EXPERT_ERR_IO, std::string("cannot open file ") + path);
+    std::ostringstream content;
+    content << in.rdbuf();
+    return loadKb(content.str(), out);
+}
+
+expert_status expert_kb_load_buffer(const char *data, size_t size, expert_kb **out)
+{
+    if (!data && size != 0)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "data is NULL");
+    return loadKb(std::string(data ? data : "", size), out);
+}
+
+expert_status expert_kb_queries(const expert_kb *kb, char *buf, size_t buf_len)
+{
+    if (!kb || !buf)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "kb or buf is NULL");
+    const std::set<symbol_t> &queries = const_cast<expert_kb *>(kb)->parser.getQuerie();
+    std::string text = SymbolTable::formatList(std::vector<symbol_t>(queries.begin(), queries.end()));
+    if (buf_len < text.size() + 1)
+        return fail(EXPERT_ERR_BUFFER_TOO_SMALL, "query buffer too small");
+    std::memcpy(buf, text.c_str(), text.size() + 1);
+    return EXPERT_OK;
+}
+
+void expert_kb_free(expert_kb *kb)
+{
+    delete kb;
+}
+
+expert_status expert_ctx_create(const expert_kb *kb, expert_ctx **out)
+{
+    if (!kb || !out)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "kb or out is NULL");
+    try
+    {
+        expert_ctx *ctx = new expert_ctx();
+        ctx->kb = const_cast<expert_kb *>(kb);
+        ctx->facts = ctx->kb->parser.getInitialFact();
+        *out = ctx;
+        return EXPERT_OK;
+    }
+    catch (const std::exception &e)
+    {
+        return fail(EXPERT_ERR_INTERNAL, e.what());
+    }
+}
+
+void expert_ctx_free(expert_ctx *ctx)
+{
+    delete ctx;
+}
+
+expert_status expert_ctx_clear_facts(expert_ctx *ctx)
+{
+    if (!ctx)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "ctx is NULL");
+    ctx->facts.clear();
+    return EXPERT_OK;
+}
+
+expert_status expert_ctx_set_fact(expert_ctx *ctx, const char *name, int value)
+{
+    if (!ctx)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "ctx is NULL");
+    symbol_t symbol;
+    if (findSymbol(ctx->kb, name, symbol) != EXPERT_OK)
+        return EXPERT_ERR_INVALID_ARGUMENT;
+    if (value)
+        ctx->facts.insert(symbol);
+    else
+        ctx->facts.erase(symbol);
+    return EXPERT_OK;
+}
+
+expert_status expert_ctx_set_facts(expert_ctx *ctx, const char *symbols)
+{
+    if (!ctx || !symbols)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "ctx or symbols is NULL");
+    std::vector<symbol_t> parsed;
+    if (parseSymbols(ctx->kb, symbols, parsed) != EXPERT_OK)
+        return EXPERT_ERR_INVALID_ARGUMENT;
+    ctx->facts = std::set<symbol_t>(parsed.begin(), parsed.end());
+    return EXPERT_OK;
+}
+
+expert_status expert_ctx_set_explain(expert_ctx *ctx, int enabled)
+{
+    if (!ctx)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "ctx is NULL");
+    ctx->explain = enabled != 0;
+    return EXPERT_OK;
+}
+
+expert_status expert_ctx_set_engine(expert_ctx *ctx, const char *name)
+{
+    if (!ctx)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "ctx is NULL");
+    if (!name || std::strcmp(name, "table") == 0)
+    {
+        ctx->engine.reset();
+        return EXPERT_OK;
+    }
+    try
+    {
+        std::unique_ptr<Engine> engine = Engine::create(name);
+        if (!engine)
+            return fail(EXPERT_ERR_INVALID_ARGUMENT, std::string("unknown engine: ") + name);
+        if (!engine->needsCombinedTable())
+            return fail(EXPERT_ERR_INVALID_ARGUMENT, std::string("engine needs the rule tables: ") + name);
+        ctx->engine = std::move(engine);
+        return EXPERT_OK;
+    }
+    catch (const std::exception &e)
+    {
+        return fail(EXPERT_ERR_INTERNAL, e.what());
+    }
+}
+
+expert_status expert_ctx_set_budget(expert_ctx *ctx, unsigned long timeout_ms, size_t max_memory_bytes)
+{
+    if (!ctx)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "ctx is NULL");
+    ctx->limits.timeout_ms = timeout_ms;
+    ctx->limits.max_memory_bytes = max_memory_bytes;
+    return EXPERT_OK;
+}
+
+expert_status expert_resolve(expert_ctx *ctx, const char *queries, expert_value *results, size_t results_len)
+{
+    if (!ctx || !results)
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "ctx or results is NULL");
+    Parser &parser = ctx->kb->parser;
+    std::vector<symbol_t> symbols;
+    if (!queries)
+        symbols.assign(parser.getQuerie().begin(), parser.getQuerie().end());
+    else if (parseSymbols(ctx->kb, queries, symbols) != EXPERT_OK)
+        return EXPERT_ERR_INVALID_ARGUMENT;
+    if (results_len < symbols.size())
+        return fail(EXPERT_ERR_BUFFER_TOO_SMALL, "results buffer too small");
+
+    try
+    {
+        ctx->last.reset();
+        std::set<symbol_t> query_set(symbols.begin(), symbols.end());
+        if (ctx->engine && !ctx->explain && !ctx->limits.isLimited())
+        {
+            std::map<symbol_t, rhr_value_e> values;
+            if (!ctx->engine->solve(parser, ctx->facts, query_set, values))
+                return fail(EXPERT_ERR_NO_VALID_STATE, "no valid states with the given initial facts");
+            for (size_t i = 0; i < symbols.size(); ++i)
+                results[i] = static_cast<expert_value>(values[symbols[i]]);
+            return EXPERT_OK;
+        }
+        if (!parser.hasValidStateWithFacts(ctx->facts))
+            return fail(EXPERT_ERR_NO_VALID_STATE, "no valid states with the given initial facts");
+        std::unique_ptr<Resolver> resolver(new Resolver(query_set, parser.getBasicRules(), ctx->facts, parser.getCombinedTruthTable()));
+        resolver->getReasoning().setEnabled(ctx->explain);
+        RequestBudget budget(ctx->limits);
+        if (ctx->limits.isLimited())
+            resolver->setRequestBudget(&budget);
+        std::map<symbol_t, rhr_value_e> values = resolver->evaluate();
+        resolver->setRequestBudget(nullptr);
+        for (size_t i = 0; i < symbols.size(); ++i)
+            results[i] = static_cast<expert_value>(resolver->queryResult(values, symbols[i]));
+        bool partial = resolver->isPartial();
+        ctx->last = std::move(resolver);
+        if (partial)
+            return fail(EXPERT_PARTIAL, std::string("request budget exceeded (") + budget.reasonName() + ")");
+        return EXPERT_OK;
+    }
+    catch (const std::exception &e)
+    {
+        return fail(EXPERT_ERR_INTERNAL, e.what());
+    }
+}
+
+expert_status expert_explain(const expert_ctx *ctx, const char *name, char *buf, size_t buf_len, size_t *written)
+{
+    if (!ctx || (!buf && buf_len != 0))
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "ctx or buf is NULL");
+    if (!ctx->last || !ctx->last->getReasoning().isEnabled())
+        return fail(EXPERT_ERR_INVALID_ARGUMENT, "no explained resolution to read from");
+    symbol_t symbol;
+    if (findSymbol(ctx->kb, name, symbol) != EXPERT_OK)
+        return EXPERT_ERR_INVALID_ARGUMENT;
+
+    std::ostringstream oss;
+    ctx->last->explain(symbol, oss);
+    std::string text = oss.str();
+    if (written)
+        *written = text.size();
+    if (buf_len < text.size() + 1)
+        return fail(EXPERT_ERR_BUFFER_TOO_SMALL, "explain buffer too small");
+    std::memcpy(buf, text.c_str(), text.size() + 1);
+    return EXPERT_OK;
+}
+
+}
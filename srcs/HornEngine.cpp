@@ -0,0 +1,180 @@
+#include "HornEngine.hpp"
+#include "Parser.hpp"
+
+HornEngine::HornEngine() : compiled(nullptr), horn(false)
+{
+}
+
+bool HornEngine::isHornRule(const BasicRule &rule)
+{
+    if (rule.rhs_negated)
+        return false;
+    for (const TokenBlock &block : rule.lhs)
+    {
+        for (const TokenEffect &token : block)
+        {
+            if (token.type != '+' && !SymbolTable::isSymbol(token.type))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool HornEngine::isHorn(const std::vector<BasicRule> &rules)
+{
+    for (const BasicRule &rule : rules)
+    {
+        if (!isHornRule(rule))
+            return false;
+    }
+    return true;
+}
+
+std::set<symbol_t> HornEngine::hornSymbols(const std::vector<BasicRule> &rules)
+{
+    // Kahn's algorithm on the premise -> conclusion graph: a symbol is reached
+    // after its premises, symbols on a cycle or after one are never reached
+    std::map<symbol_t, std::set<symbol_t>> successors;
+    std::map<symbol_t, std::set<symbol_t>> premises;
+    std::map<symbol_t, size_t> indegree;
+    std::set<symbol_t> non_horn;
+    for (const BasicRule &rule : rules)
+    {
+        indegree[rule.rhs_symbol];
+        if (!isHornRule(rule))
+            non_horn.insert(rule.rhs_symbol);
+        for (const TokenBlock &block : rule.lhs)
+        {
+            for (const TokenEffect &token : block)
+            {
+                if (!SymbolTable::isSymbol(token.type))
+                    continue;
+                indegree[token.type];
+                if (token.type == rule.rhs_symbol)
+                    continue;
+                premises[rule.rhs_symbol].insert(token.type);
+                if (successors[token.type].insert(rule.rhs_symbol).second)
+                    ++indegree[rule.rhs_symbol];
+            }
+        }
+    }
+    std::vector<symbol_t> ready;
+    for (const auto &node : indegree)
+    {
+        if (!node.second)
+            ready.push_back(node.first);
+    }
+    std::set<symbol_t> horn;
+    while (!ready.empty())
+    {
+        symbol_t symbol = ready.back();
+        ready.pop_back();
+        bool settled = !non_horn.count(symbol);
+        for (symbol_t premise : premises[symbol])
+            settled = settled && horn.count(premise);
+        if (settled)
+            horn.insert(symbol);
+        for (symbol_t next : successors[symbol])
+        {
+            if (--indegree[next] == 0)
+                ready.push_back(next);
+        }
+    }
+    return horn;
+}
+
+void HornEngine::compile(Parser &parser)
+{
+    compiled = &parser;
+    const std::vector<BasicRule> &rules = parser.getBasicRules();
+    premise_count.assign(rules.size(), 0);
+    premise_of.reset();
+    horn_symbol.reset();
+    // past an expansion budget the reference drops the table constraints, leave it to the fallback
+    std::set<symbol_t> symbols;
+    if (!parser.getExpansionReport().fallback)
+        symbols = hornSymbols(rules);
+    horn = symbols.size() == parser.getRuleSymbols().size();
+    for (symbol_t symbol : symbols)
+        horn_symbol.at(symbol) = 1;
+    for (size_t r = 0; r < rules.size(); ++r)
+    {
+        if (!horn_symbol[rules[r].rhs_symbol])
+            continue;
+        std::set<symbol_t> premises;
+        for (const TokenBlock &block : rules[r].lhs)
+        {
+            for (const TokenEffect &token : block)
+            {
+                if (SymbolTable::isSymbol(token.type))
+                    premises.insert(token.type);
+            }
+        }
+        premise_count[r] = premises.size();
+        for (symbol_t premise : premises)
+            premise_of.at(premise).push_back(r);
+    }
+}
+
+bool HornEngine::solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+                       std::map<symbol_t, rhr_value_e> &results)
+{
+    // the reference joins no table at all without rules, leaving no valid state
+    if (parser.getBasicRules().empty())
+        return false;
+    if (compiled != &parser)
+        compile(parser);
+
+    results.clear();
+    std::set<symbol_t> closed;
+    std::set<symbol_t> rest;
+    for (symbol_t q : queries)
+    {
+        if (horn || horn_symbol[q])
+            closed.insert(q);
+        else
+            rest.insert(q);
+    }
+    // all false but the closure satisfies every Horn rule, so only other rules can conflict with the facts
+    if (!horn && !fallback.solve(parser, facts, rest, results))
+        return false;
+    if (closed.empty())
+        return true;
+
+    // rules concluding other symbols are left out: their premise counts never drop
+    const std::vector<BasicRule> &rules = parser.getBasicRules();
+    std::vector<size_t> missing = premise_count;
+    std::vector<bool> proven(SymbolTable::limit(), false);
+    std::vector<symbol_t> pending;
+    for (symbol_t fact : facts)
+    {
+        proven[fact] = true;
+        pending.push_back(fact);
+    }
+    for (size_t r = 0; r < rules.size(); ++r)
+    {
+        if (horn_symbol[rules[r].rhs_symbol] && !missing[r] && !proven[rules[r].rhs_symbol])
+        {
+            proven[rules[r].rhs_symbol] = true;
+            pending.push_back(rules[r].rhs_symbol);
+        }
+    }
+    while (!pending.empty())
+    {
+        symbol_t symbol = pending.back();
+        pending.pop_back();
+        for (size_t r : premise_of[symbol])
+        {
+            symbol_t conclusion = rules[r].rhs_symbol;
+            if (--missing[r] == 0 && !proven[conclusion])
+            {
+                proven[conclusion] = true;
+                pending.push_back(conclusion);
+            }
+        }
+    }
+
+    for (symbol_t q : closed)
+        results[q] = q < proven.size() && proven[q] ? R_TRUE : R_FALSE;
+    return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "BasicRule.hpp"
+#include "EliminationEngine.hpp"
+
+/**
+ * Fast path for Horn rules, an AND of positive symbols implying one
+ * positive symbol. Their only answer is the forward closure of the facts,
+ * computed in linear time with one counter of unproven premises per rule
+ * (Dowling-Gallier), without truth table or backward proof.
+ *
+ * The classification is made per symbol: a query is answered by the
+ * closure when every rule it depends on is Horn. The recursive prover
+ * memoizes symbols proven while a cycle is still open, so the reference
+ * only reaches the closure when those rules have no cycle through two
+ * symbols or more. The other queries go to the elimination engine, which
+ * also checks that the facts have a model; a knowledge base made of Horn
+ * rules only always has one.
+ **/
+class HornEngine : public Engine
+{
+public:
+    HornEngine();
+
+    const char *name() const override { return "horn"; }
+    bool solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+               std::map<symbol_t, rhr_value_e> &results) override;
+    bool needsCombinedTable() const override { return false; }
+
+    /** check if a rule is an AND of positive symbols implying a positive symbol */
+    static bool isHornRule(const BasicRule &rule);
+    /** check if every rule is Horn */
+    static bool isHorn(const std::vector<BasicRule> &rules);
+    /**
+     * symbols of the rules whose value follows from Horn rules only: every
+     * rule concluding them or, transitively, one of their premises is Horn,
+     * and no symbol among them depends on itself through another one (self
+     * loops allowed).
+     **/
+    static std::set<symbol_t> hornSymbols(const std::vector<BasicRule> &rules);
+
+private:
+    EliminationEngine fallback;
+    /** parser the rules were indexed from, indexed once */
+    const Parser *compiled;
+    /** every symbol of the rules is a Horn symbol */
+    bool horn;
+    /** queries answered by the closure */
+    SymbolArray<uint8_t> horn_symbol;
+    /** distinct premises of each rule concluding a Horn symbol */
+    std::vector<size_t> premise_count;
+    /** rules having each symbol as a premise */
+    SymbolArray<std::vector<size_t>> premise_of;
+
+    void compile(Parser &parser);
+};
@@ -1,16 +1,18 @@
 #include "LogicRule.hpp"
+#include "MemoryAccounting.hpp"
+#include "RequestBudget.hpp"
 #include <sstream>
 #include <ostream>
 #include <queue>
 #include <climits>
 #include <set>
 
-LogicRule::LogicRule() : arrow(0), lhs(), rhs()
+LogicRule::LogicRule() : arrow(0), lhs(), rhs(), line(0)
 {
 }
 
 LogicRule::LogicRule(const TokenEffect &arrow_token, std::vector<TokenBlock> lhs_blocks, std::vector<TokenBlock> rhs_blocks)
-    : arrow(arrow_token), lhs(std::move(lhs_blocks)), rhs(std::move(rhs_blocks))
+    : arrow(arrow_token), lhs(std::move(lhs_blocks)), rhs(std::move(rhs_blocks)), line(0)
 {
 }
 
@@ -30,7 +32,7 @@ std::string renderSide(const std::vector<TokenBlock> &side)
         for (const TokenEffect &tk : side[i])
         {
             if (tk.type != 0)
-                oss << tk.type;
+                oss << SymbolTable::name(tk.type);
         }
 
         currentPriority = p;
@@ -274,7 +276,7 @@ static std::vector<LogicRule> applyDeMorgan(const LogicRule &rule)
         for (const TokenEffect &tk : block)
         {
             if (tk.type == '+' || tk.type == '|' || tk.type == '^' ||
-                (tk.type >= 'A' && tk.type <= 'Z') || tk.type == '!')
+                SymbolTable::isSymbol(tk.type) || tk.type == '!')
                 all_tokens.push_back(tk);
         }
     }
@@ -299,7 +301,7 @@ static std::vector<LogicRule> applyDeMorgan(const LogicRule &rule)
             // XOR stays XOR
             transformed_tokens.emplace_back(TokenEffect('^'));
         }
-        else if (tk.type >= 'A' && tk.type <= 'Z')
+        else if (SymbolTable::isSymbol(tk.type))
         {
             // Negate symbols
             transformed_tokens.emplace_back(TokenEffect('!'));
@@ -309,7 +311,7 @@ static std::vector<LogicRule> applyDeMorgan(const LogicRule &rule)
         {
             // Double negation cancels - skip this and next symbol
             if (i + 1 < all_tokens.size() && 
-                all_tokens[i + 1].type >= 'A' && all_tokens[i + 1].type <= 'Z')
+                SymbolTable::isSymbol(all_tokens[i + 1].type))
             {
                 transformed_tokens.push_back(all_tokens[i + 1]);
                 i++;
@@ -353,7 +355,7 @@ static std::vector<LogicRule> expandEquivalence(const LogicRule &rule)
     return expanded;
 }
 
-static int getOperatorPriority(char op)
+static int getOperatorPriority(symbol_t op)
 {
     if (op == '^') return 0;  // XOR: lowest priority
     if (op == '|') return 1;  // OR: medium priority
@@ -379,7 +381,7 @@ static std::vector<TokenBlock> normalizeBlocksByOperatorPriority(const std::vect
         }
         
         // Check if block has multiple operator types at base priority
-        std::set<char> operators_in_block;
+        std::set<symbol_t> operators_in_block;
         for (const TokenEffect &tk : block)
         {
             if (tk.type == '+' || tk.type == '|' || tk.type == '^')
@@ -395,7 +397,7 @@ static std::vector<TokenBlock> normalizeBlocksByOperatorPriority(const std::vect
         
         // Multiple operator types found - split by lowest-priority operator first
         // Find the lowest-priority operator in this block
-        char split_operator = 0;
+        symbol_t split_operator = 0;
         int lowest_priority = INT_MAX;
         size_t split_index = 0;
         
@@ -664,19 +666,19 @@ static std::vector<LogicRule> expandRhs(const LogicRule &rule)
 
 static void extractBasicRules(const LogicRule &rule, const LogicRule *origin, std::vector<BasicRule> &basics)
 {
-    std::set<std::pair<char, bool>> processed;
+    std::set<std::pair<symbol_t, bool>> processed;
     
     for (const TokenBlock &block : rule.rhs)
     {
         for (size_t i = 0; i < block.size(); ++i)
         {
-            char symbol = block[i].type;
+            symbol_t symbol = block[i].type;
 
-            if (symbol >= 'A' && symbol <= 'Z')
+            if (SymbolTable::isSymbol(symbol))
             {
                 bool is_negated = (i > 0 && block[i - 1].type == '!');
                 
-                std::pair<char, bool> symbol_pair = {symbol, is_negated};
+                std::pair<symbol_t, bool> symbol_pair = {symbol, is_negated};
                 
                 if (processed.find(symbol_pair) == processed.end())
                 {
@@ -688,7 +690,7 @@ static void extractBasicRules(const LogicRule &rule, const LogicRule *origin, st
     }
 }
 
-std::vector<BasicRule> LogicRule::deduceBasics() const
+std::vector<BasicRule> LogicRule::deduceBasics(size_t max_basics, RequestBudget *budget) const
 {
     std::vector<BasicRule> basics;
     std::queue<std::pair<LogicRule, const LogicRule*>> to_process;
@@ -697,8 +699,11 @@ std::vector<BasicRule> LogicRule::deduceBasics() const
     for (const LogicRule &rule : after_equiv)
         to_process.push({rule, this});
 
-    while (!to_process.empty())
+    while (!to_process.empty() && (max_basics == 0 || basics.size() <= max_basics))
     {
+        if (budget && (budget->poll() || budget->charge(MemoryAccounting::vectorBytes(basics)
+                + to_process.size() * sizeof(std::pair<LogicRule, const LogicRule *>))))
+            break;
         auto [current, origin] = to_process.front();
         to_process.pop();
 
@@ -8,6 +8,8 @@
 #include "BasicRule.hpp"
 #include <cstdint>
 
+class RequestBudget;
+
 /**
  * Logical rule with tokenized left/right expressions and an operator.
  **/
@@ -26,6 +28,10 @@ public:
      * right-hand side expression tokens, grouped by priority blocks.
      **/
     std::vector<TokenBlock> rhs;
+    /**
+     * line of the rule in its source, 0 when unknown.
+     **/
+    unsigned int line;
 
     /**
      * create an empty rule with no operator or sides.
@@ -41,8 +47,10 @@ public:
     std::string toString() const;
     /**
      * expand rule into basic rules (RHS with single variable).
+     * with max_basics set, stops once more than max_basics rules are produced;
+     * with budget given, stops with the rules so far once it is exhausted.
      **/
-    std::vector<BasicRule> deduceBasics() const;
+    std::vector<BasicRule> deduceBasics(size_t max_basics = 0, RequestBudget *budget = nullptr) const;
 };
 
 /**
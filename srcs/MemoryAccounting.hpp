@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Byte estimates of the heap used by standard containers, for --stats.
+ * They model glibc malloc (8 byte header, 16 byte alignment, 32 byte
+ * minimum block) and the libstdc++ node layouts: 32 bytes of links and
+ * colour per red-black tree node, one link per hash node plus the bucket
+ * array. The estimates are explicit, no allocator is replaced.
+ **/
+namespace MemoryAccounting
+{
+    inline size_t heapBlockBytes(size_t request)
+    {
+        if (request == 0)
+            return 0;
+        size_t block = (request + 8 + 15) & ~static_cast<size_t>(15);
+        return block < 32 ? 32 : block;
+    }
+
+    template <class T>
+    size_t vectorBytes(const std::vector<T> &v)
+    {
+        return heapBlockBytes(v.capacity() * sizeof(T));
+    }
+
+    template <class T>
+    size_t setBytes(const std::set<T> &s)
+    {
+        return s.size() * heapBlockBytes(32 + sizeof(T));
+    }
+
+    template <class K, class V>
+    size_t mapBytes(const std::map<K, V> &m)
+    {
+        return m.size() * heapBlockBytes(32 + sizeof(std::pair<const K, V>));
+    }
+
+    template <class K, class V>
+    size_t unorderedMapBytes(const std::unordered_map<K, V> &m)
+    {
+        return m.size() * heapBlockBytes(sizeof(void *) + sizeof(std::pair<const K, V>))
+            + heapBlockBytes(m.bucket_count() * sizeof(void *));
+    }
+}
@@ -1,10 +1,16 @@
 #include "Parser.hpp"
+#include "MemoryAccounting.hpp"
+#include "Timeline.hpp"
+#include "StateIndex.hpp"
 #include "TruthTable.hpp"
+#include "TwoSat.hpp"
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 
-Parser::Parser(std::string input) : input_path(input), priority(0)
+Parser::Parser(std::string input) : input_path(input), priority(0), stats(nullptr), join_tables(true),
+	fact_pushdown(false), fact_specialized(false), request_budget(nullptr), partial(false), version(0)
 {
 }
 
@@ -14,38 +20,20 @@ Parser::~Parser()
 
 void Parser::parseFact(std::string line)
 {
-	for (size_t i = 1; i < line.size(); i++)
-	{
-		if (line[i] == '#')
-			break;
-		else if (line[i] == ' ')
-			continue;
-		else if (line[i] >= 'A' && line[i] <= 'Z')
-			initial_facts.emplace(line[i]);
-		else
-		{
-			std::string msg = std::string("Syntax error in initial_facts: ") + line[i];
-			throw std::logic_error(msg);
-		}
-	}
+	std::vector<symbol_t> symbols;
+	std::string error;
+	if (!SymbolTable::parseList(line.substr(1), symbols, error))
+		throw std::logic_error("Syntax error in initial_facts: " + error);
+	initial_facts.insert(symbols.begin(), symbols.end());
 }
 
 void Parser::parseQuerie(std::string line)
 {
-	for (size_t i = 1; i < line.size(); i++)
-	{
-		if (line[i] == '#')
-			break;
-		else if (line[i] == ' ')
-			continue;
-		else if (line[i] >= 'A' && line[i] <= 'Z')
-			querie.emplace(line[i]);
-		else
-		{
-			std::string msg = std::string("Syntax error in initial_facts: ") + line[i];
-			throw std::logic_error(msg);
-		}
-	}
+	std::vector<symbol_t> symbols;
+	std::string error;
+	if (!SymbolTable::parseList(line.substr(1), symbols, error))
+		throw std::logic_error("Syntax error in initial_facts: " + error);
+	querie.insert(symbols.begin(), symbols.end());
 }
 
 void Parser::parseClassic(std::string line, LogicRule &fact_line)
@@ -58,6 +46,26 @@ void Parser::parseClassic(std::string line, LogicRule &fact_line)
 			break;
 		else if (line[i] == ' ' || line[i] == '\n')
 			buff.clear();
+		else if (buff.empty() && SymbolTable::isIdentifierChar(line[i]))
+		{
+			// a whole identifier at once: one letter or one name. Several capitals
+			// would be several symbols with no operator between them
+			size_t end = i;
+			while (end < line.size() && SymbolTable::isIdentifierChar(line[end]))
+				++end;
+			std::string run = line.substr(i, end - i);
+			if (run.size() > 1 && run.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZ") == std::string::npos)
+				throw std::logic_error("Syntax error in rule: " + run + " token, capitals are single-letter symbols");
+			std::vector<symbol_t> symbols;
+			if (!SymbolTable::splitRun(run, symbols))
+				throw std::logic_error("Input file format do not manage: " + run + " token");
+			std::vector<TokenBlock> &tokenSide = (side == 1) ? fact_line.lhs : fact_line.rhs;
+			if (tokenSide.empty() || tokenSide.back().getPriority() != static_cast<unsigned int>(priority))
+				tokenSide.emplace_back(priority);
+			for (symbol_t symbol : symbols)
+				tokenSide.back().emplace_back(TokenEffect(symbol));
+			i = end - 1;
+		}
 		else
 		{
 			std::vector<TokenBlock> &tokenSide = (side == 1) ? fact_line.lhs : fact_line.rhs;
@@ -87,24 +95,19 @@ void Parser::parseClassic(std::string line, LogicRule &fact_line)
 					fact_line.rhs.emplace_back(priority);
 				buff.clear();
 			}
-			else if (buff.size() == 1 && buff[0] >= 'A' && buff[0] <= 'Z')
-			{
-				if (tokenSide.empty() || tokenSide.back().getPriority() != static_cast<unsigned int>(priority))
-					tokenSide.emplace_back(priority);
-				tokenSide.back().emplace_back(TokenEffect(buff[0]));
-				buff.clear();
-			}
 			else if (buff.size() >= 3)
 				throw std::logic_error("Input file format do not manage: " + buff + " token");
 		}
 	}
 }
 
-void Parser::parsingManager(std::ifstream &in)
+void Parser::parsingManager(std::istream &in)
 {
 	std::string line;
+	unsigned int line_number = 0;
 	while (std::getline(in, line))
 	{
+		++line_number;
 		line.erase(0, line.find_first_not_of(" "));
 		if (line.size() > 0 && line[0] != '#')
 		{
@@ -115,6 +118,7 @@ void Parser::parsingManager(std::ifstream &in)
 			else
 			{
 				facts.emplace_back();
+				facts.back().line = line_number;
 				parseClassic(line, facts.back());
 			}
 		}
@@ -149,31 +153,293 @@ int Parser::parse()
 	std::ifstream in(this->input_path);
 	if (!in)
 		return (std::cerr << "Error: cannot open file " << this->input_path << "\n", 1);
-	parsingManager(in);
-	finalizeParsing();
-	expandRules();
-	return 0;
+	return parseStream(in);
 }
 
-void Parser::expandRules()
+int Parser::parseStream(std::istream &in)
 {
-	for (const LogicRule &rule : facts)
+	Timeline::Span span("parse");
+	EngineStats::Clock::time_point start = EngineStats::Clock::now();
+	{
+		Timeline::Span read_span("parse_lines");
+		parsingManager(in);
+	}
 	{
-		std::vector<BasicRule> basics = rule.deduceBasics();
-		basic_rules.insert(basic_rules.end(), basics.begin(), basics.end());
+		Timeline::Span finalize_span("finalize_parsing");
+		finalizeParsing();
 	}
+	bool expanded = expandRules();
+	if (stats)
+		stats->parse_us = EngineStats::elapsedUs(start);
+	return expanded ? 0 : 1;
+}
+
+int Parser::parseBuffer(const std::string &content)
+{
+	std::istringstream in(content);
+	return parseStream(in);
+}
+
+bool Parser::expandRules()
+{
+	Timeline::Span span("expand_rules");
+	EngineStats::Clock::time_point start = EngineStats::Clock::now();
+	expansion = ExpansionReport();
+	partial = false;
+	{
+		Timeline::Span deduce_span("deduce_basics");
+		for (size_t i = 0; i < facts.size(); ++i)
+		{
+			std::vector<BasicRule> basics = facts[i].deduceBasics(budget.max_basics_per_rule, request_budget);
+			ExpansionReport::Entry entry;
+			entry.line = facts[i].line;
+			entry.basics = basics.size();
+			for (const BasicRule &basic : basics)
+			{
+				for (const TokenBlock &block : basic.lhs)
+					entry.lhs_tokens += block.size();
+			}
+			expansion.rules.push_back(entry);
+			if (budget.max_basics_per_rule && basics.size() > budget.max_basics_per_rule)
+			{
+				return exceedBudget("rule at line " + std::to_string(facts[i].line) + " expands to more than "
+					+ std::to_string(budget.max_basics_per_rule) + " basic rules (--max-basics)", false);
+			}
+			basic_rule_sources.insert(basic_rule_sources.end(), basics.size(), i);
+			if (stats)
+				stats->basics_per_rule.push_back(basics.size());
+			basic_rules.insert(basic_rules.end(), basics.begin(), basics.end());
+			if (request_budget && request_budget->isExhausted())
+				return exceedRequestBudget("deducing basic rules");
+		}
+	}
+	if (stats)
+		recordRuleMemory();
 	
+	std::map<symbol_t, bool> known;
+	if (fact_pushdown && join_tables)
+	{
+		for (symbol_t fact : initial_facts)
+			known[fact] = true;
+		// on a conflict the facts have no state: the tables come out empty either way
+		Timeline::Span propagate_span("propagate_facts");
+		propagateKnown(known);
+		expansion.pushed_values = known.size();
+		expansion.propagated_values = known.size() - initial_facts.size();
+	}
+	bool built = buildTables(known);
+	if (stats)
+		stats->expand_us = EngineStats::elapsedUs(start);
+	return built;
+}
+
+bool Parser::propagateKnown(std::map<symbol_t, bool> &known) const
+{
+	std::vector<std::vector<symbol_t>> rule_vars(basic_rules.size());
+	std::map<symbol_t, std::vector<size_t>> rules_of;
+	for (size_t r = 0; r < basic_rules.size(); ++r)
+	{
+		std::set<symbol_t> vars;
+		for (const TokenBlock &block : basic_rules[r].lhs)
+		{
+			for (const TokenEffect &token : block)
+			{
+				if (SymbolTable::isSymbol(token.type))
+					vars.insert(token.type);
+			}
+		}
+		vars.insert(basic_rules[r].rhs_symbol);
+		rule_vars[r].assign(vars.begin(), vars.end());
+		for (symbol_t var : vars)
+			rules_of[var].push_back(r);
+	}
+
+	// every rule once, then again whenever one of its symbols gets a value
+	std::vector<size_t> pending;
+	std::vector<bool> queued(basic_rules.size(), true);
+	for (size_t r = basic_rules.size(); r-- > 0;)
+		pending.push_back(r);
+	while (!pending.empty())
+	{
+		size_t r = pending.back();
+		pending.pop_back();
+		queued[r] = false;
+		std::vector<symbol_t> unknown;
+		std::map<symbol_t, bool> state;
+		for (symbol_t var : rule_vars[r])
+		{
+			auto it = known.find(var);
+			if (it != known.end())
+				state[var] = it->second;
+			else
+				unknown.push_back(var);
+		}
+		if (unknown.empty() || unknown.size() > MAX_PROPAGATION_VARS)
+		{
+			if (unknown.empty() && !TruthTable::satisfies(basic_rules[r], state))
+				return false;
+			continue;
+		}
+		// the values each unknown symbol takes in the states of the rule: bit 0 false, bit 1 true
+		std::vector<int> seen(unknown.size(), 0);
+		for (size_t mask = 0; mask < (static_cast<size_t>(1) << unknown.size()); ++mask)
+		{
+			for (size_t j = 0; j < unknown.size(); ++j)
+				state[unknown[j]] = (mask >> j) & 1;
+			if (!TruthTable::satisfies(basic_rules[r], state))
+				continue;
+			for (size_t j = 0; j < unknown.size(); ++j)
+				seen[j] |= 1 << ((mask >> j) & 1);
+		}
+		for (size_t j = 0; j < unknown.size(); ++j)
+		{
+			if (!seen[j])
+				return false;
+			if (seen[j] == 3)
+				continue;
+			known[unknown[j]] = seen[j] == 2;
+			for (size_t next : rules_of[unknown[j]])
+			{
+				if (!queued[next])
+				{
+					queued[next] = true;
+					pending.push_back(next);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool Parser::buildTables(const std::map<symbol_t, bool> &known)
+{
+	static std::atomic<uint64_t> next_version(0);
+	version = ++next_version;
+	fact_specialized = !known.empty();
+	expansion.two_sat_clauses = 0;
+	for (ExpansionReport::Entry &entry : expansion.rules)
+		entry.table_states = 0;
 	std::vector<TruthTable> tables;
-	for (const BasicRule &rule : basic_rules)
+	size_t table_bytes = 0;
+	{
+		Timeline::Span tables_span("rule_truth_tables");
+		for (size_t i = 0; i < basic_rules.size(); ++i)
+		{
+			// one table is a large step, the clock is read before each
+			if (request_budget && request_budget->check())
+				return exceedRequestBudget("building truth tables");
+			TruthTable table = TruthTable::fromBasicRule(basic_rules[i], known);
+			//std::cout << "Basic rule: " << rule.toString() << std::endl;
+			//std::cout << rule.structureToString() << std::endl;
+			//std::cout << table.toString() << std::endl;
+			expansion.rules[basic_rule_sources[i]].table_states += table.countValidStates();
+			if (budget.max_table_states && table.countValidStates() > budget.max_table_states)
+			{
+				return exceedBudget("truth table of " + basic_rules[i].toString() + " has "
+					+ std::to_string(table.countValidStates()) + " states, more than "
+					+ std::to_string(budget.max_table_states) + " (--max-table-states)", true);
+			}
+			if (stats)
+				table_bytes += table.memoryBytes();
+			tables.push_back(table);
+		}
+	}
+	if (stats)
+		stats->setMemory(EngineStats::MEM_RULE_TABLES, table_bytes);
+	if (!join_tables)
+	{
+		// the engine works on the rule tables, leave the combined table unconstrained
+		rule_tables = std::move(tables);
+		combined_truth_table = TruthTable::unconstrained(getRuleSymbols());
+		combined_truth_table.buildIndex();
+		return true;
+	}
+	std::shared_ptr<TwoSat> implications = std::make_shared<TwoSat>();
+	if (!tables.empty() && TwoSat::fromTables(tables, *implications))
+	{
+		// binary clauses only: the implication graph replaces the join
+		combined_truth_table = TruthTable::unconstrained(getRuleSymbols());
+		if (!implications->isSatisfiable())
+			combined_truth_table.valid_states.clear();
+		combined_truth_table.two_sat = implications;
+		expansion.two_sat_clauses = implications->clauseCount();
+		if (stats)
+		{
+			stats->setMemory(EngineStats::MEM_COMBINED_TABLE, combined_truth_table.memoryBytes());
+			stats->setMemory(EngineStats::MEM_RULE_TABLES, 0);
+		}
+		expansion.combined_states = combined_truth_table.countValidStates();
+		expansion.combined_variables = implications->symbolCount();
+		return true;
+	}
+	EngineStats::Clock::time_point join_start = EngineStats::Clock::now();
 	{
-		TruthTable table = TruthTable::fromBasicRule(rule);
-		//std::cout << "Basic rule: " << rule.toString() << std::endl;
-		//std::cout << rule.structureToString() << std::endl;
-		//std::cout << table.toString() << std::endl;
-		tables.push_back(table);
+		Timeline::Span join_span("conjunction_all");
+		combined_truth_table = TruthTable::conjunctionAll(tables, stats, budget.max_combined_states, request_budget);
 	}
-	combined_truth_table = TruthTable::conjunctionAll(tables);
 	//std::cout << combined_truth_table.toString() << std::endl;
+	if (stats)
+	{
+		stats->conjunction_us = EngineStats::elapsedUs(join_start);
+		// the rule tables are released on return
+		stats->setMemory(EngineStats::MEM_COMBINED_TABLE, combined_truth_table.memoryBytes());
+		stats->setMemory(EngineStats::MEM_RULE_TABLES, 0);
+	}
+	if (request_budget && request_budget->isExhausted())
+		return exceedRequestBudget("joining truth tables");
+	if (budget.max_combined_states && combined_truth_table.countValidStates() > budget.max_combined_states)
+	{
+		return exceedBudget("combined truth table grows past " + std::to_string(budget.max_combined_states)
+			+ " states (--max-combined-states)", true);
+	}
+	combined_truth_table.buildIndex();
+	if (stats)
+		stats->setMemory(EngineStats::MEM_COMBINED_TABLE, combined_truth_table.memoryBytes());
+	expansion.combined_states = combined_truth_table.countValidStates();
+	expansion.combined_variables = combined_truth_table.variables.size();
+	return true;
+}
+
+void Parser::recordRuleMemory()
+{
+	size_t facts_bytes = MemoryAccounting::vectorBytes(facts) + MemoryAccounting::setBytes(initial_facts)
+		+ MemoryAccounting::setBytes(querie);
+	for (const LogicRule &rule : facts)
+		facts_bytes += TokenBlock::memoryBytes(rule.lhs) + TokenBlock::memoryBytes(rule.rhs);
+	stats->setMemory(EngineStats::MEM_FACTS, facts_bytes);
+
+	size_t basics_bytes = MemoryAccounting::vectorBytes(basic_rules) + MemoryAccounting::vectorBytes(basic_rule_sources);
+	for (const BasicRule &rule : basic_rules)
+		basics_bytes += TokenBlock::memoryBytes(rule.lhs);
+	stats->setMemory(EngineStats::MEM_BASIC_RULES, basics_bytes);
+}
+
+bool Parser::exceedBudget(const std::string &message, bool can_fall_back)
+{
+	expansion.budget_exceeded = message;
+	if (!can_fall_back || budget.action != ExpansionBudget::FALLBACK)
+	{
+		std::cerr << "Error: expansion budget exceeded: " << message << std::endl;
+		return false;
+	}
+	combined_truth_table = TruthTable::unconstrained(getRuleSymbols());
+	combined_truth_table.buildIndex();
+	fact_specialized = false;
+	expansion.fallback = true;
+	std::cerr << "Warning: expansion budget exceeded: " << message
+		<< "; resolving without truth table constraints" << std::endl;
+	return true;
+}
+
+bool Parser::exceedRequestBudget(const std::string &stage)
+{
+	expansion.budget_exceeded = std::string("request budget exceeded (") + request_budget->reasonName() + ") while " + stage;
+	combined_truth_table = TruthTable::unconstrained(getRuleSymbols());
+	combined_truth_table.buildIndex();
+	fact_specialized = false;
+	expansion.fallback = true;
+	partial = true;
+	return true;
 }
 
 std::vector<LogicRule> &Parser::getFacts()
@@ -186,13 +452,13 @@ std::vector<BasicRule> &Parser::getBasicRules()
 	return basic_rules;
 }
 
-std::set<char> &Parser::getQuerie()
+std::set<symbol_t> &Parser::getQuerie()
 {
 
     return querie;
 }
 
-std::set<char> &Parser::getInitialFact()
+std::set<symbol_t> &Parser::getInitialFact()
 {
     return initial_facts;
 }
@@ -202,13 +468,111 @@ TruthTable &Parser::getCombinedTruthTable()
 	return combined_truth_table;
 }
 
+const std::vector<TruthTable> &Parser::getRuleTables() const
+{
+	return rule_tables;
+}
+
+void Parser::setJoinTables(bool join)
+{
+	join_tables = join;
+}
+
+void Parser::setFactPushdown(bool pushdown)
+{
+	fact_pushdown = pushdown;
+}
+
+bool Parser::isFactSpecialized() const
+{
+	return fact_specialized;
+}
+
+bool Parser::ensureFullTable()
+{
+	if (!fact_specialized)
+		return true;
+	Timeline::Span span("full_table");
+	return buildTables(std::map<symbol_t, bool>());
+}
+
+bool Parser::hasValidRuleState()
+{
+	if (combined_truth_table.hasValidState())
+		return true;
+	// an empty specialized table may come from the facts alone
+	return fact_specialized && ensureFullTable() && combined_truth_table.hasValidState();
+}
+
+std::vector<size_t> &Parser::getBasicRuleSources()
+{
+	return basic_rule_sources;
+}
+
+std::set<symbol_t> Parser::getRuleSymbols() const
+{
+	std::set<symbol_t> symbols;
+	for (const BasicRule &rule : basic_rules)
+	{
+		symbols.insert(rule.rhs_symbol);
+		for (const TokenBlock &block : rule.lhs)
+		{
+			for (const TokenEffect &token : block)
+			{
+				if (SymbolTable::isSymbol(token.type))
+					symbols.insert(token.type);
+			}
+		}
+	}
+	return symbols;
+}
+
+const ExpansionReport &Parser::getExpansionReport() const
+{
+	return expansion;
+}
+
+uint64_t Parser::getVersion() const
+{
+	return version;
+}
+
+void Parser::setBudget(const ExpansionBudget &budget)
+{
+	this->budget = budget;
+}
+
+void Parser::setRequestBudget(RequestBudget *budget)
+{
+	request_budget = budget;
+}
+
+bool Parser::isPartial() const
+{
+	return partial;
+}
+
+void Parser::setStats(EngineStats *stats)
+{
+	this->stats = stats;
+}
+
 bool Parser::hasValidStateWithInitialFacts() const
 {
-	std::map<char, bool> known_facts;
-	for (char c : initial_facts)
+	return hasValidStateWithFacts(initial_facts);
+}
+
+bool Parser::hasValidStateWithFacts(const std::set<symbol_t> &facts) const
+{
+	std::map<symbol_t, bool> known_facts;
+	for (symbol_t c : facts)
 	{
 		known_facts[c] = true;
 	}
-	TruthTable filtered = combined_truth_table.filterByFacts(known_facts);
-	return filtered.hasValidState();
+	if (combined_truth_table.getTwoSat())
+		return combined_truth_table.getTwoSat()->hasModelWith(known_facts);
+	const StateIndex *index = combined_truth_table.getIndex();
+	if (index)
+		return StateIndex::any(index->filter(known_facts));
+	return combined_truth_table.filterByFacts(known_facts).hasValidState();
 }
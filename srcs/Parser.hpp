@@ -1,27 +1,84 @@
 #pragma once
+#include <cstdint>
+#include <map>
 #include <vector>
 #include <set>
 #include <string>
 #include <fstream>
+#include "EngineStats.hpp"
+#include "ExpansionReport.hpp"
 #include "LogicRule.hpp"
+#include "RequestBudget.hpp"
 #include "TruthTable.hpp"
 
 class Parser
 {
 private:
+    /** unknown symbols of a rule above which propagation skips it */
+    static const size_t MAX_PROPAGATION_VARS = 12;
+
     std::string input_path;
     std::vector<LogicRule> facts;
     std::vector<BasicRule> basic_rules;
-    std::set<char> initial_facts;
-    std::set<char> querie;
+    /** index in facts of the rule each basic rule was deduced from */
+    std::vector<size_t> basic_rule_sources;
+    std::set<symbol_t> initial_facts;
+    std::set<symbol_t> querie;
     unsigned int priority;
     TruthTable combined_truth_table;
-    void expandRules();
+    /** optional phase timings (--stats), not owned */
+    EngineStats *stats;
+    /** join the rule tables into combined_truth_table, else keep them in rule_tables */
+    bool join_tables;
+    std::vector<TruthTable> rule_tables;
+    /** restrict the tables to the initial facts, and the values they force, while building them */
+    bool fact_pushdown;
+    /** combined_truth_table only holds the states agreeing with initial_facts */
+    bool fact_specialized;
+    ExpansionBudget budget;
+    ExpansionReport expansion;
+    /** optional time and memory of the request, not owned */
+    RequestBudget *request_budget;
+    /** the request budget ran out during the last parse */
+    bool partial;
+    /** identifies the rules and tables, renewed whenever the tables are built */
+    uint64_t version;
+    /**
+     * Deduce basic rules and build the combined truth table within the budget.
+     * Return false when a budget is exceeded and no fallback applies.
+     */
+    bool expandRules();
+    /**
+     * Add to known the values it forces through the basic rules, by unit
+     * propagation over each rule with at most MAX_PROPAGATION_VARS unknown
+     * symbols, before any table is enumerated. Every value added holds in
+     * each state of the tables agreeing with known. Return false on a
+     * conflict, known then holding what was forced so far.
+     */
+    bool propagateKnown(std::map<symbol_t, bool> &known) const;
+    /**
+     * Build the rule tables restricted to the known values, and join them
+     * unless the join is skipped. Return false as expandRules.
+     */
+    bool buildTables(const std::map<symbol_t, bool> &known);
+    /**
+     * Report an exceeded budget, dropping the truth table constraints when allowed.
+     */
+    bool exceedBudget(const std::string &message, bool can_fall_back);
+    /**
+     * Record that the request budget ran out during stage, dropping the
+     * truth table constraints so the rules resolve what they can
+     */
+    bool exceedRequestBudget(const std::string &stage);
+    /**
+     * Account the memory of the source and basic rules in stats
+     */
+    void recordRuleMemory();
 
 public:
     Parser(std::string input);
     ~Parser();
-    void parsingManager(std::ifstream &in);
+    void parsingManager(std::istream &in);
     /**
      * record what is after '=' (facts defined) in querie vector
      */
@@ -44,11 +101,76 @@ public:
      * Parser routing logic. Parser entry point
      */
     int parse();
+    /**
+     * Parse rules, facts and queries from an already opened stream
+     */
+    int parseStream(std::istream &in);
+    /**
+     * Parse rules, facts and queries held in memory
+     */
+    int parseBuffer(const std::string &content);
 
     std::vector<LogicRule> &getFacts();
     std::vector<BasicRule> &getBasicRules();
-    std::set<char> &getQuerie();
-    std::set<char> &getInitialFact();
+    std::vector<size_t> &getBasicRuleSources();
+    /**
+     * Every symbol appearing in a basic rule
+     */
+    std::set<symbol_t> getRuleSymbols() const;
+    std::set<symbol_t> &getQuerie();
+    std::set<symbol_t> &getInitialFact();
     TruthTable &getCombinedTruthTable();
+    /**
+     * Truth table of each basic rule, only kept when the join is skipped
+     */
+    const std::vector<TruthTable> &getRuleTables() const;
+    /**
+     * Whether the next parse joins the rule tables (default), for engines
+     * working on the rule tables the combined table is left unconstrained
+     */
+    void setJoinTables(bool join);
+    /**
+     * Push the initial facts into the rule tables and the join (predicate
+     * pushdown): the combined table is then specialized to the initial facts
+     */
+    void setFactPushdown(bool pushdown);
+    bool isFactSpecialized() const;
+    /**
+     * Build the table over every assignment if only the specialized one exists,
+     * needed before checking other facts. Return false when a budget is exceeded
+     */
+    bool ensureFullTable();
+    /**
+     * Check that the rules alone allow a state, building the full table
+     * when the specialized one is empty
+     */
+    bool hasValidRuleState();
+    /**
+     * Record parse timings and table growth into stats (nullptr to disable)
+     */
+    void setStats(EngineStats *stats);
+    /**
+     * Limits applied by the next parse
+     */
+    void setBudget(const ExpansionBudget &budget);
+    /**
+     * Time and memory the next parse may use (nullptr for no limit)
+     */
+    void setRequestBudget(RequestBudget *budget);
+    /**
+     * Whether the last parse ran out of its request budget: rules may be
+     * missing, so only a resolution out of budget too is sound
+     */
+    bool isPartial() const;
+    const ExpansionReport &getExpansionReport() const;
+    /**
+     * Version of the knowledge base, unique across parsers of the process:
+     * answers cached under one version stay valid until it changes
+     */
+    uint64_t getVersion() const;
     bool hasValidStateWithInitialFacts() const;
+    /**
+     * Check the combined truth table against another set of true facts
+     */
+    bool hasValidStateWithFacts(const std::set<symbol_t> &facts) const;
 };
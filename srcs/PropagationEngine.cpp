@@ -0,0 +1,221 @@
+#include "PropagationEngine.hpp"
+#include "Parser.hpp"
+#include "Resolver.hpp"
+#include "StateIndex.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+PropagationEngine::PropagationEngine() : compiled(nullptr), symbol_index(-1), contradiction(false)
+{
+}
+
+void PropagationEngine::compile(Parser &parser)
+{
+    compiled = &parser;
+    std::set<symbol_t> rule_symbols = parser.getRuleSymbols();
+    symbols.assign(rule_symbols.begin(), rule_symbols.end());
+    symbol_index.reset();
+    for (size_t i = 0; i < symbols.size(); ++i)
+        symbol_index.at(symbols[i]) = i;
+    clauses.clear();
+    units.clear();
+    watches.assign(symbols.size() * 2, std::vector<size_t>());
+    contradiction = false;
+    // past an expansion budget the reference resolves without table constraints
+    if (parser.getExpansionReport().fallback)
+        return;
+
+    const std::vector<TruthTable> &tables = parser.getRuleTables();
+    if (tables.size() != parser.getBasicRules().size())
+        throw std::runtime_error("propagation engine needs the rule tables (Parser::setJoinTables(false))");
+    for (const TruthTable &table : tables)
+    {
+        std::vector<symbol_t> vars(table.variables.begin(), table.variables.end());
+        if (table.valid_states.empty())
+            contradiction = true;
+        // each assignment missing from the table becomes a clause forbidding it
+        for (size_t mask = 0; mask < (static_cast<size_t>(1) << vars.size()); ++mask)
+        {
+            std::map<symbol_t, bool> state;
+            for (size_t j = 0; j < vars.size(); ++j)
+                state[vars[j]] = (mask >> j) & 1;
+            if (table.valid_states.count(VariableState(state)))
+                continue;
+            std::vector<Literal> clause;
+            for (size_t j = 0; j < vars.size(); ++j)
+                clause.push_back(2 * symbol_index[vars[j]] + ((mask >> j) & 1));
+            if (clause.size() == 1)
+            {
+                units.push_back(clause[0]);
+                continue;
+            }
+            watches[clause[0]].push_back(clauses.size());
+            watches[clause[1]].push_back(clauses.size());
+            clauses.push_back(clause);
+        }
+    }
+}
+
+bool PropagationEngine::propagate(const std::map<symbol_t, bool> &known, std::vector<int8_t> &values)
+{
+    values.assign(symbols.size(), -1);
+    std::vector<Literal> trail;
+    // make lit true, false on a conflict with its current value
+    auto assign = [&](Literal lit) {
+        int8_t value = (lit & 1) ? 0 : 1;
+        if (values[lit / 2] != -1)
+            return values[lit / 2] == value;
+        values[lit / 2] = value;
+        trail.push_back(lit);
+        return true;
+    };
+    auto isFalse = [&](Literal lit) { return values[lit / 2] == ((lit & 1) ? 1 : 0); };
+
+    if (contradiction)
+        return false;
+    for (const auto &entry : known)
+    {
+        int index = symbol_index[entry.first];
+        if (index >= 0 && !assign(2 * index + (entry.second ? 0 : 1)))
+            return false;
+    }
+    for (Literal unit : units)
+    {
+        if (!assign(unit))
+            return false;
+    }
+
+    for (size_t head = 0; head < trail.size(); ++head)
+    {
+        Literal false_lit = trail[head] ^ 1;
+        std::vector<size_t> &watching = watches[false_lit];
+        for (size_t w = 0; w < watching.size();)
+        {
+            std::vector<Literal> &clause = clauses[watching[w]];
+            if (clause[0] == false_lit)
+                std::swap(clause[0], clause[1]);
+            // clause[1] is the false watch, look for a replacement
+            bool moved = false;
+            if (!(values[clause[0] / 2] != -1 && !isFalse(clause[0])))
+            {
+                for (size_t k = 2; k < clause.size(); ++k)
+                {
+                    if (!isFalse(clause[k]))
+                    {
+                        std::swap(clause[1], clause[k]);
+                        watches[clause[1]].push_back(watching[w]);
+                        watching[w] = watching.back();
+                        watching.pop_back();
+                        moved = true;
+                        break;
+                    }
+                }
+            }
+            if (moved)
+                continue;
+            // no replacement: the other watch is satisfied, forced, or in conflict
+            if (!assign(clause[0]))
+                return false;
+            ++w;
+        }
+    }
+    return true;
+}
+
+TruthTable PropagationEngine::residual(const std::vector<TruthTable> &tables, const std::vector<int8_t> &values) const
+{
+    std::map<symbol_t, bool> forced;
+    for (size_t i = 0; i < symbols.size(); ++i)
+    {
+        if (values[i] != -1)
+            forced[symbols[i]] = values[i];
+    }
+    std::vector<TruthTable> restricted;
+    for (const TruthTable &table : tables)
+    {
+        TruthTable rest;
+        for (symbol_t var : table.variables)
+        {
+            if (!forced.count(var))
+                rest.variables.insert(var);
+        }
+        // fully forced tables hold, propagation checked all their clauses
+        if (rest.variables.empty())
+            continue;
+        for (const VariableState &state : table.filterByFacts(forced).valid_states)
+        {
+            VariableState projected;
+            for (symbol_t var : rest.variables)
+                projected.values[var] = state.values.at(var);
+            rest.valid_states.insert(projected);
+        }
+        restricted.push_back(rest);
+    }
+    if (restricted.empty())
+        return TruthTable::unconstrained(std::set<symbol_t>());
+    return TruthTable::conjunctionAll(restricted);
+}
+
+bool PropagationEngine::solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+                              std::map<symbol_t, rhr_value_e> &results)
+{
+    // the reference joins no table at all without rules, leaving no valid state
+    if (parser.getBasicRules().empty())
+        return false;
+    if (compiled != &parser)
+        compile(parser);
+    std::vector<TruthTable> no_tables;
+    const std::vector<TruthTable> &tables = parser.getExpansionReport().fallback ? no_tables : parser.getRuleTables();
+
+    // rule-based values, without truth table constraints
+    std::set<symbol_t> rule_symbols(symbols.begin(), symbols.end());
+    TruthTable unconstrained = TruthTable::unconstrained(rule_symbols);
+    Resolver resolver(queries, parser.getBasicRules(), facts, unconstrained);
+    std::map<symbol_t, rhr_value_e> base = resolver.evaluate();
+
+    // clamp with the states agreeing with every known value, as Resolver::evaluate.
+    // Those values include the facts, so a residual with a state also shows
+    // that the facts have one: the tables are only joined again when it has none
+    std::map<symbol_t, bool> fact_values;
+    for (symbol_t fact : facts)
+        fact_values[fact] = true;
+    std::map<symbol_t, bool> known = fact_values;
+    for (const auto &entry : base)
+    {
+        if (entry.second != R_AMBIGOUS)
+            known[entry.first] = entry.second == R_TRUE;
+    }
+    std::vector<int8_t> values;
+    TruthTable rest;
+    bool clamped = propagate(known, values);
+    if (clamped)
+    {
+        rest = residual(tables, values);
+        clamped = rest.hasValidState();
+    }
+    if (!clamped)
+    {
+        // the rule-based values are kept as they are, provided the facts have a state
+        if (!propagate(fact_values, values) || !residual(tables, values).hasValidState())
+            return false;
+    }
+    else
+    {
+        StateIndex index(rest);
+        for (symbol_t q : queries)
+        {
+            int i = symbol_index[q];
+            if (i < 0)
+                continue;
+            if (values[i] != -1)
+                base[q] = values[i] ? R_TRUE : R_FALSE;
+            else
+                base[q] = index.clampValue(index.all(), q, base[q]);
+        }
+    }
+
+    results.clear();
+    for (symbol_t q : queries)
+        results[q] = resolver.queryResult(base, q);
+    return true;
+}
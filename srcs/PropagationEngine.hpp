@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include "Engine.hpp"
+#include "TruthTable.hpp"
+
+/**
+ * Unit propagation pre-pass: the per-rule tables are compiled once into
+ * clauses (one per forbidden assignment) and the known values are
+ * propagated with two watched literals. Every forced symbol is fixed from
+ * the trail; only the tables still holding unforced symbols are restricted
+ * and joined to clamp the rest.
+ **/
+class PropagationEngine : public Engine
+{
+public:
+    PropagationEngine();
+
+    const char *name() const override { return "propagation"; }
+    bool solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+               std::map<symbol_t, rhr_value_e> &results) override;
+    bool needsCombinedTable() const override { return false; }
+
+private:
+    /** 2 * symbol index, plus 1 when negated */
+    typedef int Literal;
+
+    /** parser the clauses were compiled from, compiled once */
+    const Parser *compiled;
+    std::vector<symbol_t> symbols;
+    SymbolArray<int> symbol_index;
+    std::vector<std::vector<Literal>> clauses;
+    /** clauses watching each literal, kept across runs as watches need no undo */
+    std::vector<std::vector<size_t>> watches;
+    /** literals of the single-literal clauses */
+    std::vector<Literal> units;
+    /** a rule table without valid state */
+    bool contradiction;
+
+    void compile(Parser &parser);
+    /**
+     * Assign the known values then propagate; values holds -1 for the
+     * unforced symbols. Return false on a conflict.
+     **/
+    bool propagate(const std::map<symbol_t, bool> &known, std::vector<int8_t> &values);
+    /**
+     * Join the rule tables still holding an unforced symbol, restricted to
+     * the forced values and without the forced symbols.
+     **/
+    TruthTable residual(const std::vector<TruthTable> &tables, const std::vector<int8_t> &values) const;
+};
@@ -0,0 +1,225 @@
+#include "QueryProtocol.hpp"
+#include "Parser.hpp"
+#include "Resolver.hpp"
+#include "ResultCache.hpp"
+#include <algorithm>
+#include <sstream>
+
+bool QueryProtocol::parseSymbols(const std::string &field, std::set<symbol_t> &symbols, std::string &error)
+{
+    symbols.clear();
+    // fields are split on spaces, named symbols are set apart by commas instead
+    std::string list = field.substr(1);
+    std::replace(list.begin(), list.end(), ',', ' ');
+    std::vector<symbol_t> parsed;
+    std::string bad;
+    // a name the knowledge base never used cannot be set or proven, and clients must not grow the table
+    if (!SymbolTable::parseList(list, parsed, bad, false))
+    {
+        error = "invalid symbol: " + bad;
+        return false;
+    }
+    symbols.insert(parsed.begin(), parsed.end());
+    return true;
+}
+
+template <class T>
+bool QueryProtocol::parseLimit(const std::string &field, size_t name_length, T unit, T &limit, std::string &error)
+{
+    std::string value = field.substr(name_length);
+    if (value.empty() || value.size() > 9 || value.find_first_not_of("0123456789") != std::string::npos)
+    {
+        error = "invalid limit: " + field;
+        return false;
+    }
+    limit = static_cast<T>(std::stoull(value)) * unit;
+    return true;
+}
+
+bool QueryProtocol::parseRequest(const std::string &line, QueryRequest &request, std::string &error)
+{
+    std::istringstream iss(line);
+    std::string field;
+    request = QueryRequest();
+    while (iss >> field)
+    {
+        if (field[0] == '=')
+        {
+            request.has_facts = true;
+            if (!parseSymbols(field, request.facts, error))
+                return false;
+        }
+        else if (field[0] == '?')
+        {
+            request.has_queries = true;
+            if (!parseSymbols(field, request.queries, error))
+                return false;
+        }
+        else if (field == "explain")
+            request.explain = true;
+        else if (field.compare(0, 3, "id=") == 0)
+            request.id = field.substr(3);
+        else if (field.compare(0, 11, "timeout_ms=") == 0)
+        {
+            if (!parseLimit<uint64_t>(field, 11, 1, request.limits.timeout_ms, error))
+                return false;
+        }
+        else if (field.compare(0, 14, "max_memory_mb=") == 0)
+        {
+            if (!parseLimit<size_t>(field, 14, 1 << 20, request.limits.max_memory_bytes, error))
+                return false;
+        }
+        else
+        {
+            error = "unknown field: " + field;
+            return false;
+        }
+    }
+    return true;
+}
+
+QueryReply QueryProtocol::answer(Parser &parser, const QueryRequest &request, ResultCache *cache)
+{
+    static const char NO_VALID_STATE[] = "no valid states with the given initial facts";
+    QueryReply reply;
+    reply.id = request.id;
+    RequestBudget budget(request.limits);
+
+    const std::set<symbol_t> &facts = request.has_facts ? request.facts : parser.getInitialFact();
+    const std::set<symbol_t> &queries = request.has_queries ? request.queries : parser.getQuerie();
+    // explanations are not cached, they are the whole proof
+    if (request.explain)
+        cache = nullptr;
+    ResultCache::Key key(parser.getVersion(), facts, queries);
+    ResultCache::Answer cached;
+    if (cache && cache->lookup(key, cached))
+    {
+        reply.ok = cached.ok;
+        if (!reply.ok)
+            reply.error = NO_VALID_STATE;
+        reply.results.swap(cached.results);
+        return reply;
+    }
+    if (!parser.hasValidStateWithFacts(facts))
+    {
+        reply.ok = false;
+        reply.error = NO_VALID_STATE;
+        if (cache)
+        {
+            cached.ok = false;
+            cache->insert(key, cached);
+        }
+        return reply;
+    }
+
+    Resolver resolver(queries, parser.getBasicRules(), facts, parser.getCombinedTruthTable());
+    resolver.getReasoning().setEnabled(request.explain);
+    if (request.limits.isLimited())
+        resolver.setRequestBudget(&budget);
+    std::map<symbol_t, rhr_value_e> results = resolver.evaluate();
+
+    std::ostringstream explain;
+    for (symbol_t q : queries)
+    {
+        reply.results.emplace_back(q, resolver.queryResult(results, q));
+        if (request.explain)
+            resolver.explain(q, explain);
+    }
+    reply.explain = explain.str();
+    if (resolver.isPartial())
+        reply.partial = budget.reasonName();
+    // a partial answer depends on the load of the moment
+    else if (cache)
+    {
+        cached.results = reply.results;
+        cache->insert(key, cached);
+    }
+    return reply;
+}
+
+QueryReply QueryProtocol::answerLine(Parser &parser, const std::string &line, const std::string &default_id,
+                                     ResultCache *cache, const RequestBudget::Limits &limits)
+{
+    QueryRequest request;
+    std::string error;
+    bool parsed = parseRequest(line, request, error);
+    if (request.id.empty())
+        request.id = default_id;
+    if (!parsed)
+    {
+        QueryReply reply;
+        reply.id = request.id;
+        reply.ok = false;
+        reply.error = error;
+        return reply;
+    }
+    request.limits = limits.tighten(request.limits);
+    return answer(parser, request, cache);
+}
+
+void QueryProtocol::appendJsonString(const std::string &s, std::string &out)
+{
+    out.push_back('"');
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out.push_back('\\');
+            out.push_back(c);
+        }
+        else if (c == '\n')
+            out += "\\n";
+        else if (c == '\t')
+            out += "\\t";
+        else if (c == '\r')
+            out += "\\r";
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            static const char hex[] = "0123456789abcdef";
+            out += "\\u00";
+            out.push_back(hex[c >> 4]);
+            out.push_back(hex[c & 0xf]);
+        }
+        else
+            out.push_back(c);
+    }
+    out.push_back('"');
+}
+
+void QueryProtocol::formatReply(const QueryReply &reply, std::string &out)
+{
+    out += "{\"id\":";
+    appendJsonString(reply.id, out);
+    if (!reply.ok)
+    {
+        out += ",\"ok\":false,\"error\":";
+        appendJsonString(reply.error, out);
+        out += "}\n";
+        return;
+    }
+    out += ",\"ok\":true";
+    if (!reply.partial.empty())
+    {
+        out += ",\"partial\":";
+        appendJsonString(reply.partial, out);
+    }
+    out += ",\"results\":{";
+    for (size_t i = 0; i < reply.results.size(); ++i)
+    {
+        if (i != 0)
+            out.push_back(',');
+        out.push_back('"');
+        out += SymbolTable::name(reply.results[i].first);
+        out += "\":\"";
+        rhr_value_e value = reply.results[i].second;
+        out += (value == R_TRUE ? "true" : value == R_FALSE ? "false" : "ambiguous");
+        out.push_back('"');
+    }
+    out.push_back('}');
+    if (!reply.explain.empty())
+    {
+        out += ",\"explain\":";
+        appendJsonString(reply.explain, out);
+    }
+    out += "}\n";
+}
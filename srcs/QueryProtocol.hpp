@@ -0,0 +1,88 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ReasoningTypes.hpp"
+#include "RequestBudget.hpp"
+
+class Parser;
+class ResultCache;
+
+/**
+ * One query request of the line protocol used by --serve.
+ * A request line is made of whitespace separated fields:
+ *   =ABC      initial facts (default: the facts of the loaded file)
+ *   ?XY       queries (default: the queries of the loaded file)
+ *   explain   add the --explain text to the reply
+ *   id=<tag>  opaque tag echoed in the reply
+ *   timeout_ms=<n> / max_memory_mb=<n>
+ *             budget of the request, never above the server's own
+ * Named symbols are separated by commas (=A,pump_on) and must appear in
+ * the loaded knowledge base.
+ **/
+struct QueryRequest
+{
+    std::string id;
+    bool has_facts = false;
+    std::set<symbol_t> facts;
+    bool has_queries = false;
+    std::set<symbol_t> queries;
+    bool explain = false;
+    RequestBudget::Limits limits;
+};
+
+/**
+ * Answer to a QueryRequest, rendered as one JSON object per line:
+ *   {"id":"7","ok":true,"results":{"A":"true"},"explain":"..."}
+ *   {"id":"7","ok":false,"error":"..."}
+ * A request out of budget is answered with what was resolved, the rest
+ * ambiguous, and the reason: {"id":"7","ok":true,"partial":"timeout",...}
+ **/
+struct QueryReply
+{
+    std::string id;
+    bool ok = true;
+    std::string error;
+    std::vector<std::pair<symbol_t, rhr_value_e>> results;
+    std::string explain;
+    /** RequestBudget::reasonName of an answer out of budget, empty when complete */
+    std::string partial;
+};
+
+/**
+ * Parse, answer and format line protocol requests against a loaded knowledge base.
+ **/
+class QueryProtocol
+{
+public:
+    /**
+     * parse a request line, return false and set error on bad input.
+     **/
+    static bool parseRequest(const std::string &line, QueryRequest &request, std::string &error);
+    /**
+     * evaluate a request with a fresh resolver. Only reads the parser, so it can
+     * be called concurrently on the same parser. Requests without explain are
+     * answered from cache when one is given, and stored in it on a miss
+     * unless the answer is partial.
+     **/
+    static QueryReply answer(Parser &parser, const QueryRequest &request, ResultCache *cache = nullptr);
+    /**
+     * parse and answer a raw line, default_id is used when the line has no id= field.
+     * The budget fields of the line can only tighten limits.
+     **/
+    static QueryReply answerLine(Parser &parser, const std::string &line, const std::string &default_id = std::string(),
+                                 ResultCache *cache = nullptr, const RequestBudget::Limits &limits = RequestBudget::Limits());
+    /**
+     * append the JSON line of a reply (with its trailing newline) to out.
+     **/
+    static void formatReply(const QueryReply &reply, std::string &out);
+
+private:
+    static bool parseSymbols(const std::string &field, std::set<symbol_t> &symbols, std::string &error);
+    /** value of a name=<n> field, scaled by unit */
+    template <class T>
+    static bool parseLimit(const std::string &field, size_t name_length, T unit, T &limit, std::string &error);
+    static void appendJsonString(const std::string &s, std::string &out);
+};
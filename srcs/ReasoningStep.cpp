@@ -1,9 +1,10 @@
 #include "ReasoningStep.hpp"
 #include "LogicRule.hpp"
+#include "MemoryAccounting.hpp"
+#include "TraceWriter.hpp"
 #include <iostream>
-#include <sstream>
 
-ReasoningStep::ReasoningStep() : capture_trace(false)
+ReasoningStep::ReasoningStep() : nodes(NODE_COUNT), sink(nullptr), capture_trace(false)
 {
 }
 
@@ -21,179 +22,258 @@ bool ReasoningStep::isEnabled() const
     return capture_trace;
 }
 
+void ReasoningStep::setSink(TraceWriter *writer)
+{
+    sink = writer;
+}
+
+bool ReasoningStep::isRecording() const
+{
+    return capture_trace || sink;
+}
+
+size_t ReasoningStep::memoryBytes() const
+{
+    return MemoryAccounting::vectorBytes(nodes) + MemoryAccounting::vectorBytes(edges)
+        + MemoryAccounting::vectorBytes(blocking_pool) + MemoryAccounting::vectorBytes(touched);
+}
+
 void ReasoningStep::reset()
 {
-    traces.clear();
+    for (symbol_t q : touched)
+        nodes[q] = ProofNode();
+    touched.clear();
+    edges.clear();
+    blocking_pool.clear();
 }
 
-void ReasoningStep::recordInitialFact(char q)
+ReasoningStep::ProofNode &ReasoningStep::node(symbol_t q)
 {
+    if (q >= nodes.size())
+        nodes.resize(q + 1);
+    ProofNode &n = nodes[q];
+    if (!n.recorded)
+    {
+        n.recorded = true;
+        touched.push_back(q);
+    }
+    return n;
+}
+
+const ReasoningStep::ProofNode *ReasoningStep::findNode(symbol_t q) const
+{
+    if (q >= nodes.size())
+        return nullptr;
+    const ProofNode &n = nodes[q];
+    return n.recorded ? &n : nullptr;
+}
+
+void ReasoningStep::recordRunStart()
+{
+    if (sink)
+        sink->writeRunStart();
+}
+
+void ReasoningStep::recordGoal(symbol_t q)
+{
+    if (sink)
+        sink->writeGoal(q);
+}
+
+void ReasoningStep::recordInitialFact(symbol_t q)
+{
+    if (sink)
+        sink->writeInitialFact(q);
     if (!capture_trace)
         return;
-    if (traces.find(q) != traces.end())
+    if (findNode(q))
         return;
-    traces[q].was_initial_fact = true;
-    traces[q].prove_result = R_TRUE;
+    ProofNode &n = node(q);
+    n.was_initial_fact = true;
+    n.prove_result = R_TRUE;
 }
 
-void ReasoningStep::recordRuleEvaluation(char q, const BasicRule* rule, RuleStatus status,
-                                          const std::set<char> &blocking_vars, char cycle_var)
+void ReasoningStep::recordRuleEvaluation(symbol_t q, uint32_t rule_id, RuleStatus status,
+                                          const std::vector<symbol_t> &blocking_vars, symbol_t cycle_var)
 {
+    if (sink)
+        sink->writeRuleEvaluation(q, rule_id, status, blocking_vars, cycle_var);
     if (!capture_trace)
         return;
-    auto it = traces.find(q);
-    if (it != traces.end() && it->second.trace_complete)
+    ProofNode &n = node(q);
+    if (n.trace_complete)
         return;
-    traces[q].rule_evals.push_back({rule, status, blocking_vars, cycle_var});
+
+    ProofEdge edge;
+    edge.rule_id = rule_id;
+    edge.blocking_begin = static_cast<uint32_t>(blocking_pool.size());
+    edge.blocking_count = static_cast<uint16_t>(blocking_vars.size());
+    edge.status = status;
+    edge.cycle_var = cycle_var;
+    edge.next = -1;
+    blocking_pool.insert(blocking_pool.end(), blocking_vars.begin(), blocking_vars.end());
+
+    int32_t index = static_cast<int32_t>(edges.size());
+    edges.push_back(edge);
+    if (n.last_edge >= 0)
+        edges[n.last_edge].next = index;
+    else
+        n.first_edge = index;
+    n.last_edge = index;
 }
 
-void ReasoningStep::recordProveResult(char q, rhr_value_e result)
+void ReasoningStep::recordProveResult(symbol_t q, rhr_value_e result)
 {
+    if (sink)
+        sink->writeProveResult(q, result);
     if (!capture_trace)
         return;
-    auto it = traces.find(q);
-    if (it != traces.end() && it->second.trace_complete)
+    ProofNode &n = node(q);
+    if (n.trace_complete)
         return;
-    traces[q].prove_result = result;
-    traces[q].trace_complete = true;
+    n.prove_result = result;
+    n.trace_complete = true;
 }
 
-void ReasoningStep::recordTruthTableClamp(char q, rhr_value_e before, rhr_value_e after,
-                                           const std::string &reason)
+void ReasoningStep::recordTruthTableClamp(symbol_t q, rhr_value_e before, rhr_value_e after)
 {
+    if (sink)
+        sink->writeClamp(q, before, after);
     if (!capture_trace)
         return;
-    traces[q].was_clamped = true;
-    traces[q].clamped_from = before;
-    traces[q].clamped_to = after;
-    traces[q].clamp_reason = reason;
+    ProofNode &n = node(q);
+    n.was_clamped = true;
+    n.clamped_from = before;
+    n.clamped_to = after;
+    if (before == R_AMBIGOUS && after == R_TRUE)
+        n.clamp_reason = ClampReason::FORCED_TRUE;
+    else if (before == R_AMBIGOUS && after == R_FALSE)
+        n.clamp_reason = ClampReason::FORCED_FALSE;
+    else
+        n.clamp_reason = ClampReason::FORCED_OTHER;
+}
+
+void ReasoningStep::formatBlockingVars(const ProofEdge &edge, std::ostream &os) const
+{
+    for (uint32_t i = 0; i < edge.blocking_count; ++i)
+    {
+        if (i != 0)
+            os << ", ";
+        os << SymbolTable::name(blocking_pool[edge.blocking_begin + i]);
+    }
 }
 
-std::string ReasoningStep::formatRuleEvaluation(char q, const RuleEvaluation &eval) const
+void ReasoningStep::formatRuleEvaluation(symbol_t q, const ProofEdge &edge, const std::vector<BasicRule> &rules, std::ostream &os) const
 {
-    std::ostringstream oss;
-    std::string rule_str = eval.rule->toString();
+    const BasicRule &rule = rules[edge.rule_id];
+
+    os << rule;
+    if (rule.origin)
+        os << " (from: " << *rule.origin << ")";
 
-    if (eval.rule->origin)
-        rule_str += " (from: " + eval.rule->origin->toString() + ")";
-    
-    switch (eval.status)
+    switch (edge.status)
     {
         case RuleStatus::FIRED_TRUE:
-            oss << rule_str << " shows " << q << " true";
+            os << " shows " << SymbolTable::name(q) << " true";
             break;
         case RuleStatus::FIRED_FALSE:
-            oss << rule_str << " shows " << q << " false";
+            os << " shows " << SymbolTable::name(q) << " false";
             break;
         case RuleStatus::NOT_FIRED:
-            oss << rule_str << " did not fire (";
-            if (!eval.blocking_vars.empty())
+            os << " did not fire (";
+            if (edge.blocking_count != 0)
             {
-                bool first = true;
-                for (char var : eval.blocking_vars)
-                {
-                    if (!first) oss << ", ";
-                    oss << var;
-                    first = false;
-                }
-                oss << " false)";
+                formatBlockingVars(edge, os);
+                os << " false)";
             }
             else
             {
-                oss << "LHS false)";
+                os << "LHS false)";
             }
             break;
         case RuleStatus::AMBIGUOUS_CYCLE:
-            oss << rule_str << " could show " << q 
-                << (eval.rule->rhs_negated ? " false" : " true")
-                << " but " << eval.cycle_var << " creates a cycle";
+            os << " could show " << SymbolTable::name(q)
+               << (rule.rhs_negated ? " false" : " true")
+               << " but " << SymbolTable::name(edge.cycle_var) << " creates a cycle";
             break;
         case RuleStatus::AMBIGUOUS_DEPENDS:
-            oss << rule_str << " could show " << q 
-                << (eval.rule->rhs_negated ? " false" : " true")
-                << " but ";
-            {
-                bool first = true;
-                for (char var : eval.blocking_vars)
-                {
-                    if (!first) oss << ", ";
-                    oss << var;
-                    first = false;
-                }
-            }
-            oss << " is undetermined";
+            os << " could show " << SymbolTable::name(q)
+               << (rule.rhs_negated ? " false" : " true")
+               << " but ";
+            formatBlockingVars(edge, os);
+            os << " is undetermined";
             break;
     }
-    
-    return oss.str();
 }
 
-std::string ReasoningStep::formatConclusion(char q, const SymbolTrace &trace) const
+void ReasoningStep::formatConclusion(symbol_t q, const ProofNode &trace, std::ostream &os) const
 {
-    std::ostringstream oss;
-    
     if (trace.was_clamped && trace.clamped_from != trace.clamped_to)
     {
-        oss << trace.clamp_reason << "\n";
+        switch (trace.clamp_reason)
+        {
+            case ClampReason::FORCED_TRUE:
+                os << "All cases require " << SymbolTable::name(q) << " to be true\n";
+                break;
+            case ClampReason::FORCED_FALSE:
+                os << "All cases require " << SymbolTable::name(q) << " to be false\n";
+                break;
+            default:
+                os << "Truth table constraint forces " << SymbolTable::name(q) << " to a definite value\n";
+                break;
+        }
     }
-    
-    std::string result_str;
+
     rhr_value_e final_result = trace.was_clamped ? trace.clamped_to : trace.prove_result;
-    
+    os << SymbolTable::name(q) << " is ";
     switch (final_result)
     {
-        case R_TRUE: result_str = "true"; break;
-        case R_FALSE: result_str = "false"; break;
-        case R_AMBIGOUS: result_str = "ambiguous"; break;
+        case R_TRUE: os << "true"; break;
+        case R_FALSE: os << "false"; break;
+        case R_AMBIGOUS: os << "ambiguous"; break;
     }
-    
-    oss << q << " is " << result_str;
-    return oss.str();
 }
 
-void ReasoningStep::printTrace(char q, std::ostream &os) const
+void ReasoningStep::printTrace(symbol_t q, const std::vector<BasicRule> &rules, std::ostream &os) const
 {
-    os << "=== Reasoning for " << q << " ===\n";
-    
-    auto it = traces.find(q);
-    if (it == traces.end())
+    os << "=== Reasoning for " << SymbolTable::name(q) << " ===\n";
+
+    const ProofNode *trace = findNode(q);
+    if (!trace)
     {
-        os << "No rules apply to " << q << ", false by default.\n";
-        os << q << " is false\n";
+        os << "No rules apply to " << SymbolTable::name(q) << ", false by default.\n";
+        os << SymbolTable::name(q) << " is false\n";
         return;
     }
-    
-    const SymbolTrace &trace = it->second;
-    if (trace.was_initial_fact)
+
+    if (trace->was_initial_fact)
     {
-        os << q << " is given as an initial fact.\n";
-        os << q << " is true\n";
+        os << SymbolTable::name(q) << " is given as an initial fact.\n";
+        os << SymbolTable::name(q) << " is true\n";
         return;
     }
 
-    bool has_any_rule = false;
-    for (const auto &eval : trace.rule_evals)
+    if (trace->first_edge < 0)
+        os << "No rules target " << SymbolTable::name(q) << ", false by default.\n";
+    for (int32_t i = trace->first_edge; i >= 0; i = edges[i].next)
     {
-        os << formatRuleEvaluation(q, eval) << "\n";
-        has_any_rule = true;
-    }
-    if (!has_any_rule)
-    {
-        os << "No rules target " << q << ", false by default.\n";
+        formatRuleEvaluation(q, edges[i], rules, os);
+        os << "\n";
     }
-    os << formatConclusion(q, trace) << "\n";
+    formatConclusion(q, *trace, os);
+    os << "\n";
 }
 
-void ReasoningStep::printInitialFacts(const std::set<char> &initial_facts, std::ostream &os) const
+void ReasoningStep::printInitialFacts(const std::set<symbol_t> &initial_facts, std::ostream &os) const
 {
     if (!initial_facts.empty())
     {
         os << "Initial facts: ";
         bool first = true;
-        for (char fact : initial_facts)
+        for (symbol_t fact : initial_facts)
         {
             if (!first) os << ", ";
-            os << fact;
+            os << SymbolTable::name(fact);
             first = false;
         }
         os << "\n";
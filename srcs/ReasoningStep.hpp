@@ -4,29 +4,44 @@
 #include <string>
 #include <vector>
 #include <ostream>
-#include <map>
+#include <cstdint>
 #include "BasicRule.hpp"
 #include "ReasoningTypes.hpp"
 
-enum class RuleStatus
+class TraceWriter;
+
+/**
+ * Why the truth table changed the value found by the rules.
+ **/
+enum class ClampReason : uint8_t
 {
-    FIRED_TRUE,
-    FIRED_FALSE,
-    NOT_FIRED,
-    AMBIGUOUS_CYCLE,
-    AMBIGUOUS_DEPENDS
+    NONE,
+    FORCED_TRUE,
+    FORCED_FALSE,
+    FORCED_OTHER
 };
 
-struct RuleEvaluation
+/**
+ * One rule evaluation while proving a symbol (edge of the proof DAG).
+ * Blocking variables are children of the edge and live in a shared pool.
+ **/
+struct ProofEdge
 {
-    const BasicRule* rule;
+    /** index of the rule in the resolver rule vector */
+    uint32_t rule_id;
+    /** first blocking variable in the shared pool */
+    uint32_t blocking_begin;
+    /** number of blocking variables */
+    uint16_t blocking_count;
     RuleStatus status;
-    std::set<char> blocking_vars;  // Variables that caused ambiguity
-    char cycle_var;                // If AMBIGUOUS_CYCLE, which var caused it
+    /** If AMBIGUOUS_CYCLE, which var caused it */
+    symbol_t cycle_var;
+    /** next edge recorded for the same symbol, -1 at the end */
+    int32_t next;
 };
 
 /**
- * Collects and prints explanation traces for the resolver.
+ * Collects the proof DAG of a resolution and renders it on demand.
  **/
 class ReasoningStep
 {
@@ -36,48 +51,81 @@ public:
 
     void setEnabled(bool enabled);
     bool isEnabled() const;
+    /**
+     * Stream every recorded event to a trace writer (nullptr to stop).
+     **/
+    void setSink(TraceWriter *writer);
+    /**
+     * Whether events are wanted, either for --explain or for a sink.
+     **/
+    bool isRecording() const;
+    /**
+     * Estimated heap bytes held by the recorded proof DAG.
+     **/
+    size_t memoryBytes() const;
     void reset();
-    
+
     // Record different events
-    void recordInitialFact(char q);
-    
+    void recordRunStart();
+    void recordGoal(symbol_t q);
+    void recordInitialFact(symbol_t q);
+
     /**
      * Record a rule evaluation with its full status
      **/
-    void recordRuleEvaluation(char q, const BasicRule* rule, RuleStatus status,
-                              const std::set<char> &blocking_vars = {},
-                              char cycle_var = 0);
-    
+    void recordRuleEvaluation(symbol_t q, uint32_t rule_id, RuleStatus status,
+                              const std::vector<symbol_t> &blocking_vars = {},
+                              symbol_t cycle_var = 0);
+
     /**
      * Record the final outcome after prove() completes
      **/
-    void recordProveResult(char q, rhr_value_e result);
-    
+    void recordProveResult(symbol_t q, rhr_value_e result);
+
     /**
      * Record when truth table clamping changes a result
      **/
-    void recordTruthTableClamp(char q, rhr_value_e before, rhr_value_e after,
-                               const std::string &reason);
-    
-    void printTrace(char q, std::ostream &os) const;
-    void printInitialFacts(const std::set<char> &initial_facts, std::ostream &os) const;
+    void recordTruthTableClamp(symbol_t q, rhr_value_e before, rhr_value_e after);
+
+    /**
+     * Render the trace of a symbol. Rule ids are resolved against rules.
+     **/
+    void printTrace(symbol_t q, const std::vector<BasicRule> &rules, std::ostream &os) const;
+    void printInitialFacts(const std::set<symbol_t> &initial_facts, std::ostream &os) const;
 
 private:
-    struct SymbolTrace
+    /**
+     * Per-symbol node of the proof DAG, indexed by the symbol itself.
+     **/
+    struct ProofNode
     {
-        std::vector<RuleEvaluation> rule_evals;
+        int32_t first_edge = -1;
+        int32_t last_edge = -1;
         rhr_value_e prove_result = R_FALSE;
-        bool was_initial_fact = false;
-        bool was_clamped = false;
         rhr_value_e clamped_from = R_FALSE;
         rhr_value_e clamped_to = R_FALSE;
-        std::string clamp_reason;
+        ClampReason clamp_reason = ClampReason::NONE;
+        bool recorded = false;
+        bool was_initial_fact = false;
+        bool was_clamped = false;
         bool trace_complete = false;
     };
-    
-    std::map<char, SymbolTrace> traces;
+
+    /** nodes for every single-letter symbol, grown for named ones */
+    static const size_t NODE_COUNT = SymbolTable::FIRST_NAMED;
+
+    /** indexed by symbol code */
+    std::vector<ProofNode> nodes;
+    std::vector<ProofEdge> edges;
+    std::vector<symbol_t> blocking_pool;
+    /** symbols whose node was written since the last reset */
+    std::vector<symbol_t> touched;
+    TraceWriter *sink;
     bool capture_trace;
-    
-    std::string formatRuleEvaluation(char q, const RuleEvaluation &eval) const;
-    std::string formatConclusion(char q, const SymbolTrace &trace) const;
+
+    ProofNode &node(symbol_t q);
+    const ProofNode *findNode(symbol_t q) const;
+    void formatRuleEvaluation(symbol_t q, const ProofEdge &edge, const std::vector<BasicRule> &rules, std::ostream &os) const;
+    void formatBlockingVars(const ProofEdge &edge, std::ostream &os) const;
+    void formatConclusion(symbol_t q, const ProofNode &trace, std::ostream &os) const;
 };
@@ -1,8 +1,55 @@
 #pragma once
 
+#include <cstdint>
+#include "SymbolTable.hpp"
+
 enum rhr_value_e
 {
 	R_FALSE,
 	R_AMBIGOUS,
 	R_TRUE
 };
+
+/** three-valued connectives: an ambiguous operand decides nothing it could flip */
+inline rhr_value_e resolveNot(rhr_value_e v)
+{
+	if (v == R_TRUE)
+		return R_FALSE;
+	if (v == R_FALSE)
+		return R_TRUE;
+	return R_AMBIGOUS;
+}
+
+inline rhr_value_e resolveAnd(rhr_value_e a, rhr_value_e b)
+{
+	if (a == R_FALSE || b == R_FALSE)
+		return R_FALSE;
+	if (a == R_TRUE && b == R_TRUE)
+		return R_TRUE;
+	return R_AMBIGOUS;
+}
+
+inline rhr_value_e resolveOr(rhr_value_e a, rhr_value_e b)
+{
+	if (a == R_TRUE || b == R_TRUE)
+		return R_TRUE;
+	if (a == R_FALSE && b == R_FALSE)
+		return R_FALSE;
+	return R_AMBIGOUS;
+}
+
+inline rhr_value_e resolveXor(rhr_value_e a, rhr_value_e b)
+{
+	if (a == R_AMBIGOUS || b == R_AMBIGOUS)
+		return R_AMBIGOUS;
+	return (a != b) ? R_TRUE : R_FALSE;
+}
+
+enum class RuleStatus : uint8_t
+{
+	FIRED_TRUE,
+	FIRED_FALSE,
+	NOT_FIRED,
+	AMBIGUOUS_CYCLE,
+	AMBIGUOUS_DEPENDS
+};
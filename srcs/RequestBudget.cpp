@@ -0,0 +1,70 @@
+#include "RequestBudget.hpp"
+#include <algorithm>
+
+bool RequestBudget::Limits::isLimited() const
+{
+    return timeout_ms != 0 || max_memory_bytes != 0;
+}
+
+/** the smaller limit, 0 standing for unlimited */
+template <class T>
+static T tighter(T a, T b)
+{
+    if (!a || !b)
+        return a ? a : b;
+    return std::min(a, b);
+}
+
+RequestBudget::Limits RequestBudget::Limits::tighten(const Limits &other) const
+{
+    Limits limits;
+    limits.timeout_ms = tighter(timeout_ms, other.timeout_ms);
+    limits.max_memory_bytes = tighter(max_memory_bytes, other.max_memory_bytes);
+    return limits;
+}
+
+RequestBudget::RequestBudget(const Limits &limits) : limits(limits), countdown(POLL_INTERVAL), reason(NONE)
+{
+    start();
+}
+
+void RequestBudget::start()
+{
+    deadline = Clock::now() + std::chrono::milliseconds(limits.timeout_ms);
+    countdown = POLL_INTERVAL;
+    reason.store(NONE, std::memory_order_relaxed);
+}
+
+void RequestBudget::exhaust(Reason why)
+{
+    // the first reason found is kept
+    int none = NONE;
+    reason.compare_exchange_strong(none, why, std::memory_order_relaxed);
+}
+
+bool RequestBudget::check()
+{
+    if (isExhausted())
+        return true;
+    if (limits.timeout_ms && Clock::now() >= deadline)
+        exhaust(TIMEOUT);
+    return isExhausted();
+}
+
+bool RequestBudget::charge(size_t bytes)
+{
+    if (limits.max_memory_bytes && bytes > limits.max_memory_bytes)
+        exhaust(MEMORY);
+    return isExhausted();
+}
+
+const char *RequestBudget::reasonName() const
+{
+    switch (getReason())
+    {
+        case TIMEOUT: return "timeout";
+        case MEMORY: return "memory";
+        case NONE: break;
+    }
+    return "";
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Time and memory allowed to one request: a run of the CLI, a line of the
+ * daemon and pipe modes, an expert_resolve. The long loops check it
+ * cooperatively (LogicRule::deduceBasics, TruthTable::conjunction and
+ * conjunctionAll, Resolver::prove) and stop early once it is exhausted,
+ * leaving what they did not finish unresolved.
+ *
+ * poll() only reads the clock every POLL_INTERVAL calls. Memory is charged
+ * as the estimated bytes (see MemoryAccounting) of the structure being
+ * built, not as the process footprint. Once exhausted the budget stays
+ * exhausted until start() is called again; check() and charge() may be
+ * called from several threads, poll() only from one.
+ **/
+class RequestBudget
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /** a limit of 0 means unlimited */
+    struct Limits
+    {
+        uint64_t timeout_ms;
+        size_t max_memory_bytes;
+
+        Limits() : timeout_ms(0), max_memory_bytes(0) {}
+        bool isLimited() const;
+        /** the tighter of both limits, field by field */
+        Limits tighten(const Limits &other) const;
+    };
+
+    enum Reason
+    {
+        NONE,
+        TIMEOUT,
+        MEMORY
+    };
+
+    static const unsigned int POLL_INTERVAL = 256;
+
+    explicit RequestBudget(const Limits &limits = Limits());
+
+    const Limits &getLimits() const { return limits; }
+    /** start the clock, forgetting a previous exhaustion */
+    void start();
+    /** true once exhausted, reading the clock every POLL_INTERVAL calls */
+    bool poll()
+    {
+        if (--countdown != 0)
+            return isExhausted();
+        countdown = POLL_INTERVAL;
+        return check();
+    }
+    /** true once exhausted, reading the clock now */
+    bool check();
+    /** true once exhausted, bytes being held by the structure being built */
+    bool charge(size_t bytes);
+    bool isExhausted() const { return reason.load(std::memory_order_relaxed) != NONE; }
+    Reason getReason() const { return static_cast<Reason>(reason.load(std::memory_order_relaxed)); }
+    /** "timeout" or "memory", empty while not exhausted */
+    const char *reasonName() const;
+
+private:
+    Limits limits;
+    Clock::time_point deadline;
+    unsigned int countdown;
+    std::atomic<int> reason;
+
+    void exhaust(Reason why);
+};
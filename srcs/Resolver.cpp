@@ -1,59 +1,108 @@
 #include "Resolver.hpp"
 #include "LogicRule.hpp"
+#include "MemoryAccounting.hpp"
+#include "Timeline.hpp"
+#include "TwoSat.hpp"
+#include "WorkStealingPool.hpp"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <stdexcept>
 
-Resolver::Resolver(std::set<char> querie, std::vector<BasicRule> &basic_rules, std::set<char> initial_facts, const TruthTable &truth_table)
+Resolver::Resolver(std::set<symbol_t> querie, std::vector<BasicRule> &basic_rules, std::set<symbol_t> initial_facts, const TruthTable &truth_table)
     : querie(querie),
       basic_rules(basic_rules),
       initial_facts(initial_facts),
       truth_table(truth_table),
-      reasoning()
+      reasoning(),
+      symbol_ids(-1),
+      generation(1),
+      stats(nullptr),
+      profiler(nullptr),
+      prove_depth(0),
+      programs(basic_rules.size()),
+      prove_threads(1),
+      budget(nullptr),
+      partial(false)
 {
+    internSymbols();
 }
 
 Resolver::~Resolver()
 {
 }
-static rhr_value_e resolveNot(rhr_value_e v)
+
+int Resolver::internSymbol(symbol_t q)
 {
-    if (v == R_TRUE)
-        return R_FALSE;
-    if (v == R_FALSE)
-        return R_TRUE;
-    return R_AMBIGOUS;
+    int &id = symbol_ids.at(q);
+    if (id >= 0)
+        return id;
+    id = symbols.size();
+    symbols.push_back(q);
+    rules_by_symbol.emplace_back();
+    fact_flags.push_back(initial_facts.count(q) != 0);
+    memo_values.push_back(R_FALSE);
+    memo_generation.push_back(0);
+    visiting_negated.push_back(0);
+    visiting_generation.push_back(0);
+    settled.push_back(0);
+    return id;
 }
 
-static rhr_value_e resolveAnd(rhr_value_e a, rhr_value_e b)
+void Resolver::internSymbols()
 {
-    if (a == R_FALSE || b == R_FALSE)
-        return R_FALSE;
-    if (a == R_TRUE && b == R_TRUE)
-        return R_TRUE;
-    return R_AMBIGOUS;
+    for (size_t rule_id = 0; rule_id < basic_rules.size(); ++rule_id)
+    {
+        const BasicRule &rule = basic_rules[rule_id];
+        rules_by_symbol[internSymbol(rule.rhs_symbol)].push_back(static_cast<uint32_t>(rule_id));
+        for (const TokenBlock &block : rule.lhs)
+        {
+            for (const TokenEffect &tk : block)
+            {
+                if (SymbolTable::isSymbol(tk.type))
+                    internSymbol(tk.type);
+            }
+        }
+    }
+    for (symbol_t q : initial_facts)
+        internSymbol(q);
+    for (symbol_t q : querie)
+        internSymbol(q);
+    for (symbol_t q : truth_table.variables)
+        internSymbol(q);
 }
 
-static rhr_value_e resolveOr(rhr_value_e a, rhr_value_e b)
+void Resolver::resetEvaluationState()
 {
-    if (a == R_TRUE || b == R_TRUE)
-        return R_TRUE;
-    if (a == R_FALSE && b == R_FALSE)
-        return R_FALSE;
-    return R_AMBIGOUS;
+    if (stats)
+        recordMemoMemory();
+    // a new generation leaves every memo and visiting entry stale
+    if (++generation == 0)
+    {
+        std::fill(memo_generation.begin(), memo_generation.end(), 0);
+        std::fill(visiting_generation.begin(), visiting_generation.end(), 0);
+        generation = 1;
+    }
+    prove_depth = 0;
+    prove_stack.clear();
+    leaf_values.clear();
 }
 
-static rhr_value_e resolveXor(rhr_value_e a, rhr_value_e b)
+bool Resolver::findMemo(symbol_t q, rhr_value_e &result) const
 {
-    if (a == R_AMBIGOUS || b == R_AMBIGOUS)
-        return R_AMBIGOUS;
-    return (a != b) ? R_TRUE : R_FALSE;
+    int id = symbol_ids[q];
+    if (id < 0 || (memo_generation[id] != generation && !settled[id]))
+        return false;
+    result = memo_values[id];
+    return true;
 }
 
-void Resolver::resetEvaluationState()
+bool Resolver::isVisiting(symbol_t q) const
 {
-    memo.clear();
-    visiting.clear();
+    int id = symbol_ids[q];
+    return id >= 0 && visiting_generation[id] == generation;
 }
 
 rhr_value_e Resolver::finalizeOutcome(const RuleOutcome &outcome) const
@@ -85,20 +134,21 @@ void Resolver::updateOutcomeFromRule(rhr_value_e lhs_result, const BasicRule &ru
     }
 }
 
-rhr_value_e Resolver::getTokenValue(TriToken &token, bool negated_context)
+int Resolver::getTokenStep(TriToken &token, bool negated_context, LhsProgram &lhs)
 {
-    if (token.has_value)
-        return token.value;
-    if (token.type >= 'A' && token.type <= 'Z')
+    if (token.step >= 0)
+        return token.step;
+    if (SymbolTable::isSymbol(token.type))
     {
-        token.value = prove(token.type, negated_context);
-        token.has_value = true;
-        return token.value;
+        lhs.requests.push_back(ProofRequest{token.type, negated_context});
+        lhs.steps.push_back(LhsStep{LhsStep::LOAD, static_cast<uint32_t>(lhs.requests.size() - 1), 0});
+        token.step = lhs.steps.size() - 1;
+        return token.step;
     }
     throw std::logic_error("Token value requested for non-value token");
 }
 
-void Resolver::executeNotTri(std::vector<TriToken> &tokens, bool negated_context)
+void Resolver::compileNotTri(std::vector<TriToken> &tokens, bool negated_context, LhsProgram &lhs)
 {
     size_t i = 0;
     while (i < tokens.size())
@@ -108,9 +158,9 @@ void Resolver::executeNotTri(std::vector<TriToken> &tokens, bool negated_context
             if (i + 1 == tokens.size())
                 throw std::logic_error("operator ! has no var attached\n");
             TriToken &next = tokens[i + 1];
-            rhr_value_e val = getTokenValue(next, !negated_context);
-            next.value = resolveNot(val);
-            next.has_value = true;
+            uint32_t operand = getTokenStep(next, !negated_context, lhs);
+            lhs.steps.push_back(LhsStep{LhsStep::NOT, operand, 0});
+            next.step = lhs.steps.size() - 1;
             next.type = 0;
             tokens.erase(tokens.begin() + i);
             if (i > 0)
@@ -121,29 +171,21 @@ void Resolver::executeNotTri(std::vector<TriToken> &tokens, bool negated_context
     }
 }
 
-void Resolver::executeOthersTri(std::vector<TriToken> &tokens, char op_target, bool negated_context)
+void Resolver::compileOthersTri(std::vector<TriToken> &tokens, char op_target, bool negated_context, LhsProgram &lhs)
 {
+    LhsStep::Op op = op_target == '+' ? LhsStep::AND : op_target == '|' ? LhsStep::OR : LhsStep::XOR;
     size_t i = 0;
     while (i < tokens.size())
     {
-        if (tokens[i].type == op_target)
+        if (tokens[i].type == static_cast<symbol_t>(op_target))
         {
             if (i == 0 || i + 1 == tokens.size())
                 throw std::logic_error(std::string("operator ") + op_target + " has no var attached\n");
-            TriToken &left = tokens[i - 1];
-            TriToken &right = tokens[i + 1];
-            rhr_value_e lval = getTokenValue(left, negated_context);
-            rhr_value_e rval = getTokenValue(right, negated_context);
-            rhr_value_e res = R_FALSE;
-            if (op_target == '+')
-                res = resolveAnd(lval, rval);
-            else if (op_target == '|')
-                res = resolveOr(lval, rval);
-            else if (op_target == '^')
-                res = resolveXor(lval, rval);
+            uint32_t left = getTokenStep(tokens[i - 1], negated_context, lhs);
+            uint32_t right = getTokenStep(tokens[i + 1], negated_context, lhs);
+            lhs.steps.push_back(LhsStep{op, left, right});
             tokens[i].type = 0;
-            tokens[i].value = res;
-            tokens[i].has_value = true;
+            tokens[i].step = lhs.steps.size() - 1;
             tokens.erase(tokens.begin() + i + 1);
             tokens.erase(tokens.begin() + i - 1);
             if (i > 0)
@@ -154,17 +196,17 @@ void Resolver::executeOthersTri(std::vector<TriToken> &tokens, char op_target, b
     }
 }
 
-rhr_value_e Resolver::executeTriBlock(std::vector<TriToken> &tokens, bool negated_context)
+int Resolver::compileTriBlock(std::vector<TriToken> &tokens, bool negated_context, LhsProgram &lhs)
 {
     if (tokens.empty())
         throw std::logic_error("TriBlock::execute: empty block");
-    executeNotTri(tokens, negated_context);
-    executeOthersTri(tokens, '+', negated_context);
-    executeOthersTri(tokens, '|', negated_context);
-    executeOthersTri(tokens, '^', negated_context);
+    compileNotTri(tokens, negated_context, lhs);
+    compileOthersTri(tokens, '+', negated_context, lhs);
+    compileOthersTri(tokens, '|', negated_context, lhs);
+    compileOthersTri(tokens, '^', negated_context, lhs);
     if (tokens.size() != 1)
         throw std::logic_error("TriBlock::execute: reduction did not converge");
-    return getTokenValue(tokens[0], negated_context);
+    return getTokenStep(tokens[0], negated_context, lhs);
 }
 
 unsigned int Resolver::getMaxPriority(std::vector<TriBlock> &blocks)
@@ -187,36 +229,37 @@ bool Resolver::isNegatedContext(size_t i, std::vector<TriBlock> &blocks)
     return false;
 }
 
-rhr_value_e Resolver::resolveLeftTri(std::vector<TriBlock> &blocks)
+uint32_t Resolver::compileLeftTri(std::vector<TriBlock> &blocks, LhsProgram &lhs)
 {
-    if (blocks.empty())
-        throw std::logic_error("resolveLeftTri: empty expression");
-    unsigned int max_priority = getMaxPriority(blocks);
-    for (size_t i = 0; i < blocks.size(); i++)
+    while (true)
     {
-        if (blocks[i].priority == max_priority)
+        if (blocks.empty())
+            throw std::logic_error("resolveLeftTri: empty expression");
+        unsigned int max_priority = getMaxPriority(blocks);
+        for (size_t i = 0; i < blocks.size(); i++)
         {
-            executeTriBlock(blocks[i].tokens, isNegatedContext(i, blocks));
-            TriToken result = blocks[i].tokens[0];
-            result.type = 0;
-            result.has_value = true;
-            if (i != 0)
-            {
-                blocks[i - 1].tokens.push_back(result);
-                blocks.erase(blocks.begin() + i);
-            }
-            else if (blocks.size() > 1)
+            if (blocks[i].priority == max_priority)
             {
-                blocks[1].tokens.insert(blocks[1].tokens.begin(), result);
-                blocks.erase(blocks.begin());
+                compileTriBlock(blocks[i].tokens, isNegatedContext(i, blocks), lhs);
+                TriToken result = blocks[i].tokens[0];
+                result.type = 0;
+                if (i != 0)
+                {
+                    blocks[i - 1].tokens.push_back(result);
+                    blocks.erase(blocks.begin() + i);
+                }
+                else if (blocks.size() > 1)
+                {
+                    blocks[1].tokens.insert(blocks[1].tokens.begin(), result);
+                    blocks.erase(blocks.begin());
+                }
+                else
+                    blocks[i].priority = 0;
             }
-            else
-                blocks[i].priority = 0;
         }
+        if (blocks.size() == 1 && blocks[0].tokens.size() <= 1)
+            return blocks[0].tokens[0].step;
     }
-    if (blocks.size() != 1 || blocks[0].tokens.size() > 1)
-        return resolveLeftTri(blocks);
-    return blocks[0].tokens[0].value;
 }
 
 std::vector<Resolver::TriBlock> Resolver::buildTriBlockVector(const std::vector<TokenBlock> &lhs)
@@ -232,8 +275,7 @@ std::vector<Resolver::TriBlock> Resolver::buildTriBlockVector(const std::vector<
         {
             Resolver::TriToken tri_token;
             tri_token.type = tk.type;
-            tri_token.value = R_FALSE;
-            tri_token.has_value = false;
+            tri_token.step = -1;
             tri_block.tokens.push_back(tri_token);
         }
         blocks.push_back(tri_block);
@@ -241,119 +283,374 @@ std::vector<Resolver::TriBlock> Resolver::buildTriBlockVector(const std::vector<
     return blocks;
 }
 
-bool Resolver::handleVisiting(char q, bool negated_context, rhr_value_e &result)
+const Resolver::LhsProgram &Resolver::program(uint32_t rule_id)
+{
+    if (rule_id >= programs.size())
+        programs.resize(basic_rules.size());
+    LhsProgram &lhs = programs[rule_id];
+    if (!lhs.compiled)
+    {
+        std::vector<Resolver::TriBlock> blocks = buildTriBlockVector(basic_rules[rule_id].lhs);
+        lhs.requests.clear();
+        lhs.steps.clear();
+        lhs.result = compileLeftTri(blocks, lhs);
+        lhs.compiled = true;
+    }
+    return lhs;
+}
+
+rhr_value_e Resolver::runProgram(const LhsProgram &lhs, const rhr_value_e *leaves, std::vector<rhr_value_e> &values)
+{
+    values.resize(lhs.steps.size());
+    for (size_t i = 0; i < lhs.steps.size(); ++i)
+    {
+        const LhsStep &step = lhs.steps[i];
+        switch (step.op)
+        {
+            case LhsStep::LOAD:
+                values[i] = leaves[step.a];
+                break;
+            case LhsStep::NOT:
+                values[i] = resolveNot(values[step.a]);
+                break;
+            case LhsStep::AND:
+                values[i] = resolveAnd(values[step.a], values[step.b]);
+                break;
+            case LhsStep::OR:
+                values[i] = resolveOr(values[step.a], values[step.b]);
+                break;
+            case LhsStep::XOR:
+                values[i] = resolveXor(values[step.a], values[step.b]);
+                break;
+        }
+    }
+    return values[lhs.result];
+}
+
+bool Resolver::handleVisiting(symbol_t q, bool negated_context, rhr_value_e &result)
 {
-    std::unordered_map<char, bool>::iterator visitingIt = visiting.find(q);
-    if (visitingIt == visiting.end())
+    if (!isVisiting(q))
         return false;
-    if (visitingIt->second != negated_context)
+    if (stats)
+        ++stats->visiting_hits;
+    if (visiting_negated[symbol_ids[q]] != negated_context)
         result = R_AMBIGOUS;
     else
         result = R_FALSE;
     return true;
 }
 
-bool Resolver::handleQInitialFact(char q, rhr_value_e &result)
+bool Resolver::handleQInitialFact(symbol_t q, rhr_value_e &result)
 {
-    auto initiaTrueIt = initial_facts.find(q);
-    if (initiaTrueIt == initial_facts.end())
+    int id = internSymbol(q);
+    if (!fact_flags[id])
         return false;
+    if (stats)
+        ++stats->initial_fact_hits;
     reasoning.recordInitialFact(q);
     result = R_TRUE;
-    memo[q] = result;
+    memo_values[id] = result;
+    memo_generation[id] = generation;
     return true;
 }
 
-bool Resolver::handleQMemo(char q, rhr_value_e &result)
+bool Resolver::handleQMemo(symbol_t q, rhr_value_e &result)
 {
-    std::unordered_map<char, rhr_value_e>::iterator memoIt = memo.find(q);
-    if (memoIt == memo.end())
+    if (!findMemo(q, result))
         return false;
-    result = memoIt->second;
+    if (stats)
+        ++stats->memo_hits;
     return true;
 }
 
-bool Resolver::isQHandled(char q, rhr_value_e &result, bool negated_context)
+bool Resolver::isQHandled(symbol_t q, rhr_value_e &result, bool negated_context)
 {
     if (handleQMemo(q, result) || handleQInitialFact(q, result) || handleVisiting(q, negated_context, result))
         return true;
     return false;
 }
 
-rhr_value_e Resolver::prove(char q, bool negated_context)
+bool Resolver::enterProve(symbol_t q, bool negated_context, rhr_value_e &result)
 {
-    rhr_value_e result = R_FALSE;
+    bool timed = Timeline::isEnabled();
+    uint64_t start = timed ? Timeline::now() : 0;
+    unsigned int depth = prove_depth;
+    if (timed)
+        ++prove_depth;
+    if (stats)
+        ++stats->prove_calls;
     if (isQHandled(q, result, negated_context))
+    {
+        if (timed)
+        {
+            prove_depth = depth;
+            Timeline::recordProve(start, q, result, depth);
+        }
+        return true;
+    }
+
+    int id = internSymbol(q);
+    visiting_negated[id] = negated_context;
+    visiting_generation[id] = generation;
+    ProveFrame frame;
+    frame.q = q;
+    frame.id = id;
+    frame.rule_index = 0;
+    frame.request = 0;
+    frame.leaf_base = leaf_values.size();
+    frame.outcome = {false, false, false, false};
+    frame.rule_started = false;
+    frame.timed = timed;
+    frame.start = start;
+    frame.depth = depth;
+    prove_stack.push_back(frame);
+    return false;
+}
+
+rhr_value_e Resolver::leaveProve()
+{
+    const ProveFrame &frame = prove_stack.back();
+    visiting_generation[frame.id] = 0;
+    rhr_value_e result = finalizeOutcome(frame.outcome);
+    reasoning.recordProveResult(frame.q, result);
+
+    memo_values[frame.id] = result;
+    memo_generation[frame.id] = generation;
+    if (frame.timed)
+    {
+        prove_depth = frame.depth;
+        Timeline::recordProve(frame.start, frame.q, result, frame.depth);
+    }
+    prove_stack.pop_back();
+    return result;
+}
+
+rhr_value_e Resolver::abandonProve(size_t bottom)
+{
+    while (prove_stack.size() >= bottom)
+    {
+        const ProveFrame &frame = prove_stack.back();
+        visiting_generation[frame.id] = 0;
+        // keeps the profiler's frames paired
+        if (frame.rule_started && profiler)
+            profiler->endRule(rules_by_symbol[frame.id][frame.rule_index]);
+        if (frame.timed)
+        {
+            prove_depth = frame.depth;
+            Timeline::recordProve(frame.start, frame.q, R_AMBIGOUS, frame.depth);
+        }
+        leaf_values.resize(frame.leaf_base);
+        prove_stack.pop_back();
+    }
+    return R_AMBIGOUS;
+}
+
+rhr_value_e Resolver::prove(symbol_t q, bool negated_context)
+{
+    rhr_value_e result = R_FALSE;
+    if (enterProve(q, negated_context, result))
         return result;
-    
-    visiting[q] = negated_context;
-    RuleOutcome outcome = {false, false, false, false};
-    
-    for (const BasicRule &rule : basic_rules)
+
+    // each frame proves the requests of its current rule one after the
+    // other; a request that needs rules pushes a frame and the loop comes
+    // back to this one once that frame is popped with its value
+    size_t bottom = prove_stack.size();
+    while (true)
     {
-        if (rule.rhs_symbol == q)
+        if (budget && (budget->poll() || budget->charge(MemoryAccounting::vectorBytes(prove_stack)
+                + MemoryAccounting::vectorBytes(leaf_values))))
+            return abandonProve(bottom);
+        ProveFrame &frame = prove_stack.back();
+        // by index: proving other symbols never adds rules to this list
+        if (frame.rule_index == rules_by_symbol[frame.id].size())
+        {
+            result = leaveProve();
+            if (prove_stack.size() < bottom)
+                return result;
+            leaf_values.push_back(result);
+            ++prove_stack.back().request;
+            continue;
+        }
+        uint32_t rule_id = rules_by_symbol[frame.id][frame.rule_index];
+        const LhsProgram &lhs = program(rule_id);
+        if (!frame.rule_started)
         {
-            std::vector<Resolver::TriBlock> blocks = buildTriBlockVector(rule.lhs);
-            rhr_value_e lhs_result = resolveLeftTri(blocks);
-            
-            if (lhs_result == R_TRUE)
+            if (profiler)
+                profiler->beginRule();
+            frame.rule_started = true;
+            frame.leaf_base = leaf_values.size();
+        }
+
+        bool pushed = false;
+        while (frame.request < lhs.requests.size())
+        {
+            const ProofRequest &request = lhs.requests[frame.request];
+            // frame is no longer valid once a new one is pushed
+            if (!enterProve(request.symbol, request.negated_context, result))
             {
-                RuleStatus status = rule.rhs_negated ? RuleStatus::FIRED_FALSE : RuleStatus::FIRED_TRUE;
-                reasoning.recordRuleEvaluation(q, &rule, status);
+                pushed = true;
+                break;
             }
-            else if (lhs_result == R_FALSE)
+            leaf_values.push_back(result);
+            ++frame.request;
+        }
+        if (pushed)
+            continue;
+
+        rhr_value_e lhs_result = runProgram(lhs, leaf_values.data() + frame.leaf_base, step_values);
+        leaf_values.resize(frame.leaf_base);
+        if (profiler)
+            profiler->endRule(rule_id);
+        if (stats)
+            ++stats->rules_evaluated;
+
+        if (reasoning.isRecording())
+            recordRuleTrace(frame.q, rule_id, lhs_result);
+        updateOutcomeFromRule(lhs_result, basic_rules[rule_id], frame.outcome);
+        ++frame.rule_index;
+        frame.request = 0;
+        frame.rule_started = false;
+    }
+}
+
+void Resolver::settleAcyclic()
+{
+    size_t count = symbols.size();
+    // dependencies of a symbol are the symbols its rules prove, a fact has none
+    std::vector<std::vector<uint32_t>> dependents(count);
+    std::unique_ptr<std::atomic<uint32_t>[]> waiting(new std::atomic<uint32_t>[count]);
+    std::vector<uint32_t> seeds;
+    for (size_t id = 0; id < count; ++id)
+    {
+        std::vector<uint32_t> dependencies;
+        if (!fact_flags[id])
+        {
+            for (uint32_t rule_id : rules_by_symbol[id])
             {
-                reasoning.recordRuleEvaluation(q, &rule, RuleStatus::NOT_FIRED);
+                for (const ProofRequest &request : program(rule_id).requests)
+                    dependencies.push_back(symbol_ids[request.symbol]);
             }
-            else // R_AMBIGOUS
+        }
+        std::sort(dependencies.begin(), dependencies.end());
+        dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+        for (uint32_t dependency : dependencies)
+            dependents[dependency].push_back(id);
+        waiting[id].store(dependencies.size(), std::memory_order_relaxed);
+        if (dependencies.empty())
+            seeds.push_back(id);
+    }
+
+    // below this a thread costs more to start than the symbols it settles
+    static const size_t SYMBOLS_PER_THREAD = 256;
+    unsigned int threads = std::min<size_t>(prove_threads, 1 + count / SYMBOLS_PER_THREAD);
+    WorkStealingPool pool(threads);
+    struct Scratch
+    {
+        std::vector<rhr_value_e> leaves;
+        std::vector<rhr_value_e> steps;
+        uint64_t settled = 0;
+        uint64_t rules = 0;
+        unsigned int polls = 0;
+    };
+    std::vector<Scratch> scratch(threads);
+    bool timed = Timeline::isEnabled();
+
+    // a symbol runs once its last dependency is settled, so a cycle and
+    // every symbol above it never run
+    pool.run(seeds, [&](uint32_t id, unsigned int worker) {
+        uint64_t start = timed ? Timeline::now() : 0;
+        Scratch &own = scratch[worker];
+        // out of budget the symbol and those above it are left to prove,
+        // which finds them ambiguous
+        if (budget && (++own.polls % RequestBudget::POLL_INTERVAL == 0 ? budget->check() : budget->isExhausted()))
+            return;
+        rhr_value_e result = R_TRUE;
+        if (!fact_flags[id])
+        {
+            RuleOutcome outcome = {false, false, false, false};
+            for (uint32_t rule_id : rules_by_symbol[id])
             {
-                std::set<char> ambig_vars = getAmbiguousVarsInRule(rule);
-                char cycle_var = getCycleVarInRule(rule);
-                
-                if (cycle_var != 0)
-                    reasoning.recordRuleEvaluation(q, &rule, RuleStatus::AMBIGUOUS_CYCLE, {}, cycle_var);
-                else
-                    reasoning.recordRuleEvaluation(q, &rule, RuleStatus::AMBIGUOUS_DEPENDS, ambig_vars);
+                const LhsProgram &lhs = programs[rule_id];
+                own.leaves.clear();
+                for (const ProofRequest &request : lhs.requests)
+                    own.leaves.push_back(memo_values[symbol_ids[request.symbol]]);
+                updateOutcomeFromRule(runProgram(lhs, own.leaves.data(), own.steps), basic_rules[rule_id], outcome);
+                ++own.rules;
             }
-            updateOutcomeFromRule(lhs_result, rule, outcome);
+            result = finalizeOutcome(outcome);
         }
+        memo_values[id] = result;
+        settled[id] = 1;
+        ++own.settled;
+        if (timed)
+            Timeline::recordProve(start, symbols[id], result, 0);
+        for (uint32_t dependent : dependents[id])
+        {
+            if (waiting[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                pool.fork(worker, dependent);
+        }
+    });
+
+    if (stats)
+    {
+        for (const Scratch &own : scratch)
+        {
+            stats->parallel_settled += own.settled;
+            stats->rules_evaluated += own.rules;
+        }
+        stats->steals += pool.steals();
+    }
+}
+
+void Resolver::recordRuleTrace(symbol_t q, uint32_t rule_id, rhr_value_e lhs_result)
+{
+    const BasicRule &rule = basic_rules[rule_id];
+    if (lhs_result == R_TRUE)
+    {
+        RuleStatus status = rule.rhs_negated ? RuleStatus::FIRED_FALSE : RuleStatus::FIRED_TRUE;
+        reasoning.recordRuleEvaluation(q, rule_id, status);
+    }
+    else if (lhs_result == R_FALSE)
+    {
+        reasoning.recordRuleEvaluation(q, rule_id, RuleStatus::NOT_FIRED);
+    }
+    else // R_AMBIGOUS
+    {
+        symbol_t cycle_var = getCycleVarInRule(rule);
+        if (cycle_var != 0)
+            reasoning.recordRuleEvaluation(q, rule_id, RuleStatus::AMBIGUOUS_CYCLE, {}, cycle_var);
+        else
+            reasoning.recordRuleEvaluation(q, rule_id, RuleStatus::AMBIGUOUS_DEPENDS, getAmbiguousVarsInRule(rule));
     }
-    
-    visiting.erase(q);
-    result = finalizeOutcome(outcome);
-    reasoning.recordProveResult(q, result);
-    
-    memo[q] = result;
-    return result;
 }
 
-std::set<char> Resolver::getAmbiguousVarsInRule(const BasicRule &rule)
+std::vector<symbol_t> Resolver::getAmbiguousVarsInRule(const BasicRule &rule)
 {
-    std::set<char> ambig_vars;
+    std::set<symbol_t> ambig_vars;
     for (const TokenBlock &block : rule.lhs)
     {
         for (const TokenEffect &tk : block)
         {
-            if (tk.type >= 'A' && tk.type <= 'Z')
+            if (SymbolTable::isSymbol(tk.type))
             {
-                auto it = memo.find(tk.type);
-                if (it != memo.end() && it->second == R_AMBIGOUS)
+                rhr_value_e value;
+                if (findMemo(tk.type, value) && value == R_AMBIGOUS)
                     ambig_vars.insert(tk.type);
             }
         }
     }
-    return ambig_vars;
+    return std::vector<symbol_t>(ambig_vars.begin(), ambig_vars.end());
 }
 
-char Resolver::getCycleVarInRule(const BasicRule &rule)
+symbol_t Resolver::getCycleVarInRule(const BasicRule &rule)
 {
     for (const TokenBlock &block : rule.lhs)
     {
         for (const TokenEffect &tk : block)
         {
-            if (tk.type >= 'A' && tk.type <= 'Z')
+            if (SymbolTable::isSymbol(tk.type))
             {
-                if (visiting.find(tk.type) != visiting.end())
+                if (isVisiting(tk.type))
                     return tk.type;
             }
         }
@@ -361,67 +658,139 @@ char Resolver::getCycleVarInRule(const BasicRule &rule)
     return 0;
 }
 
-void Resolver::outputResult(char q, rhr_value_e res)
+void Resolver::outputResult(symbol_t q, rhr_value_e res)
 {
     std::string resultStr = (res == R_TRUE ? "true" : res == R_FALSE ? "false"
                                                                      : "ambiguous");
-    std::cout << q << " = " << resultStr << std::endl;
+    std::cout << SymbolTable::name(q) << " = " << resultStr << '\n';
 }
 
-bool Resolver::buildFilteredTruthTable(const std::map<char, rhr_value_e> &base_results, TruthTable &filtered) const
+bool Resolver::filterStates(const StateIndex &index, const std::map<symbol_t, rhr_value_e> &base_results, StateIndex::Bitmap &states) const
 {
-    if (!truth_table.hasValidState())
+    if (!index.stateCount())
         return false;
-    filtered = truth_table.filterByResults(initial_facts, base_results);
-    return filtered.hasValidState();
+    states = index.filterByResults(initial_facts, base_results);
+    if (stats)
+        stats->setMemory(EngineStats::MEM_FILTERED_TABLE, MemoryAccounting::vectorBytes(states));
+    return StateIndex::any(states);
 }
 
-std::map<char, rhr_value_e> Resolver::computeBaseResults(const std::set<char> &facts)
+std::map<symbol_t, rhr_value_e> Resolver::computeBaseResults(const std::set<symbol_t> &facts)
 {
-    std::map<char, rhr_value_e> base_results;
-    for (char q : facts)
+    std::map<symbol_t, rhr_value_e> base_results;
+    for (symbol_t q : facts)
     {
         resetEvaluationState();
+        reasoning.recordGoal(q);
         base_results[q] = prove(q, false);
     }
     return base_results;
 }
 
-void Resolver::resolve()
+std::map<symbol_t, rhr_value_e> Resolver::evaluate()
 {
+    Timeline::Span span("evaluate");
     reasoning.reset();
-    std::map<char, rhr_value_e> base_results = computeBaseResults(truth_table.variables);
-    TruthTable filtered_truth_table;
-    bool has_truth_table = buildFilteredTruthTable(base_results, filtered_truth_table);
+    reasoning.recordRunStart();
+    if (stats)
+        stats->resetRun();
+    EngineStats::Clock::time_point start = EngineStats::Clock::now();
+    std::map<symbol_t, rhr_value_e> results;
+    {
+        Timeline::Span base_span("base_results");
+        std::fill(settled.begin(), settled.end(), 0);
+        if (prove_threads > 1 && !reasoning.isRecording() && !profiler)
+            settleAcyclic();
+        results = computeBaseResults(truth_table.variables);
+        partial = budget && budget->isExhausted();
+    }
+    if (stats)
+    {
+        stats->base_results_us = EngineStats::elapsedUs(start);
+        start = EngineStats::Clock::now();
+    }
+    Timeline::Span clamp_span("clamp");
+    // binary-clause rules stand for their states with an implication graph
+    const TwoSat *two_sat = truth_table.getTwoSat();
+    std::map<symbol_t, bool> forced;
+    std::unique_ptr<StateIndex> own_index;
+    const StateIndex *index = truth_table.getIndex();
+    StateIndex::Bitmap states;
+    bool has_truth_table;
+    if (two_sat)
+        has_truth_table = two_sat->forcedValues(TruthTable::knownValues(initial_facts, results), forced);
+    else
+    {
+        // tables built outside the parser carry no index, index them here
+        if (!index)
+        {
+            own_index.reset(new StateIndex(truth_table));
+            index = own_index.get();
+        }
+        has_truth_table = filterStates(*index, results, states);
+    }
 
-    for (char q : truth_table.variables)
+    for (symbol_t q : truth_table.variables)
     {
-        rhr_value_e res = base_results.count(q) ? base_results[q] : R_FALSE;
+        rhr_value_e &res = results[q];
         if (has_truth_table)
         {
-            rhr_value_e clamped = filtered_truth_table.clampValue(q, res);
+            rhr_value_e clamped = res;
+            if (!two_sat)
+                clamped = index->clampValue(states, q, res);
+            else if (forced.count(q))
+                clamped = forced[q] ? R_TRUE : R_FALSE;
             if (clamped != res)
             {
-                std::string reason;
-                if (res == R_AMBIGOUS && clamped == R_TRUE)
-                    reason = "All cases require " + std::string(1, q) + " to be true";
-                else if (res == R_AMBIGOUS && clamped == R_FALSE)
-                    reason = "All cases require " + std::string(1, q) + " to be false";
-                else
-                    reason = "Truth table constraint forces " + std::string(1, q) + " to a definite value";
-                
-                reasoning.recordTruthTableClamp(q, res, clamped, reason);
+                reasoning.recordTruthTableClamp(q, res, clamped);
+                if (stats)
+                    ++stats->clamped_values;
             }
             res = clamped;
         }
-        
-        if (querie.find(q) != querie.end())
-        {
-            if (reasoning.isEnabled())
-                reasoning.printTrace(q, std::cout);
-            else
-                outputResult(q, res);
-        }
+    }
+    // queried facts outside every rule are never proven, keep their trace
+    for (symbol_t q : querie)
+    {
+        if (!results.count(q) && initial_facts.count(q))
+            reasoning.recordInitialFact(q);
+    }
+    if (stats)
+    {
+        stats->clamp_us = EngineStats::elapsedUs(start);
+        // the filtered bitmap is released on return
+        stats->setMemory(EngineStats::MEM_FILTERED_TABLE, 0);
+        stats->setMemory(EngineStats::MEM_TRACES, reasoning.memoryBytes());
+        recordMemoMemory();
+    }
+    return results;
+}
+
+rhr_value_e Resolver::queryResult(const std::map<symbol_t, rhr_value_e> &results, symbol_t q) const
+{
+    std::map<symbol_t, rhr_value_e>::const_iterator it = results.find(q);
+    if (it != results.end())
+        return it->second;
+    if (initial_facts.count(q))
+        return R_TRUE;
+    return partial ? R_AMBIGOUS : R_FALSE;
+}
+
+void Resolver::explain(symbol_t q, std::ostream &os) const
+{
+    reasoning.printTrace(q, basic_rules, os);
+}
+
+void Resolver::resolve()
+{
+    std::map<symbol_t, rhr_value_e> results = evaluate();
+
+    for (symbol_t q : querie)
+    {
+        if (reasoning.isEnabled())
+            explain(q, std::cout);
+        else
+            outputResult(q, queryResult(results, q));
     }
 }
 
@@ -437,9 +806,46 @@ const ReasoningStep &Resolver::getReasoning() const
     return reasoning;
 }
 
-void Resolver::changeFacts(const std::set<char> &new_facts)
+void Resolver::recordMemoMemory()
+{
+    stats->setMemory(EngineStats::MEM_MEMO,
+                     MemoryAccounting::vectorBytes(memo_values) + MemoryAccounting::vectorBytes(memo_generation)
+                         + MemoryAccounting::vectorBytes(visiting_negated)
+                         + MemoryAccounting::vectorBytes(visiting_generation)
+                         + MemoryAccounting::vectorBytes(settled));
+}
+
+void Resolver::setStats(EngineStats *stats)
+{
+    this->stats = stats;
+}
+
+void Resolver::setProfiler(RuleProfiler *profiler)
+{
+    this->profiler = profiler;
+}
+
+void Resolver::setProveThreads(unsigned int threads)
+{
+    prove_threads = threads ? threads : 1;
+}
+
+void Resolver::setRequestBudget(RequestBudget *budget)
+{
+    this->budget = budget;
+}
+
+bool Resolver::isPartial() const
+{
+    return partial;
+}
+
+void Resolver::changeFacts(const std::set<symbol_t> &new_facts)
 {
     initial_facts = new_facts;
+    std::fill(fact_flags.begin(), fact_flags.end(), 0);
+    for (symbol_t q : initial_facts)
+        fact_flags[internSymbol(q)] = 1;
     resetEvaluationState();
 
     for (BasicRule &rule : basic_rules)
@@ -448,7 +854,7 @@ void Resolver::changeFacts(const std::set<char> &new_facts)
         {
             for (TokenEffect &tk : block)
             {
-                if (tk.type >= 'A' && tk.type <= 'Z')
+                if (SymbolTable::isSymbol(tk.type))
                     tk.effect = (initial_facts.find(tk.type) != initial_facts.end());
             }
         }
@@ -1,12 +1,16 @@
 #pragma once
+#include <cstdint>
 #include <vector>
 #include "BasicRule.hpp"
+#include "EngineStats.hpp"
 #include "ReasoningStep.hpp"
 #include "ReasoningTypes.hpp"
+#include "RequestBudget.hpp"
+#include "RuleProfiler.hpp"
+#include "StateIndex.hpp"
 #include "TruthTable.hpp"
 #include <map>
 #include <set>
-#include <unordered_map>
 
 /**
  * Resolves queries using rule evaluation and optional truth-table constraints.
@@ -30,16 +34,15 @@ private:
 	};
 
 	/**
-	 * Internal tri-state token used during expression evaluation.
+	 * Token of a rule LHS while it is compiled: an operator or a symbol,
+	 * or the step computing its value once reduced.
 	 **/
 	struct TriToken
 	{
-		/** token type (operator or symbol). */
-		char type;
-		/** resolved value for the token. */
-		rhr_value_e value;
-		/** whether the value has been computed. */
-		bool has_value;
+		/** token type (operator or symbol), 0 once reduced. */
+		symbol_t type;
+		/** step holding the value of the token, -1 until computed. */
+		int step;
 	};
 
 	/**
@@ -53,42 +56,173 @@ private:
 		std::vector<TriToken> tokens;
 	};
 
+	/**
+	 * Symbol a rule LHS needs proven, with the negation context it is read in.
+	 **/
+	struct ProofRequest
+	{
+		symbol_t symbol;
+		bool negated_context;
+	};
+
+	/**
+	 * One instruction of a compiled LHS: LOAD reads the value of request a,
+	 * the others combine the values of earlier steps a and b.
+	 **/
+	struct LhsStep
+	{
+		enum Op : uint8_t
+		{
+			LOAD,
+			NOT,
+			AND,
+			OR,
+			XOR
+		};
+		Op op;
+		uint32_t a;
+		uint32_t b;
+	};
+
+	/**
+	 * LHS of a basic rule reduced once, in the order of the tri-state block
+	 * reduction: the symbols to prove, in proving order, then the steps
+	 * combining their values. Which symbols get proven never depends on
+	 * their values, so the proofs can all be done before the steps run.
+	 **/
+	struct LhsProgram
+	{
+		bool compiled = false;
+		std::vector<ProofRequest> requests;
+		std::vector<LhsStep> steps;
+		/** step holding the value of the whole LHS. */
+		uint32_t result = 0;
+	};
+
+	/**
+	 * Symbol being proven on the explicit prove stack, resumed when the
+	 * symbol it waits for is proven.
+	 **/
+	struct ProveFrame
+	{
+		symbol_t q;
+		int id;
+		/** position in rules_by_symbol[id] of the rule being evaluated. */
+		uint32_t rule_index;
+		/** next request of that rule's LHS. */
+		uint32_t request;
+		/** where the values of this frame's requests start in leaf_values. */
+		size_t leaf_base;
+		RuleOutcome outcome;
+		/** whether the profiler was told the current rule started. */
+		bool rule_started;
+		/** timeline event of the prove, when recording. */
+		bool timed;
+		uint64_t start;
+		unsigned int depth;
+	};
+
 	/** query symbols to resolve. */
-	std::set<char> querie;
+	std::set<symbol_t> querie;
 	/** rules deduced from parsing logic expressions. */
 	std::vector<BasicRule> &basic_rules;
 	/** initial facts provided by the input file. */
-	std::set<char> initial_facts;
-	/** optional global truth table constraints. */
-	TruthTable truth_table;
+	std::set<symbol_t> initial_facts;
+	/** optional global truth table constraints, owned by the parser. */
+	const TruthTable &truth_table;
 	/** trace recorder for --explain output. */
 	ReasoningStep reasoning;
-	/** memorized results for already-proven symbols. */
-	std::unordered_map<char, rhr_value_e> memo;
-	/** recursion tracking to detect cycles. */
-	std::unordered_map<char, bool> visiting;
+	/** dense id of each symbol, -1 until interned. */
+	SymbolArray<int> symbol_ids;
+	/** symbol of each dense id. */
+	std::vector<symbol_t> symbols;
+	/** rules concluding each symbol, in rule order, by id. */
+	std::vector<std::vector<uint32_t>> rules_by_symbol;
+	/** initial_facts as a flag per id. */
+	std::vector<uint8_t> fact_flags;
+	/** memorized results for already-proven symbols, set when memo_generation is current. */
+	std::vector<rhr_value_e> memo_values;
+	std::vector<uint32_t> memo_generation;
+	/** recursion tracking to detect cycles: negation context, set when visiting_generation is current. */
+	std::vector<uint8_t> visiting_negated;
+	std::vector<uint32_t> visiting_generation;
+	/** current evaluation, 0 is never current. */
+	uint32_t generation;
+	/** optional counters and timings (--stats), not owned. */
+	EngineStats *stats;
+	/** optional per-rule cost attribution (--profile), not owned. */
+	RuleProfiler *profiler;
+	/** recursion depth of prove, reported on the timeline. */
+	unsigned int prove_depth;
+	/** compiled LHS of each basic rule, by rule id, compiled on first use. */
+	std::vector<LhsProgram> programs;
+	/** symbols being proven, innermost last; replaces native recursion. */
+	std::vector<ProveFrame> prove_stack;
+	/** values of the proven requests of every frame, frame after frame. */
+	std::vector<rhr_value_e> leaf_values;
+	/** scratch values of the steps of the LHS being run. */
+	std::vector<rhr_value_e> step_values;
+	/** threads of the parallel prover, 1 to prove everything sequentially. */
+	unsigned int prove_threads;
+	/** ids settled by the parallel prover: memo_values holds them in every generation. */
+	std::vector<uint8_t> settled;
+	/** optional time and memory of the request, not owned. */
+	RequestBudget *budget;
+	/** the last evaluation ran out of budget, leaving symbols ambiguous. */
+	bool partial;
 
 	/**
-	 * Clear memorization and recursion tracking for a new resolution.
+	 * Clear memorization and recursion tracking for a new resolution,
+	 * by starting a new generation.
 	 **/
 	void resetEvaluationState();
 	/**
-	 * Resolve a symbol with recursion and memoization.
+	 * Dense id of a symbol, interning it on first use.
+	 **/
+	int internSymbol(symbol_t q);
+	/**
+	 * Intern every symbol of the rules, facts, queries and table, and index
+	 * the rules by the symbol they conclude.
+	 **/
+	void internSymbols();
+	/**
+	 * Memorized result of a symbol in the current generation, if any.
+	 **/
+	bool findMemo(symbol_t q, rhr_value_e &result) const;
+	bool isVisiting(symbol_t q) const;
+	/**
+	 * Resolve a symbol with memoization. Dependencies are proven on the
+	 * explicit prove_stack, so native stack use does not grow with the
+	 * depth of the rule chains.
+	 **/
+	rhr_value_e prove(symbol_t q, bool negated_context);
+	/**
+	 * Start proving a symbol: true with result when memo, facts or a cycle
+	 * answer at once, otherwise push its frame and return false.
 	 **/
-	rhr_value_e prove(char q, bool negated_context);
+	bool enterProve(symbol_t q, bool negated_context, rhr_value_e &result);
+	/**
+	 * Pop the finished top frame, memorize and return its result.
+	 **/
+	rhr_value_e leaveProve();
+	/**
+	 * Drop the frames from bottom up, out of budget: nothing they proved
+	 * is memorized, and the symbol proven at bottom is ambiguous.
+	 **/
+	rhr_value_e abandonProve(size_t bottom);
 	/**
 	 * Check memo cache and record a trace if hit.
 	 **/
-	bool handleQMemo(char q, rhr_value_e &result);
-    bool isQHandled(char q, rhr_value_e &result, bool negated_context);
+	bool handleQMemo(symbol_t q, rhr_value_e &result);
+    bool isQHandled(symbol_t q, rhr_value_e &result, bool negated_context);
     /**
      * Check initial facts and record a trace if matched.
      **/
-    bool handleQInitialFact(char q, rhr_value_e &result);
+    bool handleQInitialFact(symbol_t q, rhr_value_e &result);
 	/**
 	 * Handle recursion cycles based on negation context.
 	 **/
-	bool handleVisiting(char q, bool negated_context, rhr_value_e &result);
+	bool handleVisiting(symbol_t q, bool negated_context, rhr_value_e &result);
 	/**
 	 * Accumulate outcome flags from a single rule evaluation.
 	 **/
@@ -99,47 +233,71 @@ private:
      **/
     rhr_value_e finalizeOutcome(const RuleOutcome &outcome) const;
 	/**
-	 * Reduce grouped token blocks by precedence.
+	 * Compiled LHS of a basic rule, compiling it on first use.
+	 **/
+	const LhsProgram &program(uint32_t rule_id);
+	/**
+	 * Value of a compiled LHS from the values of its requests, using values
+	 * as scratch for the steps.
+	 **/
+	static rhr_value_e runProgram(const LhsProgram &lhs, const rhr_value_e *leaves, std::vector<rhr_value_e> &values);
+	/**
+	 * Settle, on a work-stealing pool, every symbol whose rules reach no
+	 * cycle: such a value does not depend on the order symbols are proven
+	 * in, so each is computed once, as soon as its dependencies are. The
+	 * symbols on or above a cycle are left to prove and handleVisiting.
+	 **/
+	void settleAcyclic();
+	/**
+	 * Reduce grouped token blocks by precedence, return the result step.
 	 **/
-	rhr_value_e resolveLeftTri(std::vector<TriBlock> &blocks);
+	uint32_t compileLeftTri(std::vector<TriBlock> &blocks, LhsProgram &lhs);
 	/**
-	 * Execute a single token block with tri-state operators.
+	 * Reduce a single token block with tri-state operators.
 	 **/
-	rhr_value_e executeTriBlock(std::vector<TriToken> &tokens, bool negated_context);
+	int compileTriBlock(std::vector<TriToken> &tokens, bool negated_context, LhsProgram &lhs);
 	/**
 	 * Apply NOT operations for a tri-state token block.
 	 **/
-	void executeNotTri(std::vector<TriToken> &tokens, bool negated_context);
+	void compileNotTri(std::vector<TriToken> &tokens, bool negated_context, LhsProgram &lhs);
 	/**
 	 * Apply a specific binary operator for a tri-state token block.
 	 **/
-	void executeOthersTri(std::vector<TriToken> &tokens, char op_target, bool negated_context);
+	void compileOthersTri(std::vector<TriToken> &tokens, char op_target, bool negated_context, LhsProgram &lhs);
 	/**
-	 * Resolve a token value, proving symbols as needed.
+	 * Step of a token value, requesting the proof of a symbol as needed.
 	 **/
-	rhr_value_e getTokenValue(TriToken &token, bool negated_context);
+	int getTokenStep(TriToken &token, bool negated_context, LhsProgram &lhs);
 	/**
 	 * get the max priority of a std::vector<TokenBlock>
 	 */
 	unsigned int getMaxPriority(std::vector<TriBlock> &blocks);
-	char getCycleVarInRule(const BasicRule &rule);
-	std::set<char> getFalseVarsInRule(const BasicRule &rule);
-	std::set<char> getAmbiguousVarsInRule(const BasicRule &rule);
+	symbol_t getCycleVarInRule(const BasicRule &rule);
+	std::vector<symbol_t> getAmbiguousVarsInRule(const BasicRule &rule);
+	/**
+	 * Record the proof DAG edge of a rule evaluation (only with --explain).
+	 **/
+	void recordRuleTrace(symbol_t q, uint32_t rule_id, rhr_value_e lhs_result);
     bool isNegatedContext(size_t i, std::vector<TriBlock> &blocks);
 	/**
-	 * Build a filtered truth table from known facts.
+	 * Account the memory of the memo and visiting arrays in stats.
+	 **/
+	void recordMemoMemory();
+	/**
+	 * Select the truth table states compatible with the known facts, as a
+	 * bitmap of the table index; false when none remains.
 	 **/
-	bool buildFilteredTruthTable(const std::map<char, rhr_value_e> &base_results, TruthTable &filtered) const;
+	bool filterStates(const StateIndex &index, const std::map<symbol_t, rhr_value_e> &base_results, StateIndex::Bitmap &states) const;
 	/**
 	 * Print the final result for a query.
 	 **/
-	void outputResult(char q, rhr_value_e res);
+	void outputResult(symbol_t q, rhr_value_e res);
 
 public:
 	/**
 	 * Construct the resolver with rules, facts, and an optional truth table.
 	 **/
-	Resolver(std::set<char> querie, std::vector<BasicRule> &basic_rules, std::set<char> initial_facts, const TruthTable &truth_table);
+	Resolver(std::set<symbol_t> querie, std::vector<BasicRule> &basic_rules, std::set<symbol_t> initial_facts, const TruthTable &truth_table);
 	/**
 	 * Destroy the resolver.
 	 **/
@@ -152,20 +310,52 @@ public:
 	 * Access the reasoning trace helper (const).
 	 **/
 	const ReasoningStep &getReasoning() const;
+	/**
+	 * Count engine events of every evaluation into stats (nullptr to disable).
+	 **/
+	void setStats(EngineStats *stats);
+	/**
+	 * Attribute rule evaluation costs to profiler (nullptr to disable).
+	 **/
+	void setProfiler(RuleProfiler *profiler);
+	/**
+	 * Prove with threads workers (1, the default, proves sequentially).
+	 * Ignored while the reasoning is recorded or rules are profiled, which
+	 * follow the sequential proof order.
+	 **/
+	void setProveThreads(unsigned int threads);
+	/**
+	 * Stop proving once budget is exhausted (nullptr for no limit): the
+	 * symbols left unproven are ambiguous and the evaluation is partial.
+	 **/
+	void setRequestBudget(RequestBudget *budget);
+	/**
+	 * Whether the last evaluation ran out of budget.
+	 **/
+	bool isPartial() const;
 	/**
 	 * Resolve all queries and print standard results.
 	 */
 	void resolve();
 	/**
-	 * Resolve one query with optional truth-table clamping.
+	 * Resolve every variable of the truth table without printing anything.
+	 */
+	std::map<symbol_t, rhr_value_e> evaluate();
+	/**
+	 * Final value of a query from evaluate() results (symbols outside every rule are facts or false,
+	 * ambiguous after a partial evaluation since their rules may not have been deduced).
+	 */
+	rhr_value_e queryResult(const std::map<symbol_t, rhr_value_e> &results, symbol_t q) const;
+	/**
+	 * Print the --explain trace of a symbol from the last evaluation.
 	 */
-	rhr_value_e resolveQuery(char q, const TruthTable &filtered, bool has_truth_table);
+	void explain(symbol_t q, std::ostream &os) const;
 	/**
 	 * Compute base results for a set of symbols.
 	 */
-	std::map<char, rhr_value_e> computeBaseResults(const std::set<char> &facts);
+	std::map<symbol_t, rhr_value_e> computeBaseResults(const std::set<symbol_t> &facts);
 	/**
 	 * Update initial facts and clear resolver caches before re-evaluating queries.
 	 */
-	void changeFacts(const std::set<char> &new_facts);
+	void changeFacts(const std::set<symbol_t> &new_facts);
 };
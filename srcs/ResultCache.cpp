@@ -0,0 +1,142 @@
+#include "ResultCache.hpp"
+#include "MemoryAccounting.hpp"
+
+/** splitmix64 finalizer: every input bit flips about half the output bits */
+static uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+ResultCache::Key::Key(uint64_t kb_version, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries)
+    : kb_version(kb_version), facts(facts.begin(), facts.end()), queries(queries.begin(), queries.end())
+{
+}
+
+bool ResultCache::Key::operator==(const Key &other) const
+{
+    return kb_version == other.kb_version && facts == other.facts && queries == other.queries;
+}
+
+uint64_t ResultCache::Key::fingerprint() const
+{
+    uint64_t h = mix(kb_version);
+    for (symbol_t symbol : facts)
+        h = mix(h ^ symbol);
+    // the separator keeps {A}{B} apart from {AB}{}
+    h = mix(h ^ ~static_cast<uint64_t>(0));
+    for (symbol_t symbol : queries)
+        h = mix(h ^ symbol);
+    return h;
+}
+
+ResultCache::ResultCache(size_t max_bytes, size_t shard_count)
+    : max_bytes(max_bytes), hits(0), misses(0), insertions(0), evictions(0)
+{
+    if (shard_count == 0)
+        shard_count = 1;
+    shard_bytes = max_bytes / shard_count;
+    for (size_t i = 0; i < shard_count; ++i)
+        shards.emplace_back(new Shard());
+}
+
+ResultCache::Shard &ResultCache::shardOf(uint64_t fingerprint)
+{
+    // the low bits pick the hash bucket, shard on the high ones
+    return *shards[(fingerprint >> 32) % shards.size()];
+}
+
+size_t ResultCache::entryBytes(const Key &key, const Answer &answer)
+{
+    size_t list_node = MemoryAccounting::heapBlockBytes(2 * sizeof(void *) + sizeof(Entry));
+    size_t map_node = MemoryAccounting::heapBlockBytes(sizeof(void *) + sizeof(std::pair<const uint64_t, void *>));
+    return list_node + map_node + MemoryAccounting::vectorBytes(key.facts) + MemoryAccounting::vectorBytes(key.queries)
+        + MemoryAccounting::vectorBytes(answer.results);
+}
+
+bool ResultCache::lookup(const Key &key, Answer &answer)
+{
+    uint64_t fingerprint = key.fingerprint();
+    Shard &shard = shardOf(fingerprint);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.by_fingerprint.find(fingerprint);
+        if (it != shard.by_fingerprint.end() && it->second->key == key)
+        {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            answer = it->second->answer;
+            ++hits;
+            return true;
+        }
+    }
+    ++misses;
+    return false;
+}
+
+void ResultCache::evictOne(Shard &shard)
+{
+    const Entry &oldest = shard.lru.back();
+    shard.bytes -= oldest.bytes;
+    shard.by_fingerprint.erase(oldest.fingerprint);
+    shard.lru.pop_back();
+    ++evictions;
+}
+
+void ResultCache::insert(const Key &key, const Answer &answer)
+{
+    size_t bytes = entryBytes(key, answer);
+    if (bytes > shard_bytes)
+        return;
+    uint64_t fingerprint = key.fingerprint();
+    Shard &shard = shardOf(fingerprint);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.by_fingerprint.find(fingerprint);
+    if (it != shard.by_fingerprint.end())
+    {
+        // same answer computed twice, or a colliding key taking the slot over
+        shard.bytes -= it->second->bytes;
+        shard.lru.erase(it->second);
+        shard.by_fingerprint.erase(it);
+    }
+    while (!shard.lru.empty() && shard.bytes + bytes > shard_bytes)
+        evictOne(shard);
+    shard.lru.push_front(Entry{fingerprint, key, answer, bytes});
+    shard.by_fingerprint[fingerprint] = shard.lru.begin();
+    shard.bytes += bytes;
+    ++insertions;
+}
+
+void ResultCache::clear()
+{
+    for (std::unique_ptr<Shard> &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->lru.clear();
+        shard->by_fingerprint.clear();
+        shard->bytes = 0;
+    }
+}
+
+ResultCache::Counters ResultCache::counters() const
+{
+    Counters counters = {hits.load(), misses.load(), insertions.load(), evictions.load(), 0, 0};
+    for (const std::unique_ptr<Shard> &shard : shards)
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        counters.entries += shard->lru.size();
+        counters.bytes += shard->bytes;
+    }
+    return counters;
+}
+
+void ResultCache::writeJson(std::ostream &os) const
+{
+    Counters c = counters();
+    os << "{\"cache\":{\"hits\":" << c.hits << ",\"misses\":" << c.misses << ",\"insertions\":" << c.insertions
+       << ",\"evictions\":" << c.evictions << ",\"entries\":" << c.entries << ",\"bytes\":" << c.bytes
+       << ",\"max_bytes\":" << max_bytes << "}}" << std::endl;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ReasoningTypes.hpp"
+
+/**
+ * LRU cache of query answers for the daemon and pipe modes, in front of
+ * the resolver. An answer only depends on the knowledge base, the initial
+ * facts and the query set, so it is keyed by a 64-bit fingerprint of the
+ * three; the full key is kept in the entry and compared on lookup, so a
+ * fingerprint collision is a miss and never a wrong answer.
+ *
+ * Entries are spread over shards by fingerprint, each with its own mutex,
+ * LRU list and share of the byte budget, so concurrent workers rarely
+ * contend. Counters are atomics readable at any time.
+ **/
+class ResultCache
+{
+public:
+    struct Key
+    {
+        uint64_t kb_version;
+        /** sorted symbol codes, as the sets hold them */
+        std::vector<symbol_t> facts;
+        std::vector<symbol_t> queries;
+
+        Key(uint64_t kb_version, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries);
+        bool operator==(const Key &other) const;
+        uint64_t fingerprint() const;
+    };
+
+    /** what QueryProtocol replies without explanation */
+    struct Answer
+    {
+        /** false when no state agrees with the facts */
+        bool ok = true;
+        std::vector<std::pair<symbol_t, rhr_value_e>> results;
+    };
+
+    struct Counters
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t insertions;
+        uint64_t evictions;
+        size_t entries;
+        size_t bytes;
+    };
+
+    static const size_t DEFAULT_SHARDS = 16;
+
+    /** keep at most max_bytes of entries (estimated, see MemoryAccounting) */
+    explicit ResultCache(size_t max_bytes, size_t shards = DEFAULT_SHARDS);
+
+    /** copy the cached answer of key into answer, false on a miss */
+    bool lookup(const Key &key, Answer &answer);
+    /** store an answer, evicting the least recently used entries of its shard */
+    void insert(const Key &key, const Answer &answer);
+    void clear();
+
+    Counters counters() const;
+    size_t maxBytes() const { return max_bytes; }
+    /** print the counters as one JSON object line */
+    void writeJson(std::ostream &os) const;
+
+private:
+    struct Entry
+    {
+        uint64_t fingerprint;
+        Key key;
+        Answer answer;
+        size_t bytes;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        /** most recently used first */
+        std::list<Entry> lru;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> by_fingerprint;
+        size_t bytes = 0;
+    };
+
+    size_t max_bytes;
+    size_t shard_bytes;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> insertions;
+    std::atomic<uint64_t> evictions;
+
+    Shard &shardOf(uint64_t fingerprint);
+    /** estimated heap bytes of an entry with its list and map nodes */
+    static size_t entryBytes(const Key &key, const Answer &answer);
+    /** drop the least recently used entry of a locked shard */
+    void evictOne(Shard &shard);
+};
@@ -0,0 +1,380 @@
+#include "ReteEngine.hpp"
+#include "BasicRule.hpp"
+#include "Parser.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+ReteEngine::ReteEngine() : compiled(nullptr), acyclic(false), rules(nullptr), symbol_node(-1), is_fact(0), activations(0)
+{
+}
+
+int ReteEngine::symbolNode(symbol_t symbol)
+{
+    if (symbol_node[symbol] < 0)
+    {
+        symbol_node.at(symbol) = nodes.size();
+        nodes.push_back(Node{SYMBOL, symbol, -1, -1, R_FALSE, 0, {}, {}});
+    }
+    return symbol_node[symbol];
+}
+
+int ReteEngine::makeNode(Kind kind, int left, int right)
+{
+    // AND, OR and XOR commute: one node for both operand orders
+    if (kind != NOT && right < left)
+        std::swap(left, right);
+    std::tuple<int, int, int> key(kind, left, right);
+    auto it = shared.find(key);
+    if (it != shared.end())
+        return it->second;
+    int id = nodes.size();
+    nodes.push_back(Node{kind, 0, left, right, R_FALSE, 0, {}, {}});
+    nodes[left].successors.push_back(id);
+    if (right >= 0 && right != left)
+        nodes[right].successors.push_back(id);
+    shared[key] = id;
+    return id;
+}
+
+int ReteEngine::tokenNode(Token &token)
+{
+    if (token.node >= 0)
+        return token.node;
+    if (SymbolTable::isSymbol(token.type))
+    {
+        token.node = symbolNode(token.type);
+        return token.node;
+    }
+    throw std::logic_error("Token value requested for non-value token");
+}
+
+void ReteEngine::compileNot(std::vector<Token> &tokens)
+{
+    size_t i = 0;
+    while (i < tokens.size())
+    {
+        if (tokens[i].type == '!')
+        {
+            if (i + 1 == tokens.size())
+                throw std::logic_error("operator ! has no var attached\n");
+            Token &next = tokens[i + 1];
+            next.node = makeNode(NOT, tokenNode(next), -1);
+            next.type = 0;
+            tokens.erase(tokens.begin() + i);
+            if (i > 0)
+                --i;
+        }
+        else
+            ++i;
+    }
+}
+
+void ReteEngine::compileOperator(std::vector<Token> &tokens, char op)
+{
+    Kind kind = op == '+' ? AND : op == '|' ? OR : XOR;
+    size_t i = 0;
+    while (i < tokens.size())
+    {
+        if (tokens[i].type == static_cast<symbol_t>(op))
+        {
+            if (i == 0 || i + 1 == tokens.size())
+                throw std::logic_error(std::string("operator ") + op + " has no var attached\n");
+            int left = tokenNode(tokens[i - 1]);
+            int right = tokenNode(tokens[i + 1]);
+            tokens[i].type = 0;
+            tokens[i].node = makeNode(kind, left, right);
+            tokens.erase(tokens.begin() + i + 1);
+            tokens.erase(tokens.begin() + i - 1);
+            if (i > 0)
+                --i;
+        }
+        else
+            ++i;
+    }
+}
+
+int ReteEngine::compileBlock(std::vector<Token> &tokens)
+{
+    if (tokens.empty())
+        throw std::logic_error("TriBlock::execute: empty block");
+    compileNot(tokens);
+    compileOperator(tokens, '+');
+    compileOperator(tokens, '|');
+    compileOperator(tokens, '^');
+    if (tokens.size() != 1)
+        throw std::logic_error("TriBlock::execute: reduction did not converge");
+    return tokenNode(tokens[0]);
+}
+
+int ReteEngine::compileLeft(std::vector<Block> &blocks)
+{
+    // same block merging as Resolver::compileLeftTri, on nodes instead of steps
+    if (blocks.empty())
+        throw std::logic_error("resolveLeftTri: empty expression");
+    unsigned int max_priority = 0;
+    for (const Block &block : blocks)
+        max_priority = std::max(max_priority, block.priority);
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+        if (blocks[i].priority == max_priority)
+        {
+            Token result = {0, compileBlock(blocks[i].tokens)};
+            if (i != 0)
+            {
+                blocks[i - 1].tokens.push_back(result);
+                blocks.erase(blocks.begin() + i);
+            }
+            else if (blocks.size() > 1)
+            {
+                blocks[1].tokens.insert(blocks[1].tokens.begin(), result);
+                blocks.erase(blocks.begin());
+            }
+            else
+            {
+                blocks[i].tokens.assign(1, result);
+                blocks[i].priority = 0;
+            }
+        }
+    }
+    if (blocks.size() != 1 || blocks[0].tokens.size() > 1)
+        return compileLeft(blocks);
+    return tokenNode(blocks[0].tokens[0]);
+}
+
+int ReteEngine::compileRule(const BasicRule &rule)
+{
+    std::vector<Block> blocks;
+    for (const TokenBlock &lhs_block : rule.lhs)
+    {
+        Block block;
+        block.priority = lhs_block.getPriority();
+        for (const TokenEffect &token : lhs_block)
+            block.tokens.push_back(Token{token.type, -1});
+        blocks.push_back(block);
+    }
+    return compileLeft(blocks);
+}
+
+bool ReteEngine::rankNode(int id, std::vector<int> &state)
+{
+    if (state[id] == 2)
+        return true;
+    if (state[id] == 1)
+        return false;
+    state[id] = 1;
+    Node &node = nodes[id];
+    unsigned int rank = 0;
+    std::vector<int> inputs;
+    if (node.kind == SYMBOL)
+    {
+        for (size_t r : concluding[node.symbol])
+            inputs.push_back(rule_root[r]);
+    }
+    else
+    {
+        inputs.push_back(node.left);
+        if (node.right >= 0)
+            inputs.push_back(node.right);
+    }
+    for (int input : inputs)
+    {
+        if (!rankNode(input, state))
+            return false;
+        rank = std::max(rank, nodes[input].rank + 1);
+    }
+    node.rank = rank;
+    state[id] = 2;
+    return true;
+}
+
+bool ReteEngine::computeRanks()
+{
+    std::vector<int> state(nodes.size(), 0);
+    for (size_t id = 0; id < nodes.size(); ++id)
+    {
+        if (!rankNode(id, state))
+            return false;
+    }
+    return true;
+}
+
+void ReteEngine::compile(Parser &parser)
+{
+    compiled = &parser;
+    rules = &parser.getBasicRules();
+    nodes.clear();
+    shared.clear();
+    rule_root.clear();
+    facts.clear();
+    activations = 0;
+    symbol_node.reset();
+    is_fact.reset();
+    outcomes.reset();
+    concluding.reset();
+
+    for (size_t r = 0; r < rules->size(); ++r)
+    {
+        const BasicRule &rule = (*rules)[r];
+        rule_root.push_back(compileRule(rule));
+        nodes[rule_root.back()].rules.push_back(r);
+        symbolNode(rule.rhs_symbol);
+        concluding.at(rule.rhs_symbol).push_back(r);
+    }
+    acyclic = computeRanks();
+    if (!acyclic)
+        return;
+
+    // every value starts false, which no rule counts: settle them in rank order
+    std::vector<int> order(nodes.size());
+    for (size_t id = 0; id < nodes.size(); ++id)
+        order[id] = id;
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return nodes[a].rank < nodes[b].rank; });
+    for (int id : order)
+    {
+        Node &node = nodes[id];
+        rhr_value_e before = node.value;
+        node.value = evaluate(node);
+        for (size_t r : node.rules)
+            recount(r, before, node.value);
+    }
+}
+
+rhr_value_e ReteEngine::evaluate(const Node &node) const
+{
+    switch (node.kind)
+    {
+        case SYMBOL:
+        {
+            if (is_fact[node.symbol])
+                return R_TRUE;
+            // Resolver::finalizeOutcome on the counted rules
+            const Outcome &outcome = outcomes[node.symbol];
+            if (outcome.definite_true && outcome.definite_false)
+                return R_AMBIGOUS;
+            if (outcome.definite_true)
+                return R_TRUE;
+            if (outcome.definite_false)
+                return R_FALSE;
+            return outcome.ambiguous ? R_AMBIGOUS : R_FALSE;
+        }
+        case NOT:
+            return resolveNot(nodes[node.left].value);
+        case AND:
+            return resolveAnd(nodes[node.left].value, nodes[node.right].value);
+        case OR:
+            return resolveOr(nodes[node.left].value, nodes[node.right].value);
+        case XOR:
+            return resolveXor(nodes[node.left].value, nodes[node.right].value);
+    }
+    return R_FALSE;
+}
+
+void ReteEngine::recount(size_t rule, rhr_value_e before, rhr_value_e after)
+{
+    const BasicRule &basic = (*rules)[rule];
+    Outcome &outcome = outcomes.at(basic.rhs_symbol);
+    size_t &decided = basic.rhs_negated ? outcome.definite_false : outcome.definite_true;
+    if (before == R_TRUE)
+        --decided;
+    else if (before == R_AMBIGOUS)
+        --outcome.ambiguous;
+    if (after == R_TRUE)
+        ++decided;
+    else if (after == R_AMBIGOUS)
+        ++outcome.ambiguous;
+}
+
+void ReteEngine::propagate(symbol_t symbol)
+{
+    activations = 0;
+    int start = symbol_node[symbol];
+    if (!acyclic || start < 0)
+        return;
+    std::set<std::pair<unsigned int, int>> agenda;
+    agenda.insert(std::make_pair(nodes[start].rank, start));
+    while (!agenda.empty())
+    {
+        int id = agenda.begin()->second;
+        agenda.erase(agenda.begin());
+        ++activations;
+        Node &node = nodes[id];
+        rhr_value_e before = node.value;
+        node.value = evaluate(node);
+        if (node.value == before)
+            continue;
+        for (size_t r : node.rules)
+        {
+            recount(r, before, node.value);
+            int conclusion = symbol_node[(*rules)[r].rhs_symbol];
+            agenda.insert(std::make_pair(nodes[conclusion].rank, conclusion));
+        }
+        for (int next : node.successors)
+            agenda.insert(std::make_pair(nodes[next].rank, next));
+    }
+}
+
+bool ReteEngine::assertFact(symbol_t symbol)
+{
+    if (is_fact[symbol])
+        return false;
+    is_fact.at(symbol) = 1;
+    facts.insert(symbol);
+    propagate(symbol);
+    return true;
+}
+
+bool ReteEngine::retractFact(symbol_t symbol)
+{
+    if (!is_fact[symbol])
+        return false;
+    is_fact.at(symbol) = 0;
+    facts.erase(symbol);
+    propagate(symbol);
+    return true;
+}
+
+rhr_value_e ReteEngine::value(symbol_t symbol) const
+{
+    if (symbol_node[symbol] >= 0 && acyclic)
+        return nodes[symbol_node[symbol]].value;
+    return is_fact[symbol] ? R_TRUE : R_FALSE;
+}
+
+bool ReteEngine::solve(Parser &parser, const std::set<symbol_t> &new_facts, const std::set<symbol_t> &queries,
+                       std::map<symbol_t, rhr_value_e> &results)
+{
+    if (compiled != &parser)
+        compile(parser);
+    if (!acyclic)
+    {
+        if (!fallback)
+            fallback = Engine::create("table");
+        return fallback->solve(parser, new_facts, queries, results);
+    }
+    if (!parser.hasValidStateWithFacts(new_facts))
+        return false;
+
+    // only the changed facts travel through the network
+    std::set<symbol_t> current = facts;
+    for (symbol_t fact : current)
+    {
+        if (!new_facts.count(fact))
+            retractFact(fact);
+    }
+    for (symbol_t fact : new_facts)
+        assertFact(fact);
+
+    const TruthTable &table = parser.getCombinedTruthTable();
+    std::map<symbol_t, rhr_value_e> values;
+    for (symbol_t var : table.variables)
+        values[var] = value(var);
+    table.clampValues(facts, values);
+
+    results.clear();
+    for (symbol_t q : queries)
+    {
+        auto it = values.find(q);
+        results[q] = it != values.end() ? it->second : facts.count(q) ? R_TRUE : R_FALSE;
+    }
+    return true;
+}
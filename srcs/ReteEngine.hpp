@@ -0,0 +1,123 @@
+#pragma once
+
+#include <map>
+#include <tuple>
+#include "Engine.hpp"
+
+class BasicRule;
+
+/**
+ * Forward-chaining network for facts that keep changing. Every basic rule
+ * LHS is compiled, in the operator order of Resolver::compileLeftTri, into
+ * shared nodes: one alpha node per symbol, then negation and join nodes
+ * hash-consed so that common subexpressions exist once. Each node holds
+ * its tri-state value; asserting or retracting a fact only re-evaluates
+ * the nodes downstream of it, in rank order, before the combined table
+ * clamps the result as Resolver::evaluate does.
+ *
+ * Resolver answers cycles from the order it meets them in, which a network
+ * cannot follow: knowledge bases where a symbol depends on itself are
+ * answered by the table engine instead.
+ **/
+class ReteEngine : public Engine
+{
+public:
+    ReteEngine();
+
+    const char *name() const override { return "rete"; }
+    bool solve(Parser &parser, const std::set<symbol_t> &facts, const std::set<symbol_t> &queries,
+               std::map<symbol_t, rhr_value_e> &results) override;
+
+    /** build the network of the parser rules, with no fact asserted */
+    void compile(Parser &parser);
+    /** make symbol an initial fact, false when it already was one */
+    bool assertFact(symbol_t symbol);
+    /** make symbol a plain symbol again, false when it was not a fact */
+    bool retractFact(symbol_t symbol);
+    /** rule-based value of a symbol, before the truth table clamp */
+    rhr_value_e value(symbol_t symbol) const;
+    /** whether the network answers, false when the rules have a cycle */
+    bool isCompiled() const { return acyclic; }
+    size_t nodeCount() const { return nodes.size(); }
+    /** nodes re-evaluated by the last assert or retract */
+    size_t lastActivations() const { return activations; }
+
+private:
+    enum Kind
+    {
+        SYMBOL,
+        NOT,
+        AND,
+        OR,
+        XOR
+    };
+
+    struct Node
+    {
+        Kind kind;
+        symbol_t symbol;
+        int left;
+        int right;
+        rhr_value_e value;
+        /** evaluated after every input: 1 + the highest input rank */
+        unsigned int rank;
+        std::vector<int> successors;
+        /** rules whose whole LHS is this node */
+        std::vector<size_t> rules;
+    };
+
+    /** rules concluding a symbol, counted by what their LHS decides */
+    struct Outcome
+    {
+        size_t definite_true = 0;
+        size_t definite_false = 0;
+        size_t ambiguous = 0;
+    };
+
+    /** LHS token during compilation: an operator, or a node once valued */
+    struct Token
+    {
+        symbol_t type;
+        int node;
+    };
+
+    struct Block
+    {
+        unsigned int priority;
+        std::vector<Token> tokens;
+    };
+
+    const Parser *compiled;
+    bool acyclic;
+    const std::vector<BasicRule> *rules;
+    std::vector<Node> nodes;
+    /** node holding the whole LHS of each rule */
+    std::vector<int> rule_root;
+    /** rules concluding each symbol */
+    SymbolArray<std::vector<size_t>> concluding;
+    std::map<std::tuple<int, int, int>, int> shared;
+    SymbolArray<int> symbol_node;
+    SymbolArray<uint8_t> is_fact;
+    SymbolArray<Outcome> outcomes;
+    std::set<symbol_t> facts;
+    size_t activations;
+    std::unique_ptr<Engine> fallback;
+
+    int symbolNode(symbol_t symbol);
+    int makeNode(Kind kind, int left, int right);
+    int tokenNode(Token &token);
+    void compileNot(std::vector<Token> &tokens);
+    void compileOperator(std::vector<Token> &tokens, char op);
+    int compileBlock(std::vector<Token> &tokens);
+    int compileLeft(std::vector<Block> &blocks);
+    int compileRule(const BasicRule &rule);
+    /** rank every node, false when a symbol depends on itself */
+    bool computeRanks();
+    bool rankNode(int id, std::vector<int> &state);
+    /** value of a node from its inputs, or from its outcome for a symbol */
+    rhr_value_e evaluate(const Node &node) const;
+    /** move the contribution of a rule from one LHS value to another */
+    void recount(size_t rule, rhr_value_e before, rhr_value_e after);
+    /** re-evaluate the nodes downstream of a changed symbol, in rank order */
+    void propagate(symbol_t symbol);
+};
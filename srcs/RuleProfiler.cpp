@@ -0,0 +1,108 @@
+#include "RuleProfiler.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+
+void RuleProfiler::reset(size_t rule_count)
+{
+    costs.assign(rule_count, RuleCost());
+    frames.clear();
+}
+
+void RuleProfiler::beginRule()
+{
+    frames.push_back({Clock::now(), 0});
+}
+
+void RuleProfiler::endRule(uint32_t rule_id)
+{
+    Frame frame = frames.back();
+    frames.pop_back();
+    uint64_t elapsed = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - frame.start).count());
+    if (!frames.empty())
+        frames.back().nested_ns += elapsed;
+    RuleCost &cost = costs[rule_id];
+    ++cost.evaluations;
+    cost.total_ns += elapsed;
+    cost.self_ns += elapsed - std::min(elapsed, frame.nested_ns);
+}
+
+void RuleProfiler::recordJoins(const EngineStats &stats)
+{
+    if (costs.empty() || stats.joins.empty())
+        return;
+    costs[0].states_after = stats.joins[0].left_states;
+    costs[0].state_growth = static_cast<long long>(stats.joins[0].left_states);
+    for (size_t i = 0; i < stats.joins.size() && i + 1 < costs.size(); ++i)
+    {
+        const EngineStats::JoinStep &join = stats.joins[i];
+        RuleCost &cost = costs[i + 1];
+        cost.join_us = join.us;
+        cost.states_after = join.out_states;
+        cost.state_growth = static_cast<long long>(join.out_states) - static_cast<long long>(join.left_states);
+    }
+}
+
+static double costUs(const RuleProfiler::RuleCost &cost)
+{
+    return cost.self_ns / 1000.0 + cost.join_us;
+}
+
+void RuleProfiler::printTop(std::ostream &os, size_t top, const std::vector<BasicRule> &basic_rules,
+                            const std::vector<LogicRule> &rules, const std::vector<size_t> &sources) const
+{
+    std::vector<RuleCost> by_source(rules.size());
+    std::vector<size_t> basic_count(rules.size(), 0);
+    for (size_t i = 0; i < costs.size() && i < sources.size(); ++i)
+    {
+        RuleCost &sum = by_source[sources[i]];
+        sum.evaluations += costs[i].evaluations;
+        sum.total_ns += costs[i].total_ns;
+        sum.self_ns += costs[i].self_ns;
+        sum.join_us += costs[i].join_us;
+        sum.state_growth += costs[i].state_growth;
+        sum.states_after = std::max(sum.states_after, costs[i].states_after);
+        ++basic_count[sources[i]];
+    }
+
+    std::vector<size_t> order(rules.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return costUs(by_source[a]) > costUs(by_source[b]);
+    });
+
+    std::ios::fmtflags flags = os.flags();
+    os << std::fixed << std::setprecision(1);
+    os << "Rule profile: source rules by evaluation self time + join time (us)\n";
+    os << std::setw(6) << "line" << std::setw(8) << "basics" << std::setw(10) << "evals"
+       << std::setw(12) << "self_us" << std::setw(12) << "join_us" << std::setw(10) << "growth" << "  rule\n";
+    for (size_t k = 0; k < order.size() && k < top; ++k)
+    {
+        const RuleCost &cost = by_source[order[k]];
+        os << std::setw(6) << rules[order[k]].line << std::setw(8) << basic_count[order[k]]
+           << std::setw(10) << cost.evaluations << std::setw(12) << cost.self_ns / 1000.0
+           << std::setw(12) << cost.join_us << std::setw(10) << cost.state_growth
+           << "  " << rules[order[k]].toString() << "\n";
+    }
+
+    order.resize(costs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return costUs(costs[a]) > costUs(costs[b]);
+    });
+    os << "Basic rules\n";
+    os << std::setw(6) << "rule" << std::setw(6) << "line" << std::setw(10) << "evals"
+       << std::setw(12) << "self_us" << std::setw(12) << "total_us" << std::setw(12) << "join_us"
+       << std::setw(10) << "states" << std::setw(10) << "growth" << "  rule\n";
+    for (size_t k = 0; k < order.size() && k < top; ++k)
+    {
+        const RuleCost &cost = costs[order[k]];
+        unsigned int line = order[k] < sources.size() ? rules[sources[order[k]]].line : 0;
+        os << std::setw(6) << order[k] << std::setw(6) << line << std::setw(10) << cost.evaluations
+           << std::setw(12) << cost.self_ns / 1000.0 << std::setw(12) << cost.total_ns / 1000.0
+           << std::setw(12) << cost.join_us << std::setw(10) << cost.states_after
+           << std::setw(10) << cost.state_growth << "  " << basic_rules[order[k]].toString() << "\n";
+    }
+    os.flags(flags);
+}
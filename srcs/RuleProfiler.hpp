@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "BasicRule.hpp"
+#include "EngineStats.hpp"
+#include "LogicRule.hpp"
+
+/**
+ * Per-rule hot-spot profiler (--profile).
+ * Attributes rule evaluation time and counts in Resolver::prove, and truth
+ * table growth in conjunctionAll, to each BasicRule, then groups them by
+ * the source LogicRule they were deduced from.
+ **/
+class RuleProfiler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * Cost attributed to one BasicRule.
+     **/
+    struct RuleCost
+    {
+        uint64_t evaluations = 0;
+        /** time evaluating the rule, nested proves included */
+        uint64_t total_ns = 0;
+        /** time evaluating the rule minus the nested rule evaluations */
+        uint64_t self_ns = 0;
+        /** time of the join adding the rule table to the combined table */
+        double join_us = 0;
+        /** states of the combined table after the join, and the change it caused */
+        size_t states_after = 0;
+        long long state_growth = 0;
+    };
+
+    /**
+     * size the counters for a rule set, keeping nothing from a previous one.
+     **/
+    void reset(size_t rule_count);
+    /**
+     * start timing a rule evaluation, paired with endRule.
+     **/
+    void beginRule();
+    void endRule(uint32_t rule_id);
+    /**
+     * attribute the conjunctionAll joins recorded in stats, table i being
+     * the table of basic rule i.
+     **/
+    void recordJoins(const EngineStats &stats);
+    /**
+     * print the `top` most expensive source rules and basic rules.
+     **/
+    void printTop(std::ostream &os, size_t top, const std::vector<BasicRule> &basic_rules,
+                  const std::vector<LogicRule> &rules, const std::vector<size_t> &sources) const;
+
+private:
+    struct Frame
+    {
+        Clock::time_point start;
+        uint64_t nested_ns;
+    };
+
+    std::vector<RuleCost> costs;
+    std::vector<Frame> frames;
+};
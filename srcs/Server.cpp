@@ -0,0 +1,338 @@
+#include "Server.hpp"
+#include "QueryProtocol.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t g_stop_requested = 0;
+static int g_wake_fd = -1;
+
+static void onStopSignal(int)
+{
+    g_stop_requested = 1;
+    if (g_wake_fd >= 0)
+    {
+        char c = 's';
+        ssize_t ignored = write(g_wake_fd, &c, 1);
+        (void)ignored;
+    }
+}
+
+static bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+Server::Server(Parser &parser, const std::string &socket_path, unsigned int workers, ResultCache *cache,
+               const RequestBudget::Limits &limits)
+    : parser(parser), socket_path(socket_path), worker_count(workers ? workers : 1), cache(cache), limits(limits),
+      listen_fd(-1), wake_pipe{-1, -1}, next_client_id(0), stopping(false)
+{
+}
+
+Server::~Server()
+{
+    stopWorkers();
+    closeSocket();
+}
+
+bool Server::openSocket()
+{
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "Error: socket path too long: " << socket_path << std::endl;
+        return false;
+    }
+    std::strcpy(addr.sun_path, socket_path.c_str());
+
+    if (pipe(wake_pipe) != 0 || !setNonBlocking(wake_pipe[0]) || !setNonBlocking(wake_pipe[1]))
+    {
+        std::cerr << "Error: cannot create wake pipe: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+    {
+        std::cerr << "Error: cannot create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    unlink(socket_path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+        || listen(listen_fd, SOMAXCONN) != 0 || !setNonBlocking(listen_fd))
+    {
+        std::cerr << "Error: cannot listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Server::closeSocket()
+{
+    for (auto &entry : clients)
+        close(entry.second.fd);
+    clients.clear();
+    if (listen_fd >= 0)
+    {
+        close(listen_fd);
+        unlink(socket_path.c_str());
+        listen_fd = -1;
+    }
+    g_wake_fd = -1;
+    for (int &fd : wake_pipe)
+    {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+}
+
+void Server::startWorkers()
+{
+    for (unsigned int i = 0; i < worker_count; ++i)
+        workers.emplace_back(&Server::workerLoop, this);
+}
+
+void Server::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex);
+        stopping = true;
+    }
+    jobs_cv.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+    workers.clear();
+}
+
+void Server::workerLoop()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(jobs_mutex);
+            jobs_cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping)
+                return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        Done result = {job.client_id, job.seq, std::string()};
+        QueryProtocol::formatReply(QueryProtocol::answerLine(parser, job.line, std::string(), cache, limits), result.reply);
+        {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            done.push_back(std::move(result));
+        }
+        char c = 'd';
+        ssize_t ignored = write(wake_pipe[1], &c, 1);
+        (void)ignored;
+    }
+}
+
+void Server::acceptClients()
+{
+    while (true)
+    {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+            return;
+        if (!setNonBlocking(fd))
+        {
+            close(fd);
+            continue;
+        }
+        clients[next_client_id++].fd = fd;
+    }
+}
+
+bool Server::readClient(Client &client, uint64_t client_id)
+{
+    char buf[4096];
+    while (client.canQueue())
+    {
+        ssize_t n = read(client.fd, buf, sizeof(buf));
+        if (n > 0)
+        {
+            // split as it arrives, so that an endless line is refused at once
+            client.in.append(buf, static_cast<size_t>(n));
+            if (!queueLines(client, client_id))
+                return false;
+            continue;
+        }
+        if (n == 0)
+            client.eof = true;
+        else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            return false;
+        break;
+    }
+    return true;
+}
+
+bool Server::queueLines(Client &client, uint64_t client_id)
+{
+    size_t start = 0;
+    size_t end;
+    std::vector<Job> batch;
+    while (client.canQueue() && (end = client.in.find('\n', start)) != std::string::npos)
+    {
+        std::string line = client.in.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        start = end + 1;
+        if (line.empty())
+            continue;
+        batch.push_back({client_id, client.next_seq++, std::move(line)});
+    }
+    client.in.erase(0, start);
+    if (client.in.size() > MAX_LINE && client.in.find('\n') == std::string::npos)
+        return false;
+
+    if (!batch.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex);
+            for (Job &job : batch)
+                jobs.push_back(std::move(job));
+        }
+        jobs_cv.notify_all();
+    }
+    return true;
+}
+
+bool Server::writeClient(Client &client)
+{
+    std::map<uint64_t, std::string>::iterator it;
+    while ((it = client.ready.find(client.next_send)) != client.ready.end())
+    {
+        client.out += it->second;
+        client.ready.erase(it);
+        ++client.next_send;
+    }
+    while (!client.out.empty())
+    {
+        ssize_t n = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        client.out.erase(0, static_cast<size_t>(n));
+    }
+    return !(client.eof && client.next_send == client.next_seq && client.in.find('\n') == std::string::npos);
+}
+
+void Server::collectReplies()
+{
+    char buf[256];
+    while (read(wake_pipe[0], buf, sizeof(buf)) > 0)
+        ;
+    std::vector<Done> finished;
+    {
+        std::lock_guard<std::mutex> lock(done_mutex);
+        finished.swap(done);
+    }
+    for (Done &result : finished)
+    {
+        std::map<uint64_t, Client>::iterator it = clients.find(result.client_id);
+        if (it != clients.end())
+            it->second.ready[result.seq] = std::move(result.reply);
+    }
+}
+
+void Server::dropClient(uint64_t client_id)
+{
+    std::map<uint64_t, Client>::iterator it = clients.find(client_id);
+    if (it == clients.end())
+        return;
+    close(it->second.fd);
+    clients.erase(it);
+}
+
+int Server::run()
+{
+    if (!openSocket())
+        return 1;
+    g_stop_requested = 0;
+    g_wake_fd = wake_pipe[1];
+    struct sigaction sa;
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onStopSignal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    startWorkers();
+    std::cerr << "Serving on " << socket_path << " with " << worker_count << " workers" << std::endl;
+
+    std::vector<pollfd> fds;
+    std::vector<uint64_t> ids;
+    while (!g_stop_requested)
+    {
+        fds.clear();
+        ids.clear();
+        fds.push_back({listen_fd, POLLIN, 0});
+        fds.push_back({wake_pipe[0], POLLIN, 0});
+        for (const auto &entry : clients)
+        {
+            short events = entry.second.eof || !entry.second.canQueue() ? 0 : POLLIN;
+            if (!entry.second.out.empty())
+                events |= POLLOUT;
+            // a client waiting on its replies is left out, poll would keep reporting its hangup
+            fds.push_back({events ? entry.second.fd : -1, events, 0});
+            ids.push_back(entry.first);
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            std::cerr << "Error: poll failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        if (fds[1].revents & POLLIN)
+            collectReplies();
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            Client &client = clients[ids[i]];
+            short revents = fds[i + 2].revents;
+            bool keep = true;
+            if (revents & (POLLIN | POLLHUP))
+                keep = readClient(client, ids[i]);
+            if (revents & POLLERR)
+                keep = false;
+            if (keep)
+                keep = writeClient(client);
+            if (!keep)
+                dropClient(ids[i]);
+        }
+        // replies collected for clients without socket events, and the lines
+        // read ahead of them now that they have room
+        for (auto it = clients.begin(); it != clients.end();)
+        {
+            uint64_t id = it->first;
+            Client &client = it->second;
+            ++it;
+            bool keep = true;
+            if (client.ready.count(client.next_send))
+                keep = writeClient(client);
+            if (keep && client.canQueue())
+                keep = queueLines(client, id);
+            if (!keep)
+                dropClient(id);
+        }
+        if (fds[0].revents & POLLIN)
+            acceptClients();
+    }
+
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    stopWorkers();
+    closeSocket();
+    return 0;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RequestBudget.hpp"
+
+class Parser;
+class ResultCache;
+
+/**
+ * Daemon answering line protocol requests (see QueryProtocol) on a Unix
+ * domain socket. The knowledge base is parsed once by the caller; a poll()
+ * event loop owns every socket and a pool of workers evaluates requests.
+ * Replies are sent back to each client in request order. Workers share
+ * an optional ResultCache, so polling clients skip the resolver. Each
+ * request is resolved within limits, or the tighter limits it asks for.
+ **/
+class Server
+{
+public:
+    Server(Parser &parser, const std::string &socket_path, unsigned int workers, ResultCache *cache = nullptr,
+           const RequestBudget::Limits &limits = RequestBudget::Limits());
+    ~Server();
+    /**
+     * Serve until SIGINT/SIGTERM, return the process exit code.
+     **/
+    int run();
+
+private:
+    /** request waiting for a worker */
+    struct Job
+    {
+        uint64_t client_id;
+        uint64_t seq;
+        std::string line;
+    };
+
+    /** reply computed by a worker */
+    struct Done
+    {
+        uint64_t client_id;
+        uint64_t seq;
+        std::string reply;
+    };
+
+    struct Client
+    {
+        int fd;
+        std::string in;
+        std::string out;
+        /** sequence number of the next request read */
+        uint64_t next_seq = 0;
+        /** sequence number of the next reply to send */
+        uint64_t next_send = 0;
+        /** replies computed out of order */
+        std::map<uint64_t, std::string> ready;
+        /** peer closed its side, drop the client once every reply is sent */
+        bool eof = false;
+
+        /** room for another request: few enough unanswered, and replies being read */
+        bool canQueue() const { return next_seq - next_send < MAX_QUEUED && out.size() < MAX_LINE; }
+    };
+
+    static const size_t MAX_LINE = 1 << 16;
+    /** requests of one client read but not answered; it is not read while at the limit */
+    static const uint64_t MAX_QUEUED = 64;
+
+    Parser &parser;
+    std::string socket_path;
+    unsigned int worker_count;
+    /** answers shared by the workers, not owned, null when disabled */
+    ResultCache *cache;
+    /** budget of every request */
+    RequestBudget::Limits limits;
+    int listen_fd;
+    /** workers write a byte here when a reply is ready */
+    int wake_pipe[2];
+    uint64_t next_client_id;
+    std::map<uint64_t, Client> clients;
+
+    std::vector<std::thread> workers;
+    std::mutex jobs_mutex;
+    std::condition_variable jobs_cv;
+    std::deque<Job> jobs;
+    bool stopping;
+    std::mutex done_mutex;
+    std::vector<Done> done;
+
+    bool openSocket();
+    void closeSocket();
+    void startWorkers();
+    void stopWorkers();
+    void workerLoop();
+    void acceptClients();
+    /**
+     * Read available bytes while the client has room, false if the client must be dropped.
+     **/
+    bool readClient(Client &client, uint64_t client_id);
+    /**
+     * Queue the complete lines read while the client has room, false if the
+     * rest holds a line over MAX_LINE.
+     **/
+    bool queueLines(Client &client, uint64_t client_id);
+    /**
+     * Write pending replies, false if the client must be dropped.
+     **/
+    bool writeClient(Client &client);
+    void collectReplies();
+    void dropClient(uint64_t client_id);
+};
@@ -0,0 +1,113 @@
+#include "StateIndex.hpp"
+#include "MemoryAccounting.hpp"
+#include "TruthTable.hpp"
+
+StateIndex::StateIndex() : column_of(-1)
+{
+}
+
+StateIndex::StateIndex(const TruthTable &table) : StateIndex()
+{
+    state_count = table.valid_states.size();
+    size_t words = (state_count + 63) / 64;
+    all_states.assign(words, ~static_cast<uint64_t>(0));
+    if (state_count % 64)
+        all_states.back() = (static_cast<uint64_t>(1) << (state_count % 64)) - 1;
+
+    for (symbol_t var : table.variables)
+    {
+        column_of.at(var) = columns.size();
+        columns.push_back(Column{Bitmap(words, 0), Bitmap(words, 0)});
+    }
+
+    size_t id = 0;
+    for (const VariableState &state : table.valid_states)
+    {
+        uint64_t bit = static_cast<uint64_t>(1) << (id % 64);
+        for (const auto &value : state.values)
+        {
+            int index = column_of[value.first];
+            if (index < 0)
+                continue;
+            Column &col = columns[index];
+            (value.second ? col.is_true : col.is_false)[id / 64] |= bit;
+        }
+        ++id;
+    }
+}
+
+const StateIndex::Column *StateIndex::column(symbol_t var) const
+{
+    int index = column_of[var];
+    if (index < 0)
+        return nullptr;
+    return &columns[index];
+}
+
+StateIndex::Bitmap StateIndex::filter(const std::map<symbol_t, bool> &known) const
+{
+    Bitmap states = all_states;
+    for (const auto &fact : known)
+        restrict(states, fact.first, fact.second);
+    return states;
+}
+
+void StateIndex::restrict(Bitmap &states, symbol_t var, bool value) const
+{
+    const Column *col = column(var);
+    if (!col)
+        return;
+    // drop the states holding the opposite value, keep those without any
+    const Bitmap &conflicting = value ? col->is_false : col->is_true;
+    for (size_t i = 0; i < states.size(); ++i)
+        states[i] &= ~conflicting[i];
+}
+
+StateIndex::Bitmap StateIndex::filterByResults(const std::set<symbol_t> &initial_facts,
+                                               const std::map<symbol_t, rhr_value_e> &base_results) const
+{
+    return filter(TruthTable::knownValues(initial_facts, base_results));
+}
+
+bool StateIndex::canBe(const Bitmap &states, symbol_t var, bool value) const
+{
+    const Column *col = column(var);
+    if (!col)
+        return false;
+    const Bitmap &holding = value ? col->is_true : col->is_false;
+    for (size_t i = 0; i < states.size(); ++i)
+    {
+        if (states[i] & holding[i])
+            return true;
+    }
+    return false;
+}
+
+rhr_value_e StateIndex::clampValue(const Bitmap &states, symbol_t var, rhr_value_e current) const
+{
+    bool can_be_true = canBe(states, var, true);
+    bool can_be_false = canBe(states, var, false);
+    if (can_be_true && !can_be_false)
+        return R_TRUE;
+    if (can_be_false && !can_be_true)
+        return R_FALSE;
+    return current;
+}
+
+bool StateIndex::any(const Bitmap &states)
+{
+    for (uint64_t word : states)
+    {
+        if (word)
+            return true;
+    }
+    return false;
+}
+
+size_t StateIndex::memoryBytes() const
+{
+    size_t bytes = MemoryAccounting::vectorBytes(all_states) + MemoryAccounting::vectorBytes(columns);
+    for (const Column &col : columns)
+        bytes += MemoryAccounting::vectorBytes(col.is_true) + MemoryAccounting::vectorBytes(col.is_false);
+    return bytes;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+#include "ReasoningTypes.hpp"
+
+struct TruthTable;
+
+/**
+ * Columnar view of a truth table: the states are numbered in table order
+ * and each (variable, value) pair owns the bitmap of the states holding it.
+ * A set of states is itself a bitmap, so filtering by facts is an
+ * intersection and no state is copied. A state without a value for a
+ * variable is in neither of its bitmaps, as in TruthTable::filterByFacts.
+ **/
+class StateIndex
+{
+public:
+    typedef std::vector<uint64_t> Bitmap;
+
+    StateIndex();
+    explicit StateIndex(const TruthTable &table);
+
+    /** number of indexed states */
+    size_t stateCount() const { return state_count; }
+    /** bitmap of every indexed state */
+    const Bitmap &all() const { return all_states; }
+    /** states compatible with the known values (variables outside the table are ignored) */
+    Bitmap filter(const std::map<symbol_t, bool> &known) const;
+    /** keep in states only those compatible with var = value */
+    void restrict(Bitmap &states, symbol_t var, bool value) const;
+    /** states compatible with the initial facts and the decided base results */
+    Bitmap filterByResults(const std::set<symbol_t> &initial_facts, const std::map<symbol_t, rhr_value_e> &base_results) const;
+    /** check if var can take value in one of the states */
+    bool canBe(const Bitmap &states, symbol_t var, bool value) const;
+    /** clamp a tri-state value to the only value var takes in the states, if any */
+    rhr_value_e clampValue(const Bitmap &states, symbol_t var, rhr_value_e current) const;
+    /** check if a bitmap holds at least one state */
+    static bool any(const Bitmap &states);
+
+    /** estimated heap bytes held by the bitmaps */
+    size_t memoryBytes() const;
+
+private:
+    struct Column
+    {
+        Bitmap is_true;
+        Bitmap is_false;
+    };
+
+    size_t state_count = 0;
+    Bitmap all_states;
+    std::vector<Column> columns;
+    /** column of each symbol, -1 when absent from the table */
+    SymbolArray<int> column_of;
+
+    const Column *column(symbol_t var) const;
+};
@@ -0,0 +1,136 @@
+#include "SymbolTable.hpp"
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+    std::mutex g_mutex;
+    /** names of the codes from FIRST_NAMED on */
+    std::vector<std::string> g_names;
+    std::unordered_map<std::string, symbol_t> g_codes;
+    std::atomic<symbol_t> g_limit(SymbolTable::FIRST_NAMED);
+
+    bool isCapital(char c)
+    {
+        return c >= 'A' && c <= 'Z';
+    }
+}
+
+bool SymbolTable::isIdentifierChar(char c)
+{
+    return isCapital(c) || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+symbol_t SymbolTable::intern(const std::string &name)
+{
+    if (name.size() == 1 && isCapital(name[0]))
+        return static_cast<symbol_t>(name[0]);
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto it = g_codes.find(name);
+    if (it != g_codes.end())
+        return it->second;
+    symbol_t symbol = FIRST_NAMED + g_names.size();
+    g_names.push_back(name);
+    g_codes.emplace(name, symbol);
+    g_limit.store(symbol + 1);
+    return symbol;
+}
+
+bool SymbolTable::find(const std::string &name, symbol_t &symbol)
+{
+    if (name.size() == 1 && isCapital(name[0]))
+    {
+        symbol = static_cast<symbol_t>(name[0]);
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(g_mutex);
+    auto it = g_codes.find(name);
+    if (it == g_codes.end())
+        return false;
+    symbol = it->second;
+    return true;
+}
+
+std::string SymbolTable::name(symbol_t symbol)
+{
+    if (symbol < FIRST_NAMED)
+        return std::string(1, static_cast<char>(symbol));
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if (symbol - FIRST_NAMED >= g_names.size())
+        return "?";
+    return g_names[symbol - FIRST_NAMED];
+}
+
+symbol_t SymbolTable::limit()
+{
+    return g_limit.load();
+}
+
+bool SymbolTable::splitRun(const std::string &run, std::vector<symbol_t> &symbols, bool intern_names)
+{
+    if (run.empty() || (run[0] >= '0' && run[0] <= '9'))
+        return false;
+    bool capitals = true;
+    for (char c : run)
+    {
+        if (!isIdentifierChar(c))
+            return false;
+        capitals = capitals && isCapital(c);
+    }
+    if (capitals)
+    {
+        for (char c : run)
+            symbols.push_back(static_cast<symbol_t>(c));
+        return true;
+    }
+    symbol_t symbol;
+    if (intern_names)
+        symbol = intern(run);
+    else if (!find(run, symbol))
+        return false;
+    symbols.push_back(symbol);
+    return true;
+}
+
+bool SymbolTable::parseList(const std::string &text, std::vector<symbol_t> &symbols, std::string &error,
+                            bool intern_names)
+{
+    size_t i = 0;
+    while (i < text.size() && text[i] != '#')
+    {
+        if (text[i] == ' ' || text[i] == '\t' || text[i] == '\r')
+        {
+            ++i;
+            continue;
+        }
+        size_t end = i;
+        while (end < text.size() && isIdentifierChar(text[end]))
+            ++end;
+        if (end == i)
+        {
+            error = std::string(1, text[i]);
+            return false;
+        }
+        std::string run = text.substr(i, end - i);
+        if (!splitRun(run, symbols, intern_names))
+        {
+            error = run;
+            return false;
+        }
+        i = end;
+    }
+    return true;
+}
+
+std::string SymbolTable::formatList(const std::vector<symbol_t> &symbols)
+{
+    std::string text;
+    for (size_t i = 0; i < symbols.size(); ++i)
+    {
+        if (i > 0 && (symbols[i] >= FIRST_NAMED || symbols[i - 1] >= FIRST_NAMED))
+            text.push_back(' ');
+        text += name(symbols[i]);
+    }
+    return text;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Code of a symbol: a capital letter is its own character code, so the
+ * classic single-letter knowledge bases keep their order and behaviour;
+ * multi-character identifiers get dense codes from FIRST_NAMED on. Token
+ * types share the space: operators keep their character codes below
+ * FIRST_NAMED.
+ **/
+typedef uint32_t symbol_t;
+
+/**
+ * Process-wide interned names of the symbols. Interning happens while
+ * parsing; evaluation compares and indexes codes only, names are read
+ * back when printing. All members are thread-safe.
+ **/
+class SymbolTable
+{
+public:
+    static const symbol_t FIRST_NAMED = 128;
+
+    static bool isSymbol(symbol_t symbol) { return (symbol >= 'A' && symbol <= 'Z') || symbol >= FIRST_NAMED; }
+    /** letters, digits and '_', the characters of an identifier */
+    static bool isIdentifierChar(char c);
+    /** code of a name, interned on first use */
+    static symbol_t intern(const std::string &name);
+    /** code of an already interned name, false when unknown */
+    static bool find(const std::string &name, symbol_t &symbol);
+    static std::string name(symbol_t symbol);
+    /** one past the largest code in use */
+    static symbol_t limit();
+    /**
+     * Symbols of a run of identifier characters: a run of capital letters
+     * is one symbol per letter (as in =ABC), any other run is one named
+     * symbol, which must not start with a digit. False on a bad run.
+     **/
+    static bool splitRun(const std::string &run, std::vector<symbol_t> &symbols, bool intern_names = true);
+    /**
+     * Symbols of a fact or query list ("ABC", "A B pump_on"), ending at
+     * '#'; names not interned yet are reported as errors when intern_names
+     * is false. False with error on any other character.
+     **/
+    static bool parseList(const std::string &text, std::vector<symbol_t> &symbols, std::string &error,
+                          bool intern_names = true);
+    /** inverse of parseList: letters concatenated, named symbols set apart by a space */
+    static std::string formatList(const std::vector<symbol_t> &symbols);
+};
+
+/**
+ * Array indexed by symbol code that grows on write, for the per-symbol
+ * tables of the evaluators. Reads past the end give the absent value.
+ **/
+template <class T>
+class SymbolArray
+{
+public:
+    explicit SymbolArray(const T &absent = T()) : absent(absent) {}
+
+    const T &operator[](symbol_t symbol) const { return symbol < values.size() ? values[symbol] : absent; }
+    T &at(symbol_t symbol)
+    {
+        if (symbol >= values.size())
+            values.resize(symbol + 1, absent);
+        return values[symbol];
+    }
+    /** forget every entry, keeping the memory */
+    void reset() { values.assign(values.size(), absent); }
+    size_t size() const { return values.size(); }
+
+private:
+    std::vector<T> values;
+    T absent;
+};
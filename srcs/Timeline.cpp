@@ -0,0 +1,164 @@
+#include "Timeline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    enum EventKind : uint8_t
+    {
+        EV_PHASE,
+        EV_JOIN,
+        EV_PROVE
+    };
+
+    struct Event
+    {
+        const char *name;
+        uint64_t start;
+        uint64_t duration;
+        uint32_t left_states;
+        uint32_t right_states;
+        uint32_t out_states;
+        uint16_t depth;
+        uint8_t kind;
+        symbol_t sym;
+        uint8_t result;
+    };
+
+    struct Ring
+    {
+        unsigned int tid;
+        std::vector<Event> events;
+        /** total number of events ever recorded, the ring keeps the last ones */
+        uint64_t count = 0;
+    };
+
+    std::mutex g_rings_mutex;
+    std::vector<std::shared_ptr<Ring>> g_rings;
+    size_t g_capacity = 0;
+
+    Ring &threadRing()
+    {
+        // the registry keeps rings alive after their thread exits
+        thread_local std::shared_ptr<Ring> ring;
+        if (!ring)
+        {
+            ring = std::make_shared<Ring>();
+            std::lock_guard<std::mutex> lock(g_rings_mutex);
+            ring->tid = static_cast<unsigned int>(g_rings.size() + 1);
+            ring->events.resize(g_capacity);
+            g_rings.push_back(ring);
+        }
+        return *ring;
+    }
+
+    Event &nextEvent(uint8_t kind, const char *name, uint64_t start)
+    {
+        uint64_t end = Timeline::now();
+        Ring &ring = threadRing();
+        Event &ev = ring.events[ring.count++ % ring.events.size()];
+        ev.kind = kind;
+        ev.name = name;
+        ev.start = start;
+        ev.duration = end - start;
+        return ev;
+    }
+
+    uint32_t clampCount(size_t n)
+    {
+        return n > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(n);
+    }
+
+    const char *resultName(uint8_t result)
+    {
+        return result == R_TRUE ? "true" : result == R_FALSE ? "false" : "ambiguous";
+    }
+}
+
+std::atomic<bool> Timeline::enabled(false);
+
+void Timeline::enable(size_t capacity)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_rings_mutex);
+        g_capacity = capacity ? capacity : 1;
+    }
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+uint64_t Timeline::now()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Timeline::recordPhase(const char *name, uint64_t start)
+{
+    nextEvent(EV_PHASE, name, start);
+}
+
+void Timeline::recordJoin(uint64_t start, size_t left_states, size_t right_states, size_t out_states)
+{
+    Event &ev = nextEvent(EV_JOIN, "conjunction", start);
+    ev.left_states = clampCount(left_states);
+    ev.right_states = clampCount(right_states);
+    ev.out_states = clampCount(out_states);
+}
+
+void Timeline::recordProve(uint64_t start, symbol_t sym, rhr_value_e result, unsigned int depth)
+{
+    Event &ev = nextEvent(EV_PROVE, "prove", start);
+    ev.sym = sym;
+    ev.result = static_cast<uint8_t>(result);
+    ev.depth = static_cast<uint16_t>(depth > UINT16_MAX ? UINT16_MAX : depth);
+}
+
+bool Timeline::write(const std::string &path)
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+
+    std::lock_guard<std::mutex> lock(g_rings_mutex);
+    uint64_t origin = UINT64_MAX;
+    uint64_t dropped = 0;
+    for (const std::shared_ptr<Ring> &ring : g_rings)
+    {
+        uint64_t kept = std::min<uint64_t>(ring->count, ring->events.size());
+        dropped += ring->count - kept;
+        for (uint64_t i = ring->count - kept; i < ring->count; ++i)
+            origin = std::min(origin, ring->events[i % ring->events.size()].start);
+    }
+
+    out << "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":" << dropped << "},\"traceEvents\":[";
+    bool first = true;
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    for (const std::shared_ptr<Ring> &ring : g_rings)
+    {
+        uint64_t kept = std::min<uint64_t>(ring->count, ring->events.size());
+        for (uint64_t i = ring->count - kept; i < ring->count; ++i)
+        {
+            const Event &ev = ring->events[i % ring->events.size()];
+            out << (first ? "\n" : ",\n");
+            first = false;
+            out << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->tid << ",\"ts\":" << (ev.start - origin) / 1000.0
+                << ",\"dur\":" << ev.duration / 1000.0;
+            if (ev.kind == EV_PROVE)
+                out << ",\"cat\":\"resolver\",\"name\":\"prove " << SymbolTable::name(ev.sym) << "\",\"args\":{\"sym\":\""
+                    << SymbolTable::name(ev.sym)
+                    << "\",\"result\":\"" << resultName(ev.result) << "\",\"depth\":" << ev.depth << "}}";
+            else if (ev.kind == EV_JOIN)
+                out << ",\"cat\":\"truth_table\",\"name\":\"" << ev.name << "\",\"args\":{\"in\":[" << ev.left_states
+                    << "," << ev.right_states << "],\"out\":" << ev.out_states << "}}";
+            else
+                out << ",\"cat\":\"phase\",\"name\":\"" << ev.name << "\"}";
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
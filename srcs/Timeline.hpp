@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "ReasoningTypes.hpp"
+
+/**
+ * Execution timeline in the Chrome trace-event format (--timeline), readable
+ * by chrome://tracing and Perfetto.
+ *
+ * Every thread records complete events ("ph":"X") into its own fixed-size
+ * ring buffer, allocated on its first event; when a ring is full the oldest
+ * events are overwritten and counted as dropped. Recording takes no lock, so
+ * the only cost while disabled is one relaxed atomic load per call site.
+ *
+ * Event kinds:
+ *   phase  a named pipeline phase (parser, expansion, resolution steps)
+ *   join   one TruthTable::conjunction, args {in: [left, right], out}
+ *   prove  one Resolver::prove, args {sym, result, depth}
+ **/
+class Timeline
+{
+public:
+    /**
+     * start recording, each thread keeping at most `capacity` events.
+     **/
+    static void enable(size_t capacity = 1 << 18);
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    /** monotonic time in nanoseconds */
+    static uint64_t now();
+
+    static void recordPhase(const char *name, uint64_t start);
+    static void recordJoin(uint64_t start, size_t left_states, size_t right_states, size_t out_states);
+    static void recordProve(uint64_t start, symbol_t sym, rhr_value_e result, unsigned int depth);
+
+    /**
+     * write the events of every thread to a JSON file, return false on failure.
+     * Threads must not be recording while it runs.
+     **/
+    static bool write(const std::string &path);
+
+    /**
+     * Records a phase event covering its own lifetime.
+     **/
+    class Span
+    {
+    public:
+        explicit Span(const char *name) : name(name), start(isEnabled() ? now() : 0) {}
+        ~Span()
+        {
+            if (start)
+                recordPhase(name, start);
+        }
+        Span(const Span &) = delete;
+        Span &operator=(const Span &) = delete;
+
+    private:
+        const char *name;
+        uint64_t start;
+    };
+
+private:
+    static std::atomic<bool> enabled;
+};
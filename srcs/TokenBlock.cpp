@@ -1,4 +1,5 @@
 #include "TokenBlock.hpp"
+#include "MemoryAccounting.hpp"
 #include <stdexcept>
 #include <iostream>
 #include <sstream>
@@ -7,7 +8,7 @@ TokenBlock::TokenBlock(unsigned int priority) : priority(priority)
 {
 }
 
-TokenBlock::TokenBlock(unsigned int priority, char initial) : priority(priority)
+TokenBlock::TokenBlock(unsigned int priority, symbol_t initial) : priority(priority)
 {
     this->emplace_back(TokenEffect(initial));
 }
@@ -21,13 +22,13 @@ void TokenBlock::executeNot()
     size_t i = 0;
     while (i < (*this).size())
     {
-        char op = (*this)[i].type;
+        symbol_t op = (*this)[i].type;
         if (op == '!')
         {
             if (i + 1 == (*this).size())
                 throw std::logic_error("operator ! has no var attached\n");
-            char rn = (*this)[i + 1].type;
-            if ((rn >= 'A' && rn <= 'Z') || rn == 0)
+            symbol_t rn = (*this)[i + 1].type;
+            if (SymbolTable::isSymbol(rn) || rn == 0)
             {
                 (*this)[i + 1].effect = !(*this)[i + 1].effect;
                 (*this)[i + 1].type = 0;
@@ -63,16 +64,15 @@ void TokenBlock::executeOthers(char op_target, bool (TokenBlock::*func_op)(bool,
     size_t i = 0;
     while (i < (*this).size())
     {
-        char op = (*this)[i].type;
-        if (op == op_target)
+        symbol_t op = (*this)[i].type;
+        if (op == static_cast<symbol_t>(op_target))
         {
             if (i == 0 || i + 1 == (*this).size())
                 throw std::logic_error(std::string("operator ") + op_target + " has no var attached\n");
 
-            char ln = (*this)[i - 1].type;
-            char rn = (*this)[i + 1].type;
-            if (((ln >= 'A' && ln <= 'Z') || ln == 0) &&
-                ((rn >= 'A' && rn <= 'Z') || rn == 0))
+            symbol_t ln = (*this)[i - 1].type;
+            symbol_t rn = (*this)[i + 1].type;
+            if ((SymbolTable::isSymbol(ln) || ln == 0) && (SymbolTable::isSymbol(rn) || rn == 0))
             {
                 (*this)[i].effect = (this->*func_op)((*this)[i - 1].effect, (*this)[i + 1].effect);
                 (*this)[i].type = 0;
@@ -82,7 +82,7 @@ void TokenBlock::executeOthers(char op_target, bool (TokenBlock::*func_op)(bool,
                     --i;
             }
             else
-                throw std::logic_error(std::string("operator ") + op + " has no var attached\n");
+                throw std::logic_error(std::string("operator ") + op_target + " has no var attached\n");
         }
         else
             ++i;
@@ -134,7 +134,7 @@ bool TokenBlock::hasOperator(char op) const
 {
     for (const TokenEffect &tk : *this)
     {
-        if (tk.type == op)
+        if (tk.type == static_cast<symbol_t>(op))
             return true;
     }
     return false;
@@ -146,7 +146,7 @@ bool TokenBlock::hasAnyOperator(const std::vector<char> &ops) const
     {
         for (char op : ops)
         {
-            if (tk.type == op)
+            if (tk.type == static_cast<symbol_t>(op))
                 return true;
         }
     }
@@ -168,13 +168,21 @@ std::string TokenBlock::structureToString() const
         const TokenEffect &tk = (*this)[i];
         if (tk.type == 0)
             oss << "(null)";
-        else if (tk.type >= 'A' && tk.type <= 'Z')
-            oss << "'" << tk.type << "'";
+        else if (SymbolTable::isSymbol(tk.type))
+            oss << "'" << SymbolTable::name(tk.type) << "'";
         else
-            oss << "op(" << tk.type << ")";
+            oss << "op(" << static_cast<char>(tk.type) << ")";
         
         if (i + 1 < this->size())
             oss << " ";
     }
     return oss.str();
-}
\ No newline at end of file
+}
+
+size_t TokenBlock::memoryBytes(const std::vector<TokenBlock> &side)
+{
+    size_t bytes = MemoryAccounting::vectorBytes(side);
+    for (const TokenBlock &block : side)
+        bytes += MemoryAccounting::vectorBytes<TokenEffect>(block);
+    return bytes;
+}
@@ -35,7 +35,7 @@ private:
 
 public:
     TokenBlock(unsigned int priority);
-    TokenBlock(unsigned int priority, char initial);
+    TokenBlock(unsigned int priority, symbol_t initial);
     ~TokenBlock();
     /**
      * resolve the whole token block
@@ -67,4 +67,8 @@ public:
      * Get a debug string showing the structure of this block
      */
     std::string structureToString() const;
+    /**
+     * Estimated heap bytes held by the tokens of a side (vector of blocks)
+     */
+    static size_t memoryBytes(const std::vector<TokenBlock> &side);
 };
@@ -1,7 +1,7 @@
 #include "TokenEffect.hpp"
 
 
-TokenEffect::TokenEffect(char type): type(type)
+TokenEffect::TokenEffect(symbol_t type): type(type)
 {
 }
 
@@ -1,15 +1,17 @@
 #pragma once
 
+#include "SymbolTable.hpp"
+
 /**
  * Represent a token.
- * Can be a fact [A-Z] or an effect (|+^=)
+ * Can be a fact (a symbol, see SymbolTable) or an effect (|+^=)
  */
 class TokenEffect
 {
 private:
 public:
-	char type;
+	symbol_t type;
 	bool effect = false;
-	TokenEffect(char type);
+	TokenEffect(symbol_t type);
 	~TokenEffect();
 };
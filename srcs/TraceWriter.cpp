@@ -0,0 +1,333 @@
+#include "TraceWriter.hpp"
+#include "LogicRule.hpp"
+#include <charconv>
+#include <cstring>
+
+static const char *statusName(RuleStatus status)
+{
+    switch (status)
+    {
+        case RuleStatus::FIRED_TRUE: return "fired_true";
+        case RuleStatus::FIRED_FALSE: return "fired_false";
+        case RuleStatus::NOT_FIRED: return "not_fired";
+        case RuleStatus::AMBIGUOUS_CYCLE: return "ambiguous_cycle";
+        case RuleStatus::AMBIGUOUS_DEPENDS: return "ambiguous_depends";
+    }
+    return "unknown";
+}
+
+static const char *valueName(rhr_value_e value)
+{
+    if (value == R_TRUE)
+        return "true";
+    if (value == R_FALSE)
+        return "false";
+    return "ambiguous";
+}
+
+TraceWriter::TraceWriter() : format(JSONL), run(0)
+{
+}
+
+TraceWriter::~TraceWriter()
+{
+    flush();
+}
+
+bool TraceWriter::parseFormat(const std::string &name, Format &format)
+{
+    if (name == "jsonl")
+        format = JSONL;
+    else if (name == "bin")
+        format = BINARY;
+    else
+        return false;
+    return true;
+}
+
+bool TraceWriter::open(const std::string &path, Format fmt)
+{
+    format = fmt;
+    out.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    buffer.reserve(BUFFER_SIZE);
+    if (format == BINARY)
+        putLiteral("EXTRACE1");
+    return true;
+}
+
+bool TraceWriter::isOpen() const
+{
+    return out.is_open();
+}
+
+void TraceWriter::flush()
+{
+    if (!out.is_open() || buffer.empty())
+        return;
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.flush();
+    buffer.clear();
+}
+
+void TraceWriter::reserve(size_t n)
+{
+    if (buffer.size() + n > BUFFER_SIZE)
+    {
+        out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+}
+
+void TraceWriter::put(char c)
+{
+    reserve(1);
+    buffer.push_back(c);
+}
+
+void TraceWriter::put(const char *s, size_t n)
+{
+    if (n > BUFFER_SIZE)
+    {
+        flush();
+        out.write(s, static_cast<std::streamsize>(n));
+        return;
+    }
+    reserve(n);
+    buffer.insert(buffer.end(), s, s + n);
+}
+
+void TraceWriter::putString(const std::string &s)
+{
+    put(s.data(), s.size());
+}
+
+void TraceWriter::putU16(uint16_t v)
+{
+    char bytes[2] = {static_cast<char>(v & 0xff), static_cast<char>(v >> 8)};
+    put(bytes, 2);
+}
+
+void TraceWriter::putU32(uint32_t v)
+{
+    if (format == JSONL)
+    {
+        char digits[16];
+        std::to_chars_result res = std::to_chars(digits, digits + sizeof(digits), v);
+        put(digits, static_cast<size_t>(res.ptr - digits));
+        return;
+    }
+    char bytes[4];
+    for (int i = 0; i < 4; ++i)
+        bytes[i] = static_cast<char>((v >> (8 * i)) & 0xff);
+    put(bytes, 4);
+}
+
+void TraceWriter::putJsonString(const std::string &s)
+{
+    put('"');
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            put('\\');
+            put(c);
+        }
+        else if (c == '\n')
+            putLiteral("\\n");
+        else if (c == '\t')
+            putLiteral("\\t");
+        else if (c == '\r')
+            putLiteral("\\r");
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            static const char hex[] = "0123456789abcdef";
+            putLiteral("\\u00");
+            put(hex[c >> 4]);
+            put(hex[c & 0xf]);
+        }
+        else
+            put(c);
+    }
+    put('"');
+}
+
+void TraceWriter::putSymbol(symbol_t q)
+{
+    if (q < SymbolTable::FIRST_NAMED)
+    {
+        put(static_cast<char>(q));
+        return;
+    }
+    // identifier characters never need escaping
+    std::string name = SymbolTable::name(q);
+    if (format == BINARY)
+    {
+        put('\xff');
+        putU16(static_cast<uint16_t>(name.size()));
+    }
+    putString(name);
+}
+
+void TraceWriter::putJsonHead(const char *ev, symbol_t q)
+{
+    putLiteral("{\"ev\":\"");
+    put(ev, std::strlen(ev));
+    putLiteral("\",\"run\":");
+    putU32(run);
+    putLiteral(",\"sym\":\"");
+    putSymbol(q);
+    put('"');
+}
+
+void TraceWriter::writeRuleTable(const std::vector<BasicRule> &rules)
+{
+    for (uint32_t i = 0; i < rules.size(); ++i)
+    {
+        std::string text = rules[i].toString();
+        std::string origin = rules[i].origin ? rules[i].origin->toString() : std::string();
+        if (format == JSONL)
+        {
+            putLiteral("{\"ev\":\"rule_def\",\"rule\":");
+            putU32(i);
+            putLiteral(",\"text\":");
+            putJsonString(text);
+            putLiteral(",\"origin\":");
+            putJsonString(origin);
+            putLiteral("}\n");
+        }
+        else
+        {
+            put(static_cast<char>(EV_RULE_DEF));
+            putU32(i);
+            putU16(static_cast<uint16_t>(text.size()));
+            putString(text);
+            putU16(static_cast<uint16_t>(origin.size()));
+            putString(origin);
+        }
+    }
+}
+
+void TraceWriter::writeRunStart()
+{
+    ++run;
+    if (format == JSONL)
+    {
+        putLiteral("{\"ev\":\"run\",\"run\":");
+        putU32(run);
+        putLiteral("}\n");
+    }
+    else
+    {
+        put(static_cast<char>(EV_RUN));
+        putU32(run);
+    }
+}
+
+void TraceWriter::writeGoal(symbol_t q)
+{
+    if (format == JSONL)
+    {
+        putJsonHead("goal", q);
+        putLiteral("}\n");
+    }
+    else
+    {
+        put(static_cast<char>(EV_GOAL));
+        putSymbol(q);
+    }
+}
+
+void TraceWriter::writeInitialFact(symbol_t q)
+{
+    if (format == JSONL)
+    {
+        putJsonHead("fact", q);
+        putLiteral("}\n");
+    }
+    else
+    {
+        put(static_cast<char>(EV_FACT));
+        putSymbol(q);
+    }
+}
+
+void TraceWriter::writeRuleEvaluation(symbol_t q, uint32_t rule_id, RuleStatus status,
+                                      const std::vector<symbol_t> &blocking_vars, symbol_t cycle_var)
+{
+    if (format == JSONL)
+    {
+        putJsonHead("rule", q);
+        putLiteral(",\"rule\":");
+        putU32(rule_id);
+        putLiteral(",\"status\":\"");
+        const char *name = statusName(status);
+        put(name, std::strlen(name));
+        put('"');
+        if (cycle_var != 0)
+        {
+            putLiteral(",\"cycle\":\"");
+            putSymbol(cycle_var);
+            put('"');
+        }
+        if (!blocking_vars.empty())
+        {
+            putLiteral(",\"blocking\":\"");
+            putString(SymbolTable::formatList(blocking_vars));
+            put('"');
+        }
+        putLiteral("}\n");
+    }
+    else
+    {
+        put(static_cast<char>(EV_RULE));
+        putSymbol(q);
+        putU32(rule_id);
+        put(static_cast<char>(status));
+        putSymbol(cycle_var);
+        putU16(static_cast<uint16_t>(blocking_vars.size()));
+        for (symbol_t var : blocking_vars)
+            putSymbol(var);
+    }
+}
+
+void TraceWriter::writeProveResult(symbol_t q, rhr_value_e result)
+{
+    if (format == JSONL)
+    {
+        putJsonHead("prove", q);
+        putLiteral(",\"result\":\"");
+        const char *name = valueName(result);
+        put(name, std::strlen(name));
+        putLiteral("\"}\n");
+    }
+    else
+    {
+        put(static_cast<char>(EV_PROVE));
+        putSymbol(q);
+        put(static_cast<char>(result));
+    }
+}
+
+void TraceWriter::writeClamp(symbol_t q, rhr_value_e before, rhr_value_e after)
+{
+    if (format == JSONL)
+    {
+        putJsonHead("clamp", q);
+        putLiteral(",\"from\":\"");
+        const char *from = valueName(before);
+        put(from, std::strlen(from));
+        putLiteral("\",\"to\":\"");
+        const char *to = valueName(after);
+        put(to, std::strlen(to));
+        putLiteral("\"}\n");
+    }
+    else
+    {
+        put(static_cast<char>(EV_CLAMP));
+        putSymbol(q);
+        put(static_cast<char>(before));
+        put(static_cast<char>(after));
+    }
+}
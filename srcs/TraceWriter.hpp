@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "BasicRule.hpp"
+#include "ReasoningTypes.hpp"
+
+/**
+ * Streams reasoning events to a file as they happen (--trace-out).
+ * Events go through a fixed-size buffer, so memory does not grow with the KB.
+ *
+ * jsonl: one JSON object per line, with an "ev" field:
+ *   rule_def {rule, text, origin}   once per basic rule, before any run
+ *   run      {run}                  start of a resolution
+ *   goal     {run, sym}             top-level prove of a symbol
+ *   fact     {run, sym}             symbol found in the initial facts
+ *   rule     {run, sym, rule, status, cycle?, blocking?}
+ *   prove    {run, sym, result}
+ *   clamp    {run, sym, from, to}
+ *
+ * bin: the magic "EXTRACE1", then little-endian records starting with a
+ * one-byte event type (same order as above, rule_def = 1):
+ *   rule_def u32 rule, u16 len, text, u16 len, origin
+ *   run      u32 run
+ *   goal     sym
+ *   fact     sym
+ *   rule     sym, u32 rule, u8 status, sym cycle (0 for none), u16 count, count x sym blocking
+ *   prove    sym, u8 result
+ *   clamp    sym, u8 from, u8 to
+ * A sym is the u8 letter, or 0xff, u16 len, name for a named symbol.
+ * Status and result values are the numeric RuleStatus / rhr_value_e values.
+ * Blocking symbols are written in jsonl as by SymbolTable::formatList.
+ **/
+class TraceWriter
+{
+public:
+    enum Format
+    {
+        JSONL,
+        BINARY
+    };
+
+    TraceWriter();
+    ~TraceWriter();
+
+    /**
+     * parse a --trace-format value, return false if unknown.
+     **/
+    static bool parseFormat(const std::string &name, Format &format);
+    /**
+     * open the output file, return false on failure.
+     **/
+    bool open(const std::string &path, Format format);
+    bool isOpen() const;
+    /**
+     * write the buffered events to the file.
+     **/
+    void flush();
+
+    void writeRuleTable(const std::vector<BasicRule> &rules);
+    void writeRunStart();
+    void writeGoal(symbol_t q);
+    void writeInitialFact(symbol_t q);
+    void writeRuleEvaluation(symbol_t q, uint32_t rule_id, RuleStatus status,
+                             const std::vector<symbol_t> &blocking_vars, symbol_t cycle_var);
+    void writeProveResult(symbol_t q, rhr_value_e result);
+    void writeClamp(symbol_t q, rhr_value_e before, rhr_value_e after);
+
+private:
+    enum EventType : uint8_t
+    {
+        EV_RULE_DEF = 1,
+        EV_RUN,
+        EV_GOAL,
+        EV_FACT,
+        EV_RULE,
+        EV_PROVE,
+        EV_CLAMP
+    };
+
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    std::ofstream out;
+    Format format;
+    std::vector<char> buffer;
+    uint32_t run;
+
+    void reserve(size_t n);
+    void put(char c);
+    void put(const char *s, size_t n);
+    void putString(const std::string &s);
+    template <size_t N>
+    void putLiteral(const char (&s)[N])
+    {
+        put(s, N - 1);
+    }
+    void putU16(uint16_t v);
+    void putU32(uint32_t v);
+    void putJsonString(const std::string &s);
+    void putSymbol(symbol_t q);
+    void putJsonHead(const char *ev, symbol_t q);
+};
@@ -1,5 +1,11 @@
 #include "TruthTable.hpp"
+#include "EngineStats.hpp"
 #include "LogicRule.hpp"
+#include "MemoryAccounting.hpp"
+#include "RequestBudget.hpp"
+#include "StateIndex.hpp"
+#include "Timeline.hpp"
+#include "TwoSat.hpp"
 #include "TokenBlock.hpp"
 #include "TokenEffect.hpp"
 #include <sstream>
@@ -35,7 +41,7 @@ std::string VariableState::toString() const
     {
         if (!first)
             oss << ", ";
-        oss << pair.first << "=" << (pair.second ? "T" : "F");
+        oss << SymbolTable::name(pair.first) << "=" << (pair.second ? "T" : "F");
         first = false;
     }
     oss << "}";
@@ -96,14 +102,14 @@ static bool resolveLeft(std::vector<TokenBlock> &fact)
     }
 }
 
-static bool evaluateSide(const std::vector<TokenBlock> &side, const std::map<char, bool> &values)
+static bool evaluateSide(const std::vector<TokenBlock> &side, const std::map<symbol_t, bool> &values)
 {
     std::vector<TokenBlock> blocks = side;
     for (TokenBlock &block : blocks)
     {
         for (TokenEffect &tk : block)
         {
-            if (tk.type >= 'A' && tk.type <= 'Z')
+            if (SymbolTable::isSymbol(tk.type))
             {
                 auto it = values.find(tk.type);
                 tk.effect = (it != values.end()) ? it->second : false;
@@ -113,43 +119,47 @@ static bool evaluateSide(const std::vector<TokenBlock> &side, const std::map<cha
     return resolveLeft(blocks);
 }
 
-static std::set<char> collectVariables(const std::vector<TokenBlock> &side)
+static std::set<symbol_t> collectVariables(const std::vector<TokenBlock> &side)
 {
-    std::set<char> vars;
+    std::set<symbol_t> vars;
     for (const TokenBlock &block : side)
     {
         for (const TokenEffect &tk : block)
         {
-            if (tk.type >= 'A' && tk.type <= 'Z')
+            if (SymbolTable::isSymbol(tk.type))
                 vars.insert(tk.type);
         }
     }
     return vars;
 }
 
-TruthTable TruthTable::fromBasicRule(const BasicRule &rule)
+TruthTable TruthTable::fromBasicRule(const BasicRule &rule, const std::map<symbol_t, bool> &known)
 {
     TruthTable table;
     
     table.variables = collectVariables(rule.lhs);
     table.variables.insert(rule.rhs_symbol);
     
-    size_t num_vars = table.variables.size();
+    std::map<symbol_t, bool> fixed;
+    std::vector<symbol_t> var_list;
+    for (symbol_t var : table.variables)
+    {
+        auto it = known.find(var);
+        if (it != known.end())
+            fixed[var] = it->second;
+        else
+            var_list.push_back(var);
+    }
+    size_t num_vars = var_list.size();
     size_t num_combinations = 1 << num_vars;
-    std::vector<char> var_list(table.variables.begin(), table.variables.end());
     for (size_t i = 0; i < num_combinations; ++i)
     {
-        std::map<char, bool> state;
+        std::map<symbol_t, bool> state = fixed;
         for (size_t j = 0; j < num_vars; ++j)
         {
             state[var_list[j]] = (i >> j) & 1;
         }
-        bool lhs_val = evaluateSide(rule.lhs, state);
-        bool rhs_val = rule.rhs_negated ? !state[rule.rhs_symbol] : state[rule.rhs_symbol];
-        
-        bool rule_satisfied = !lhs_val || rhs_val;
-        
-        if (rule_satisfied)
+        if (satisfies(rule, state))
         {
             table.valid_states.insert(VariableState(state));
         }
@@ -158,7 +168,16 @@ TruthTable TruthTable::fromBasicRule(const BasicRule &rule)
     return table;
 }
 
-TruthTable TruthTable::filterByFacts(const std::map<char, bool> &known_facts) const
+bool TruthTable::satisfies(const BasicRule &rule, const std::map<symbol_t, bool> &state)
+{
+    bool lhs_val = evaluateSide(rule.lhs, state);
+    auto it = state.find(rule.rhs_symbol);
+    bool rhs_set = it != state.end() && it->second;
+    bool rhs_val = rule.rhs_negated ? !rhs_set : rhs_set;
+    return !lhs_val || rhs_val;
+}
+
+TruthTable TruthTable::filterByFacts(const std::map<symbol_t, bool> &known_facts) const
 {
     TruthTable filtered;
     filtered.variables = variables;
@@ -186,10 +205,10 @@ TruthTable TruthTable::filterByFacts(const std::map<char, bool> &known_facts) co
     return filtered;
 }
 
-TruthTable TruthTable::filterByResults(const std::set<char> &initial_facts, const std::map<char, rhr_value_e> &base_results) const
+std::map<symbol_t, bool> TruthTable::knownValues(const std::set<symbol_t> &initial_facts, const std::map<symbol_t, rhr_value_e> &base_results)
 {
-    std::map<char, bool> known_facts;
-    for (char fact : initial_facts)
+    std::map<symbol_t, bool> known_facts;
+    for (symbol_t fact : initial_facts)
         known_facts[fact] = true;
     for (const auto &entry : base_results)
     {
@@ -198,51 +217,88 @@ TruthTable TruthTable::filterByResults(const std::set<char> &initial_facts, cons
         else if (entry.second == R_FALSE)
             known_facts[entry.first] = false;
     }
-    return filterByFacts(known_facts);
+    return known_facts;
+}
+
+TruthTable TruthTable::filterByResults(const std::set<symbol_t> &initial_facts, const std::map<symbol_t, rhr_value_e> &base_results) const
+{
+    return filterByFacts(knownValues(initial_facts, base_results));
 }
 
-TruthTable TruthTable::conjunction(const TruthTable &t1, const TruthTable &t2)
+TruthTable TruthTable::conjunction(const TruthTable &t1, const TruthTable &t2, RequestBudget *budget)
 {
+    uint64_t start = Timeline::isEnabled() ? Timeline::now() : 0;
     TruthTable result;
     
     result.variables = t1.variables;
     result.variables.insert(t2.variables.begin(), t2.variables.end());
     
+    size_t bytes = 0;
     for (const VariableState &state1 : t1.valid_states)
     {
         for (const VariableState &state2 : t2.valid_states)
         {
+            if (budget && budget->poll())
+                return result;
             if (state1.isCompatibleWith(state2))
             {
                 VariableState merged = state1.merge(state2);
+                if (budget)
+                    bytes += stateBytes(merged);
                 result.valid_states.insert(merged);
+                if (budget && budget->charge(bytes))
+                    return result;
             }
         }
     }
     
+    if (start)
+        Timeline::recordJoin(start, t1.countValidStates(), t2.countValidStates(), result.countValidStates());
     return result;
 }
 
-TruthTable TruthTable::conjunctionAll(const std::vector<TruthTable> &tables)
+TruthTable TruthTable::conjunctionAll(const std::vector<TruthTable> &tables, EngineStats *stats, size_t max_states,
+                                      RequestBudget *budget)
 {
     if (tables.empty())
         return TruthTable();
     
     TruthTable result = tables[0];
+    if (stats)
+        stats->peak_states = std::max(stats->peak_states, result.countValidStates());
     
     for (size_t i = 1; i < tables.size(); ++i)
     {
-        result = conjunction(result, tables[i]);
+        if (stats)
+        {
+            EngineStats::Clock::time_point start = EngineStats::Clock::now();
+            size_t left_states = result.countValidStates();
+            result = conjunction(result, tables[i], budget);
+            stats->recordJoin(left_states, tables[i].countValidStates(), result.countValidStates(), EngineStats::elapsedUs(start));
+            stats->setMemory(EngineStats::MEM_COMBINED_TABLE, result.memoryBytes());
+        }
+        else
+            result = conjunction(result, tables[i], budget);
         
-        // Early exit if no valid states remain
-        if (!result.hasValidState())
+        // Early exit if no valid states remain or the table outgrew its budget
+        if (!result.hasValidState() || (max_states && result.countValidStates() > max_states)
+            || (budget && budget->isExhausted()))
             break;
     }
     
     return result;
 }
 
-std::set<bool> TruthTable::getPossibleValues(char var) const
+TruthTable TruthTable::unconstrained(const std::set<symbol_t> &variables)
+{
+    TruthTable table;
+    table.variables = variables;
+    // a state without values conflicts with no fact and fixes no variable
+    table.valid_states.insert(VariableState());
+    return table;
+}
+
+std::set<bool> TruthTable::getPossibleValues(symbol_t var) const
 {
     std::set<bool> possible;
     
@@ -258,19 +314,19 @@ std::set<bool> TruthTable::getPossibleValues(char var) const
     return possible;
 }
 
-bool TruthTable::mustBeTrue(char var) const
+bool TruthTable::mustBeTrue(symbol_t var) const
 {
     std::set<bool> possible = getPossibleValues(var);
     return possible.size() == 1 && *possible.begin() == true;
 }
 
-bool TruthTable::mustBeFalse(char var) const
+bool TruthTable::mustBeFalse(symbol_t var) const
 {
     std::set<bool> possible = getPossibleValues(var);
     return possible.size() == 1 && *possible.begin() == false;
 }
 
-rhr_value_e TruthTable::clampValue(char var, rhr_value_e current) const
+rhr_value_e TruthTable::clampValue(symbol_t var, rhr_value_e current) const
 {
     if (mustBeTrue(var))
         return R_TRUE;
@@ -279,6 +335,58 @@ rhr_value_e TruthTable::clampValue(char var, rhr_value_e current) const
     return current;
 }
 
+bool TruthTable::clampValues(const std::set<symbol_t> &initial_facts, std::map<symbol_t, rhr_value_e> &values) const
+{
+    std::map<symbol_t, bool> known = knownValues(initial_facts, values);
+    if (two_sat)
+    {
+        std::map<symbol_t, bool> forced;
+        if (!two_sat->forcedValues(known, forced))
+            return false;
+        for (const auto &entry : forced)
+        {
+            if (variables.count(entry.first))
+                values[entry.first] = entry.second ? R_TRUE : R_FALSE;
+        }
+        return true;
+    }
+    std::unique_ptr<StateIndex> own_index;
+    const StateIndex *states_index = index.get();
+    if (!states_index)
+    {
+        own_index.reset(new StateIndex(*this));
+        states_index = own_index.get();
+    }
+    StateIndex::Bitmap states = states_index->filter(known);
+    if (!StateIndex::any(states))
+        return false;
+    for (symbol_t var : variables)
+        values[var] = states_index->clampValue(states, var, values[var]);
+    return true;
+}
+
+void TruthTable::buildIndex()
+{
+    index = std::make_shared<const StateIndex>(*this);
+}
+
+size_t TruthTable::memoryBytes() const
+{
+    size_t bytes = MemoryAccounting::setBytes(variables);
+    for (const VariableState &state : valid_states)
+        bytes += stateBytes(state);
+    if (index)
+        bytes += MemoryAccounting::heapBlockBytes(sizeof(StateIndex)) + index->memoryBytes();
+    if (two_sat)
+        bytes += MemoryAccounting::heapBlockBytes(sizeof(TwoSat)) + two_sat->memoryBytes();
+    return bytes;
+}
+
+size_t TruthTable::stateBytes(const VariableState &state)
+{
+    return MemoryAccounting::heapBlockBytes(32 + sizeof(VariableState)) + MemoryAccounting::mapBytes(state.values);
+}
+
 std::string TruthTable::toString() const
 {
     std::ostringstream oss;
@@ -289,10 +397,10 @@ std::string TruthTable::toString() const
         return oss.str();
     }
     
-    std::vector<char> var_list(variables.begin(), variables.end());
-    for (char var : var_list)
+    std::vector<symbol_t> var_list(variables.begin(), variables.end());
+    for (symbol_t var : var_list)
     {
-        oss << var << " | ";
+        oss << SymbolTable::name(var) << " | ";
     }
     
     oss << std::endl << std::string(var_list.size() * 4, '-') << std::endl;
@@ -305,7 +413,7 @@ std::string TruthTable::toString() const
     
     for (const VariableState &state : valid_states)
     {
-        for (char var : var_list)
+        for (symbol_t var : var_list)
         {
             auto it = state.values.find(var);
             if (it != state.values.end())
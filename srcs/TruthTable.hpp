@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
@@ -8,14 +9,18 @@
 #include "ReasoningTypes.hpp"
 
 struct BasicRule;
+class EngineStats;
+class RequestBudget;
+class StateIndex;
+class TwoSat;
 struct TokenBlock;
 
 struct VariableState
 {
-    std::map<char, bool> values;
+    std::map<symbol_t, bool> values;
     
     VariableState() = default;
-    VariableState(const std::map<char, bool> &v) : values(v) {}
+    VariableState(const std::map<symbol_t, bool> &v) : values(v) {}
     
     bool operator<(const VariableState &other) const { return values < other.values; }
     bool operator==(const VariableState &other) const { return values == other.values; }
@@ -35,34 +40,82 @@ std::ostream &operator<<(std::ostream &os, const VariableState &state);
 struct TruthTable
 {
     /** variables involved in this truth table */
-    std::set<char> variables;
+    std::set<symbol_t> variables;
     // states that are compatible with the rule
     std::set<VariableState> valid_states;
+    /** columnar index of valid_states, shared by copies; null until buildIndex */
+    std::shared_ptr<const StateIndex> index;
+    /**
+     * when set, the constraints are these 2-CNF clauses and valid_states
+     * only holds one empty state if they have a model, none otherwise
+     */
+    std::shared_ptr<const TwoSat> two_sat;
     
     TruthTable() = default;
     
-    /** generate truth table from a basic rule */
-    static TruthTable fromBasicRule(const BasicRule &rule);
+    /**
+     * generate truth table from a basic rule; known values are fixed
+     * instead of enumerated, keeping only the states agreeing with them
+     */
+    static TruthTable fromBasicRule(const BasicRule &rule, const std::map<symbol_t, bool> &known = std::map<symbol_t, bool>());
+    /** check if a basic rule holds for an assignment (missing variables are false) */
+    static bool satisfies(const BasicRule &rule, const std::map<symbol_t, bool> &state);
     /** check if there's at least one valid state */
     bool hasValidState() const { return !valid_states.empty(); }
     /** count the number of valid states */
     size_t countValidStates() const { return valid_states.size(); }
     /** filter states by known facts */
-    TruthTable filterByFacts(const std::map<char, bool> &known_facts) const;
+    TruthTable filterByFacts(const std::map<symbol_t, bool> &known_facts) const;
     /** filter states by known facts derived from base results and initial facts */
-    TruthTable filterByResults(const std::set<char> &initial_facts, const std::map<char, rhr_value_e> &base_results) const;
-    /** combine two truth tables */
-    static TruthTable conjunction(const TruthTable &t1, const TruthTable &t2);
-    /** combine multiple truth tables */
-    static TruthTable conjunctionAll(const std::vector<TruthTable> &tables);
+    TruthTable filterByResults(const std::set<symbol_t> &initial_facts, const std::map<symbol_t, rhr_value_e> &base_results) const;
+    /**
+     * combine two truth tables; once budget is exhausted the join stops and
+     * the partial table it returns must be discarded
+     */
+    static TruthTable conjunction(const TruthTable &t1, const TruthTable &t2, RequestBudget *budget = nullptr);
+    /**
+     * combine multiple truth tables, recording each join in stats when given;
+     * stops early once more than max_states states remain (0 for no limit)
+     * or budget is exhausted, which leaves a partial table as conjunction
+     */
+    static TruthTable conjunctionAll(const std::vector<TruthTable> &tables, EngineStats *stats = nullptr, size_t max_states = 0,
+                                     RequestBudget *budget = nullptr);
+    /** table allowing every assignment of the variables, clamping nothing */
+    static TruthTable unconstrained(const std::set<symbol_t> &variables);
     /** get all possible values a variable can have */
-    std::set<bool> getPossibleValues(char var) const;
+    std::set<bool> getPossibleValues(symbol_t var) const;
     /** check if variable must be true in all valid states */
-    bool mustBeTrue(char var) const;
+    bool mustBeTrue(symbol_t var) const;
     /** check if variable must be false in all valid states */
-    bool mustBeFalse(char var) const;
+    bool mustBeFalse(symbol_t var) const;
     /** clamp a tri-state value using this truth table, when available */
-    rhr_value_e clampValue(char var, rhr_value_e current) const;
+    rhr_value_e clampValue(symbol_t var, rhr_value_e current) const;
+    /**
+     * clamp every value of the table variables, as Resolver::evaluate does,
+     * with the states agreeing with the initial facts and decided values;
+     * false, leaving values untouched, when no state agrees
+     */
+    bool clampValues(const std::set<symbol_t> &initial_facts, std::map<symbol_t, rhr_value_e> &values) const;
+    
+    /**
+     * build the columnar index of the current states; valid_states must
+     * not change afterwards, the index is not kept in sync.
+     */
+    void buildIndex();
+    /** the columnar index, null when not built */
+    const StateIndex *getIndex() const { return index.get(); }
+    /** the implication graph standing for the states, null for explicit states */
+    const TwoSat *getTwoSat() const { return two_sat.get(); }
+    /**
+     * values known from the initial facts and the decided base results,
+     * the filter applied by filterByResults
+     */
+    static std::map<symbol_t, bool> knownValues(const std::set<symbol_t> &initial_facts, const std::map<symbol_t, rhr_value_e> &base_results);
+    
+    /** estimated heap bytes held by the variables, states and index */
+    size_t memoryBytes() const;
+    /** estimated heap bytes of one entry of valid_states */
+    static size_t stateBytes(const VariableState &state);
     
     /** convert to string */
     std::string toString() const;
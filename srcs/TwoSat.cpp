@@ -0,0 +1,292 @@
+#include "TwoSat.hpp"
+#include "MemoryAccounting.hpp"
+#include "TruthTable.hpp"
+#include <algorithm>
+
+TwoSat::TwoSat() : symbol_index(-1)
+{
+}
+
+bool TwoSat::fromTables(const std::vector<TruthTable> &tables, TwoSat &model)
+{
+    model = TwoSat();
+    for (const TruthTable &table : tables)
+    {
+        for (symbol_t var : table.variables)
+        {
+            if (model.symbol_index[var] < 0)
+            {
+                model.symbol_index.at(var) = model.symbols.size();
+                model.symbols.push_back(var);
+            }
+        }
+    }
+
+    for (const TruthTable &table : tables)
+    {
+        std::vector<symbol_t> vars(table.variables.begin(), table.variables.end());
+        size_t k = vars.size();
+        if (k >= 32)
+            return false;
+        // every state as a bitmask over vars
+        std::vector<uint32_t> states;
+        for (const VariableState &state : table.valid_states)
+        {
+            uint32_t mask = 0;
+            for (size_t j = 0; j < k; ++j)
+            {
+                auto it = state.values.find(vars[j]);
+                if (it != state.values.end() && it->second)
+                    mask |= 1u << j;
+            }
+            states.push_back(mask);
+        }
+        // a literal over vars: position j, true when the symbol must be set
+        auto holds = [](uint32_t mask, size_t j, bool positive) { return (((mask >> j) & 1) != 0) == positive; };
+        auto implied = [&](size_t a, bool pa, size_t b, bool pb) {
+            for (uint32_t mask : states)
+            {
+                if (!holds(mask, a, pa) && !holds(mask, b, pb))
+                    return false;
+            }
+            return true;
+        };
+
+        // every clause of at most two literals the table implies
+        std::vector<std::pair<int, int>> found;
+        std::vector<std::vector<int>> local;
+        for (size_t a = 0; a < k; ++a)
+        {
+            for (size_t b = a; b < k; ++b)
+            {
+                for (int polarity = 0; polarity < 4; ++polarity)
+                {
+                    bool pa = polarity & 1;
+                    bool pb = polarity & 2;
+                    if (a == b && pa != pb)
+                        continue;
+                    if (!implied(a, pa, b, pb))
+                        continue;
+                    int la = 2 * model.symbol_index[vars[a]] + (pa ? 0 : 1);
+                    int lb = 2 * model.symbol_index[vars[b]] + (pb ? 0 : 1);
+                    found.push_back(std::make_pair(la, lb));
+                    local.push_back({static_cast<int>(a), pa, static_cast<int>(b), pb});
+                }
+            }
+        }
+        // the table is 2-CNF iff those clauses have no other model
+        size_t models = 0;
+        for (uint32_t mask = 0; mask < (1u << k); ++mask)
+        {
+            bool satisfied = true;
+            for (size_t c = 0; c < local.size() && satisfied; ++c)
+                satisfied = holds(mask, local[c][0], local[c][1]) || holds(mask, local[c][2], local[c][3]);
+            models += satisfied;
+        }
+        if (models != states.size())
+            return false;
+        model.clauses.insert(model.clauses.end(), found.begin(), found.end());
+    }
+    model.close();
+    return true;
+}
+
+void TwoSat::close()
+{
+    size_t literals = symbols.size() * 2;
+    edges.assign(literals, std::vector<int>());
+    for (const std::pair<int, int> &clause : clauses)
+    {
+        edges[clause.first ^ 1].push_back(clause.second);
+        if (clause.first != clause.second)
+            edges[clause.second ^ 1].push_back(clause.first);
+    }
+
+    // Tarjan: components come out sinks first. Walked with an explicit stack
+    // of (literal, next edge) so that long implication chains do not exhaust
+    // the native stack
+    std::vector<int> index(literals, -1);
+    std::vector<int> low(literals, 0);
+    std::vector<bool> on_stack(literals, false);
+    std::vector<int> stack;
+    std::vector<std::pair<int, size_t>> walk;
+    int counter = 0;
+    int components = 0;
+    component.assign(literals, -1);
+    auto enter = [&](int v) {
+        index[v] = low[v] = counter++;
+        stack.push_back(v);
+        on_stack[v] = true;
+        walk.push_back(std::make_pair(v, 0));
+    };
+    auto finish = [&](int v) {
+        int w;
+        do
+        {
+            w = stack.back();
+            stack.pop_back();
+            on_stack[w] = false;
+            component[w] = components;
+        } while (w != v);
+        ++components;
+    };
+    for (size_t root = 0; root < literals; ++root)
+    {
+        if (index[root] >= 0)
+            continue;
+        enter(root);
+        while (!walk.empty())
+        {
+            int v = walk.back().first;
+            size_t &edge = walk.back().second;
+            if (edge < edges[v].size())
+            {
+                int w = edges[v][edge++];
+                if (index[w] < 0)
+                    enter(w);
+                else if (on_stack[w])
+                    low[v] = std::min(low[v], index[w]);
+                continue;
+            }
+            walk.pop_back();
+            if (low[v] == index[v])
+                finish(v);
+            if (!walk.empty())
+                low[walk.back().first] = std::min(low[walk.back().first], low[v]);
+        }
+    }
+
+    satisfiable = true;
+    for (size_t v = 0; v < literals; ++v)
+    {
+        if (component[v] == component[v ^ 1])
+            satisfiable = false;
+    }
+    entailed.assign(literals, false);
+    if (satisfiable)
+        findEntailed();
+}
+
+void TwoSat::findEntailed()
+{
+    // A literal x fails, has no model, iff x implies !x; then !x is entailed.
+    // Only literals false in the model read off the components can fail: the
+    // one whose component comes first. Probed sources first, so that a probe
+    // which holds clears the most literals at once: none of the literals it
+    // reached can fail. A probe reaching a failed literal fails as well
+    size_t literals = component.size();
+    std::vector<int> candidates;
+    for (size_t v = 0; v < literals; ++v)
+    {
+        if (component[v] > component[v ^ 1])
+            candidates.push_back(v);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+        [this](int a, int b) { return component[a] > component[b]; });
+
+    enum { UNKNOWN, HOLDS, FAILS };
+    std::vector<char> status(literals, UNKNOWN);
+    std::vector<bool> seen(literals, false);
+    std::vector<int> visited;
+    for (int literal : candidates)
+    {
+        if (status[literal] != UNKNOWN)
+            continue;
+        bool fails = false;
+        visited.assign(1, literal);
+        seen[literal] = true;
+        for (size_t i = 0; i < visited.size() && !fails; ++i)
+        {
+            for (int next : edges[visited[i]])
+            {
+                if (next == (literal ^ 1) || status[next] == FAILS)
+                {
+                    fails = true;
+                    break;
+                }
+                if (!seen[next])
+                {
+                    seen[next] = true;
+                    visited.push_back(next);
+                }
+            }
+        }
+        for (int v : visited)
+        {
+            seen[v] = false;
+            if (!fails)
+                status[v] = HOLDS;
+        }
+        if (fails)
+        {
+            status[literal] = FAILS;
+            entailed[literal ^ 1] = true;
+        }
+    }
+}
+
+bool TwoSat::propagate(const std::map<symbol_t, bool> &known, std::vector<bool> &holds) const
+{
+    holds = entailed;
+    std::vector<int> pending;
+    for (const auto &entry : known)
+    {
+        int index = symbol_index[entry.first];
+        if (index < 0)
+            continue;
+        int literal = 2 * index + (entry.second ? 0 : 1);
+        if (!holds[literal])
+        {
+            holds[literal] = true;
+            pending.push_back(literal);
+        }
+    }
+    while (!pending.empty())
+    {
+        int literal = pending.back();
+        pending.pop_back();
+        if (holds[literal ^ 1])
+            return false;
+        for (int next : edges[literal])
+        {
+            if (!holds[next])
+            {
+                holds[next] = true;
+                pending.push_back(next);
+            }
+        }
+    }
+    return true;
+}
+
+bool TwoSat::hasModelWith(const std::map<symbol_t, bool> &known) const
+{
+    std::vector<bool> holds;
+    return satisfiable && propagate(known, holds);
+}
+
+bool TwoSat::forcedValues(const std::map<symbol_t, bool> &known, std::map<symbol_t, bool> &forced) const
+{
+    forced.clear();
+    std::vector<bool> holds;
+    if (!satisfiable || !propagate(known, holds))
+        return false;
+    // the closure of the known and entailed literals is consistent, so every
+    // other literal is part of a model: see findEntailed
+    for (size_t v = 0; v < symbols.size(); ++v)
+    {
+        if (holds[2 * v] || holds[2 * v + 1])
+            forced[symbols[v]] = holds[2 * v];
+    }
+    return true;
+}
+
+size_t TwoSat::memoryBytes() const
+{
+    size_t bytes = MemoryAccounting::vectorBytes(symbols) + MemoryAccounting::vectorBytes(clauses)
+        + MemoryAccounting::vectorBytes(edges) + MemoryAccounting::vectorBytes(component)
+        + entailed.capacity() / 8;
+    for (const std::vector<int> &targets : edges)
+        bytes += MemoryAccounting::vectorBytes(targets);
+    return bytes;
+}
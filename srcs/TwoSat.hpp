@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+#include "SymbolTable.hpp"
+
+struct TruthTable;
+
+/**
+ * Implication graph of a knowledge base whose rule tables are all 2-CNF
+ * (at most two literals per clause). Each clause a | b gives the edges
+ * !a -> b and !b -> a. The strongly connected components decide
+ * satisfiability, and the literals true in every model are found once.
+ * A query then propagates the known literals along the edges, linear in
+ * the size of the graph: they extend to a model iff the literals reached
+ * hold no symbol and its negation, and those literals are the forced
+ * values, so no table is joined.
+ **/
+class TwoSat
+{
+public:
+    TwoSat();
+
+    /**
+     * build the graph of the rule tables; false when one of them is not
+     * the set of models of its clauses of at most two literals.
+     **/
+    static bool fromTables(const std::vector<TruthTable> &tables, TwoSat &model);
+
+    /** check if the rules alone have a model */
+    bool isSatisfiable() const { return satisfiable; }
+    /** check if the rules have a model agreeing with the known values */
+    bool hasModelWith(const std::map<symbol_t, bool> &known) const;
+    /**
+     * fill forced with every symbol taking a single value in the models
+     * agreeing with the known values; false when there is no such model.
+     **/
+    bool forcedValues(const std::map<symbol_t, bool> &known, std::map<symbol_t, bool> &forced) const;
+
+    size_t symbolCount() const { return symbols.size(); }
+    size_t clauseCount() const { return clauses.size(); }
+    /** estimated heap bytes held by the clauses and the graph */
+    size_t memoryBytes() const;
+
+private:
+    std::vector<symbol_t> symbols;
+    SymbolArray<int> symbol_index;
+    std::vector<std::pair<int, int>> clauses;
+    /** a literal is 2 * symbol index, plus 1 when negated; its implied literals */
+    std::vector<std::vector<int>> edges;
+    /** strongly connected component of each literal, sinks first */
+    std::vector<int> component;
+    /** literals true in every model of the rules */
+    std::vector<bool> entailed;
+    bool satisfiable = true;
+
+    /** build the edges and components, satisfiable from their members */
+    void close();
+    /** fill entailed by probing the literals that may have no model */
+    void findEntailed();
+    /**
+     * mark the entailed literals and those implied by the known values,
+     * symbols outside the rules ignored; false when a symbol and its
+     * negation are both reached.
+     **/
+    bool propagate(const std::map<symbol_t, bool> &known, std::vector<bool> &holds) const;
+};
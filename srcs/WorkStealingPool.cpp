@@ -0,0 +1,98 @@
+#include "WorkStealingPool.hpp"
+#include <thread>
+
+WorkStealingPool::WorkStealingPool(unsigned int threads) : pending(0), queued(0), steal_count(0), sleepers(0)
+{
+    if (threads == 0)
+        threads = 1;
+    for (unsigned int i = 0; i < threads; ++i)
+        queues.emplace_back(new Queue());
+}
+
+void WorkStealingPool::fork(unsigned int worker, uint32_t task)
+{
+    // counted before it is visible, so pending never drops to 0 early
+    pending.fetch_add(1, std::memory_order_relaxed);
+    {
+        Queue &queue = *queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+    // both sequentially consistent: either a worker going to sleep sees the
+    // task, or this sees the sleeper
+    queued.fetch_add(1);
+    if (sleepers.load() != 0)
+        wake(false);
+}
+
+void WorkStealingPool::wake(bool all)
+{
+    // taking the lock orders this after a sleeper checking its predicate
+    std::lock_guard<std::mutex> lock(idle_mutex);
+    if (all)
+        idle.notify_all();
+    else
+        idle.notify_one();
+}
+
+bool WorkStealingPool::take(unsigned int worker, uint32_t &task)
+{
+    {
+        Queue &own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); ++i)
+    {
+        Queue &victim = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            ++steal_count;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::work(unsigned int worker, const Handler &handler)
+{
+    uint32_t task;
+    while (true)
+    {
+        if (take(worker, task))
+        {
+            handler(task, worker);
+            if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                wake(true);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        ++sleepers;
+        idle.wait(lock, [this] { return queued.load() != 0 || pending.load() == 0; });
+        --sleepers;
+        if (pending.load(std::memory_order_acquire) == 0)
+            return;
+    }
+}
+
+void WorkStealingPool::run(const std::vector<uint32_t> &seeds, const Handler &handler)
+{
+    for (size_t i = 0; i < seeds.size(); ++i)
+        fork(i % queues.size(), seeds[i]);
+    std::vector<std::thread> threads;
+    for (unsigned int worker = 1; worker < queues.size(); ++worker)
+        threads.emplace_back(&WorkStealingPool::work, this, worker, std::cref(handler));
+    work(0, handler);
+    for (std::thread &thread : threads)
+        thread.join();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Pool running many small tasks, identified by an integer, on a few threads.
+ * Every worker owns a deque: the tasks it forks are pushed and popped at the
+ * back, most recent first, so a worker keeps going down the part of the
+ * work it already has in cache. An idle worker steals the oldest task at the
+ * front of another worker's deque; when every deque is empty it sleeps
+ * until a task is forked or the run is over.
+ *
+ * The calling thread is worker 0, the others only live for one run. A task
+ * must not throw.
+ **/
+class WorkStealingPool
+{
+public:
+    /** runs one task on a worker, forking more with fork(worker, ...) */
+    typedef std::function<void(uint32_t task, unsigned int worker)> Handler;
+
+    explicit WorkStealingPool(unsigned int threads);
+
+    unsigned int threadCount() const { return queues.size(); }
+    /** run the seed tasks and every task they fork, return once all are done */
+    void run(const std::vector<uint32_t> &seeds, const Handler &handler);
+    /** queue a task on the deque of worker, which must be the calling one */
+    void fork(unsigned int worker, uint32_t task);
+    /** tasks taken from another worker's deque, over every run */
+    uint64_t steals() const { return steal_count.load(); }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<uint32_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    /** tasks queued or running */
+    std::atomic<size_t> pending;
+    /** tasks sitting in a deque */
+    std::atomic<size_t> queued;
+    std::atomic<uint64_t> steal_count;
+    /** idle workers wait on it, counted by sleepers */
+    std::mutex idle_mutex;
+    std::condition_variable idle;
+    std::atomic<unsigned int> sleepers;
+
+    /** next task of worker: its own newest, or the oldest of another one */
+    bool take(unsigned int worker, uint32_t &task);
+    /** wake the idle workers, all of them at the end of a run */
+    void wake(bool all);
+    void work(unsigned int worker, const Handler &handler);
+};
@@ -0,0 +1,126 @@
+#ifndef EXPERT_H
+#define EXPERT_H
+
+/*
+ * C API of libexpert, the engine behind the `expert` binary.
+ *
+ * A knowledge base (expert_kb) is loaded once and is immutable afterwards;
+ * it can be shared by any number of threads. Evaluation contexts
+ * (expert_ctx) hold a fact set and the state of the last resolution; use
+ * one context per thread, and free contexts before their knowledge base.
+ *
+ * Symbols are the uppercase letters 'A'..'Z' and the identifiers used by
+ * the rules (letters, digits and '_', not starting with a digit, such as
+ * pump_on or Valve2). A run of capital letters only is one symbol per
+ * letter in a fact or query list, as on '=' lines: "PUMP" stands for P, U,
+ * M and P there, and is a syntax error in a rule, so no symbol is named
+ * PUMP. The names are interned in a table shared by the whole process,
+ * which keeps them until exit, even after expert_kb_free; the functions
+ * taking names still accept only the symbols of their own knowledge base
+ * (its rules, '=' line and '?' line). Every function returning an
+ * expert_status leaves a description of the failure in expert_last_error().
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EXPERT_ABI_VERSION 2
+
+typedef struct expert_kb expert_kb;
+typedef struct expert_ctx expert_ctx;
+
+typedef enum expert_status
+{
+    EXPERT_OK = 0,
+    EXPERT_ERR_INVALID_ARGUMENT,
+    EXPERT_ERR_IO,
+    EXPERT_ERR_SYNTAX,
+    EXPERT_ERR_NO_VALID_STATE,
+    EXPERT_ERR_BUFFER_TOO_SMALL,
+    EXPERT_ERR_INTERNAL,
+    /* results are filled, but the budget ran out: unresolved symbols are EXPERT_AMBIGUOUS */
+    EXPERT_PARTIAL
+} expert_status;
+
+typedef enum expert_value
+{
+    EXPERT_FALSE = 0,
+    EXPERT_AMBIGUOUS = 1,
+    EXPERT_TRUE = 2
+} expert_value;
+
+/* ABI version of the loaded library, compare with EXPERT_ABI_VERSION. */
+int expert_abi_version(void);
+/* Static description of a status code. */
+const char *expert_status_string(expert_status status);
+/* Description of the last failure in the calling thread. */
+const char *expert_last_error(void);
+
+/* Load a knowledge base from a rule file. */
+expert_status expert_kb_load_file(const char *path, expert_kb **out);
+/* Load a knowledge base from rule text held in memory. */
+expert_status expert_kb_load_buffer(const char *data, size_t size, expert_kb **out);
+/*
+ * Copy the queries ('?' line) of the knowledge base as a NUL terminated
+ * string, in the format expert_resolve reads back.
+ */
+expert_status expert_kb_queries(const expert_kb *kb, char *buf, size_t buf_len);
+void expert_kb_free(expert_kb *kb);
+
+/* Create a context starting from the initial facts ('=' line) of the knowledge base. */
+expert_status expert_ctx_create(const expert_kb *kb, expert_ctx **out);
+void expert_ctx_free(expert_ctx *ctx);
+/* Make every symbol false. */
+expert_status expert_ctx_clear_facts(expert_ctx *ctx);
+/*
+ * Set one symbol true (value != 0) or back to false, by name: "A" or
+ * "pump_on". Names the knowledge base does not use are rejected.
+ */
+expert_status expert_ctx_set_fact(expert_ctx *ctx, const char *name, int value);
+/*
+ * Replace the fact set by the symbols of a NUL terminated string, as on a
+ * '=' line: "AB" or "A pump_on". Symbols the knowledge base does not use
+ * are rejected.
+ */
+expert_status expert_ctx_set_facts(expert_ctx *ctx, const char *symbols);
+/* Record explanations during expert_resolve (off by default). */
+expert_status expert_ctx_set_explain(expert_ctx *ctx, int enabled);
+/*
+ * Resolve with a named engine of `expert --list-engines` instead of the
+ * resolver (NULL or "table" for the resolver). The knowledge base keeps its
+ * combined truth table, so only "table", "bruteforce" and "rete" are
+ * accepted; "rete" updates its network with the facts changed since the
+ * previous expert_resolve. Contexts recording explanations or with a budget
+ * use the resolver.
+ */
+expert_status expert_ctx_set_engine(expert_ctx *ctx, const char *name);
+/*
+ * Bound each expert_resolve to timeout_ms milliseconds and to
+ * max_memory_bytes of resolver state (0 for no limit, the default). A
+ * resolution out of budget stops early and returns EXPERT_PARTIAL.
+ */
+expert_status expert_ctx_set_budget(expert_ctx *ctx, unsigned long timeout_ms, size_t max_memory_bytes);
+
+/*
+ * Resolve the symbols of `queries` (NULL for the knowledge base queries),
+ * read as expert_ctx_set_facts does. results[i] receives the value of the
+ * i-th query symbol; results_len must be at least the number of query
+ * symbols. Single-letter symbols are one character each.
+ */
+expert_status expert_resolve(expert_ctx *ctx, const char *queries, expert_value *results, size_t results_len);
+/*
+ * Copy the explanation of a symbol, named as in expert_ctx_set_fact, from
+ * the last expert_resolve, made with explanations enabled. `written`
+ * (optional) receives the length of the text without its NUL, even when
+ * the buffer is too small.
+ */
+expert_status expert_explain(const expert_ctx *ctx, const char *name, char *buf, size_t buf_len, size_t *written);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,216 @@
+// Test client for `expert <file> --serve <socket>`.
+//
+//   expert_client <socket>
+//       send request lines read from stdin, print one reply per line
+//   expert_client <socket> --load <requests> [--clients C] [--request "<line>"]
+//       load test: C connections share <requests> closed-loop requests and
+//       a JSON summary (throughput, latency percentiles, errors) is printed
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static int connectTo(const std::string &path)
+{
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        return -1;
+    std::strcpy(addr.sun_path, path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool sendAll(int fd, const std::string &data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * Buffered reader returning one reply line at a time.
+ */
+class LineReader
+{
+public:
+    explicit LineReader(int fd) : fd(fd) {}
+
+    bool next(std::string &line)
+    {
+        size_t pos;
+        while ((pos = buffer.find('\n')) == std::string::npos)
+        {
+            char buf[4096];
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n <= 0)
+                return false;
+            buffer.append(buf, static_cast<size_t>(n));
+        }
+        line = buffer.substr(0, pos);
+        buffer.erase(0, pos + 1);
+        return true;
+    }
+
+private:
+    int fd;
+    std::string buffer;
+};
+
+static int runPassthrough(const std::string &path)
+{
+    int fd = connectTo(path);
+    if (fd < 0)
+        return (std::cerr << "Error: cannot connect to " << path << std::endl, 1);
+    LineReader reader(fd);
+    std::string line;
+    std::string reply;
+    while (std::getline(std::cin, line))
+    {
+        if (line.empty())
+            continue;
+        if (!sendAll(fd, line + "\n") || !reader.next(reply))
+            return (std::cerr << "Error: connection closed" << std::endl, close(fd), 1);
+        std::cout << reply << '\n';
+    }
+    close(fd);
+    return 0;
+}
+
+struct LoadResult
+{
+    std::vector<double> latencies_us;
+    size_t errors = 0;
+    size_t failed_connections = 0;
+};
+
+static void loadWorker(const std::string &path, const std::string &request, size_t count, LoadResult &result)
+{
+    int fd = connectTo(path);
+    if (fd < 0)
+    {
+        result.failed_connections++;
+        return;
+    }
+    LineReader reader(fd);
+    std::string line = request + "\n";
+    std::string reply;
+    result.latencies_us.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!sendAll(fd, line) || !reader.next(reply))
+        {
+            result.errors += count - i;
+            break;
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        result.latencies_us.push_back(elapsed.count());
+        if (reply.find("\"ok\":true") == std::string::npos)
+            result.errors++;
+    }
+    close(fd);
+}
+
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+    return sorted[index];
+}
+
+static int runLoad(const std::string &path, size_t requests, size_t clients, const std::string &request)
+{
+    if (clients == 0)
+        clients = 1;
+    std::vector<LoadResult> results(clients);
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < clients; ++i)
+    {
+        size_t count = requests / clients + (i < requests % clients ? 1 : 0);
+        threads.emplace_back(loadWorker, path, request, count, std::ref(results[i]));
+    }
+    for (std::thread &t : threads)
+        t.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<double> all;
+    size_t errors = 0;
+    size_t failed = 0;
+    for (const LoadResult &r : results)
+    {
+        all.insert(all.end(), r.latencies_us.begin(), r.latencies_us.end());
+        errors += r.errors;
+        failed += r.failed_connections;
+    }
+    std::sort(all.begin(), all.end());
+    std::cout << "{\"requests\":" << all.size()
+              << ",\"clients\":" << clients
+              << ",\"errors\":" << errors
+              << ",\"failed_connections\":" << failed
+              << ",\"seconds\":" << elapsed.count()
+              << ",\"requests_per_second\":" << (elapsed.count() > 0 ? static_cast<double>(all.size()) / elapsed.count() : 0)
+              << ",\"latency_us\":{\"p50\":" << percentile(all, 0.50)
+              << ",\"p90\":" << percentile(all, 0.90)
+              << ",\"p99\":" << percentile(all, 0.99)
+              << ",\"max\":" << (all.empty() ? 0 : all.back())
+              << "}}" << std::endl;
+    return (errors || failed) ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <socket> [--load <requests> [--clients <n>] [--request <line>]]" << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    size_t requests = 0;
+    size_t clients = 4;
+    std::string request = "id=load";
+    bool load = false;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+            return (std::cerr << "Missing value for option: " << arg << std::endl, 1);
+        if (arg == "--load")
+        {
+            load = true;
+            requests = std::stoul(argv[++i]);
+        }
+        else if (arg == "--clients")
+            clients = std::stoul(argv[++i]);
+        else if (arg == "--request")
+            request = argv[++i];
+        else
+            return (std::cerr << "Unknown option: " << arg << std::endl, 1);
+    }
+    if (load)
+        return runLoad(path, requests, clients, request);
+    return runPassthrough(path);
+}